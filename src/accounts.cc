@@ -0,0 +1,203 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-accounts.h>
+#include <map>
+#include <shared_mutex>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Account_Manager  A;
+
+
+
+  struct  A::Implementation
+  {
+    explicit  Implementation  (shared_ptr<Connection_Pool> P)
+      :  pool    {move (P)},
+         engine  {make_shared<Request_Engine> (pool)},
+         market  {make_unique<Kraken_API> (string {}, string {}, pool)}
+    {
+      configure (*market);
+    }
+
+
+    /*  Bring an object into line with the shared settings. */
+    void  configure  (Kraken_API &K)  const
+    {
+      K.request_engine  =  engine;
+      K.set_url_base (url_base);
+      K.set_metrics (metrics);
+      K.set_policy (policy);
+    }
+
+
+    shared_ptr<Connection_Pool>  pool;
+    shared_ptr<Request_Engine>   engine;
+
+    string                       url_base  {Kraken_API::default_url_base};
+    shared_ptr<Request_Metrics>  metrics;
+    Request_Policy               policy;
+
+    unique_ptr<Kraken_API>       market;
+
+    mutable shared_mutex                 lock;
+    map<string, unique_ptr<Kraken_API>>  accounts;
+  };
+
+
+
+  A::Account_Manager  (shared_ptr<Connection_Pool> P)
+    :  implementation {make_unique<Implementation> (move (P))}
+  {}
+
+
+  A::~Account_Manager  ()  =  default;
+
+
+
+  Kraken_API &  A::add  (string const &name,
+                         string const &key,
+                         string const &secret,
+                         Rate_Limiter::Tier const tier,
+                         string const &nonce_file)
+  {
+    auto &I  =  *implementation;
+
+    auto  K  =  make_unique<Kraken_API> (key, secret, I.pool,
+                                         make_shared<Rate_Limiter> (tier));
+    K->set_nonce_source (nonce_file.empty ()
+                           ?  make_shared<Nonce_Source> ()
+                           :  make_shared<Nonce_Source> (nonce_file));
+
+    auto  L  =  unique_lock<shared_mutex> {I.lock};
+    I.configure (*K);
+
+    auto const  [i, added]  =  I.accounts.emplace (name, move (K));
+    if (! added)
+      throw invalid_argument {"account " + name + " already exists"};
+
+    return *i->second;
+  }
+
+
+
+  void  A::remove  (string const &name)
+  {
+    auto  L  =  unique_lock<shared_mutex> {implementation->lock};
+    implementation->accounts.erase (name);
+  }
+
+
+
+  Kraken_API &  A::account  (string const &name)  const
+  {
+    auto  L  =  shared_lock<shared_mutex> {implementation->lock};
+
+    auto const  i  =  implementation->accounts.find (name);
+    if (i == implementation->accounts.end ())
+      throw out_of_range {"no account " + name};
+
+    return *i->second;
+  }
+
+
+
+  bool  A::contains  (string const &name)  const
+  {
+    auto  L  =  shared_lock<shared_mutex> {implementation->lock};
+    return  implementation->accounts.count (name) > 0;
+  }
+
+
+
+  vector<string>  A::names  ()  const
+  {
+    auto  L  =  shared_lock<shared_mutex> {implementation->lock};
+
+    auto  ret  =  vector<string> {};
+    ret.reserve (implementation->accounts.size ());
+    for (auto const &a  :  implementation->accounts)
+      ret.push_back (a.first);
+    return ret;
+  }
+
+
+
+  size_t  A::size  ()  const
+  {
+    auto  L  =  shared_lock<shared_mutex> {implementation->lock};
+    return implementation->accounts.size ();
+  }
+
+
+
+  Kraken_API &  A::market  ()  const
+  {   return *implementation->market;   }
+
+
+
+  void  A::for_each
+          (function<void (string const &, Kraken_API &)> const &f)  const
+  {
+    auto  L  =  shared_lock<shared_mutex> {implementation->lock};
+    for (auto const &a  :  implementation->accounts)
+      f (a.first, *a.second);
+  }
+
+
+
+  void  A::set_url_base  (string const &U)
+  {
+    auto  L  =  unique_lock<shared_mutex> {implementation->lock};
+    implementation->url_base  =  U;
+    for (auto const &a  :  implementation->accounts)
+      a.second->set_url_base (U);
+    implementation->market->set_url_base (U);
+  }
+
+
+
+  void  A::set_metrics  (shared_ptr<Request_Metrics> M)
+  {
+    auto  L  =  unique_lock<shared_mutex> {implementation->lock};
+    implementation->metrics  =  M;
+    for (auto const &a  :  implementation->accounts)
+      a.second->set_metrics (M);
+    implementation->market->set_metrics (move (M));
+  }
+
+
+
+  void  A::set_policy  (Request_Policy const &P)
+  {
+    auto  L  =  unique_lock<shared_mutex> {implementation->lock};
+    implementation->policy  =  P;
+    for (auto const &a  :  implementation->accounts)
+      a.second->set_policy (P);
+    implementation->market->set_policy (P);
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,131 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <dmbcs-kraken-api.h>
+#include <new>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Request_Arena  A;
+
+
+
+  /*  A bump allocator over the threadʼs block: nothing is given back
+   *  until the whole is reset.  What does not fit goes to the heap, in
+   *  pieces chained together so that they can be freed at the reset.  */
+
+  struct  Block_Resource  :  pmr::memory_resource
+  {
+    struct  Overflow
+    {
+      Overflow        *next;
+      max_align_t      padding;
+    };
+
+    static constexpr size_t  HEADER  =  offsetof (Overflow, padding);
+
+    unique_ptr<byte []>  block     {new byte [A::BLOCK_SIZE]};
+    size_t               used      {0};
+    Overflow            *overflow  {nullptr};
+    int                  depth     {0};
+    A::Statistics        statistics;
+
+
+    ~Block_Resource  ()   {   reset ();   }
+
+
+    void  *do_allocate  (size_t const n,  size_t const alignment)  override
+    {
+      if (alignment > alignof (max_align_t))   throw  bad_alloc {};
+
+      auto const  start  =  (used + alignment - 1)  &  ~(alignment - 1);
+      if (start + n  <=  A::BLOCK_SIZE)
+        {
+          used  =  start + n;
+          statistics.high_water  =  max (statistics.high_water, used);
+          return  block.get () + start;
+        }
+
+      ++statistics.heap_allocations;
+      auto *const  O  =  static_cast<Overflow *>
+                             (::operator new (HEADER + n));
+      O->next   =  overflow;
+      overflow  =  O;
+      return  reinterpret_cast<byte *> (O) + HEADER;
+    }
+
+
+    /*  Everything is given back by reset. */
+    void  do_deallocate  (void *,  size_t,  size_t)  override
+    {}
+
+
+    bool  do_is_equal  (pmr::memory_resource const &R)  const  noexcept
+                                                                  override
+    {   return  this == &R;   }
+
+
+    void  reset  ()
+    {
+      used  =  0;
+
+      while (overflow)
+        {
+          auto *const  next  =  overflow->next;
+          ::operator delete (overflow);
+          overflow  =  next;
+        }
+    }
+  };
+
+
+
+  static  Block_Resource  &arena  ()
+  {
+    thread_local  auto  R  =  Block_Resource {};
+    return R;
+  }
+
+
+
+  pmr::memory_resource  &A::resource  ()   {   return arena ();   }
+
+
+  A::Statistics  A::statistics  ()   {   return arena ().statistics;   }
+
+
+
+  A::Scope::Scope  ()   {   ++arena ().depth;   }
+
+
+  A::Scope::~Scope  ()
+  {
+    auto  &R  =  arena ();
+    if (--R.depth > 0)   return;
+
+    R.reset ();
+    ++R.statistics.requests;
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,378 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <dmbcs-kraken-awaitable.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Pending_Request  P;
+  typedef  Awaitable_API  A;
+
+  using  Clock  =  chrono::steady_clock;
+
+
+  /*  Defined in curl.cc. */
+  Request_Engine  &engine  (Kraken_API const &K);
+
+
+
+  struct  Pending_Request::State
+  {
+    State  (Kraken_API const &K,  Start S,  Limit L,  Executor const &E,
+            chrono::milliseconds const T)
+      :  api {&K},  start {move (S)},  limit {move (L)},  executor {E},
+         timeout {T}
+    {}
+
+    Kraken_API const     *api;
+    Start                 start;
+    Limit                 limit;
+    Executor              executor;
+    chrono::milliseconds  timeout;
+
+    /*  So far, for the rate limiter. */
+    chrono::nanoseconds   waited    {0};
+
+    coroutine_handle<>    handle;
+    string                body;
+    exception_ptr         error;
+
+    atomic<bool>          finished  {false};
+
+    /*  The coroutine is resumed when both the request has finished and
+     *  suspend has done with setting it up, whichever is last.  */
+    atomic<int>           waiting   {2};
+
+
+    /*  Without an executor the coroutine belongs on the engineʼs thread,
+     *  so a timeout or a stop request, which come from elsewhere, hand
+     *  it over rather than resuming it where they are.  */
+    void  resume  (bool const on_engine)
+    {
+      if (executor)         executor (handle);
+      else if (on_engine)   handle.resume ();
+      else                  engine (*api).post ([h = handle]
+                                                {  h.resume ();  });
+    }
+
+
+    /*  Defined below, after the timers. */
+    static  void  admit  (shared_ptr<State> const &);
+
+
+    /*  Only the first call counts.  The reply comes on the engineʼs
+     *  thread; nothing else does.  */
+    void  finish  (string const *const reply,  exception_ptr const E)
+    {
+      if (finished.exchange (true))   return;
+
+      if (reply)   body  =  *reply;
+      error  =  E;
+
+      if (waiting.fetch_sub (1) == 1)   resume (reply != nullptr);
+    }
+  };
+
+
+
+  /*  A thread which calls functions when their time comes, for the
+   *  timeouts of all requests.  */
+
+  class  Timers
+  {
+  public:
+
+    Timers  ()   :  worker {[this] {  run ();  }}  {}
+
+    ~Timers  ()
+    {
+      {
+        auto  guard  =  lock_guard<mutex> {lock};
+        stopping  =  true;
+      }
+      wake.notify_all ();
+      worker.join ();
+    }
+
+    void  add  (Clock::time_point const when,  function<void ()> f)
+    {
+      {
+        auto  guard  =  lock_guard<mutex> {lock};
+        due.emplace (when, move (f));
+      }
+      wake.notify_all ();
+    }
+
+
+  private:
+
+    void  run  ()
+    {
+      auto  guard  =  unique_lock<mutex> {lock};
+
+      while (! stopping)
+        {
+          if (due.empty ())
+            {
+              wake.wait (guard);
+              continue;
+            }
+
+          if (wake.wait_until (guard, due.begin ()->first)
+                  ==  cv_status::no_timeout)
+            continue;
+
+          while (! due.empty ()  &&  due.begin ()->first <= Clock::now ())
+            {
+              auto  f  =  move (due.begin ()->second);
+              due.erase (due.begin ());
+              guard.unlock ();
+              f ();
+              guard.lock ();
+            }
+        }
+    }
+
+    mutex                                     lock;
+    condition_variable                        wake;
+    multimap<Clock::time_point, function<void ()>>  due;
+    bool                                      stopping  {false};
+    thread                                    worker;
+  };
+
+
+  static  Timers  &timers  ()
+  {
+    static  auto  T  =  Timers {};
+    return T;
+  }
+
+
+
+  /*  Start the request once the rate limiter has room for it, asking
+   *  again on the timers thread until it has, unless the request finishes
+   *  (is cancelled or times out) in the meantime.  */
+  void  P::State::admit  (shared_ptr<State> const &s)
+  {
+    auto  &S  =  *s;
+    if (S.finished)   return;
+
+    try
+      {
+        auto const &L     =  S.limit;
+        auto const  wait  =  ! L.limiter     ?  chrono::nanoseconds {0}
+                             :  L.is_private  ?  L.limiter->retry_after
+                                                        (L.function, S.waited)
+                             :  L.limiter->retry_after_public (S.waited);
+
+        if (wait.count () > 0)
+          {
+            S.waited  +=  wait;
+            timers ().add (Clock::now () + wait,
+                           [W = weak_ptr<State> {s}]
+                               {
+                                 if (auto  T  =  W.lock ())   admit (T);
+                               });
+            return;
+          }
+
+        auto  start  =  move (S.start);
+        start ([s] (string const &reply,  exception_ptr error)
+                   {  s->finish (&reply, error);  });
+      }
+    catch (...)
+      {
+        S.finish (nullptr, current_exception ());
+      }
+  }
+
+
+
+  P::Pending_Request  (Kraken_API const &K,
+                       Start S,
+                       Limit L,
+                       Executor const &E,
+                       chrono::milliseconds const T,
+                       stop_token X)
+    :  state {make_shared<State> (K, move (S), move (L), E, T)},
+       stop {move (X)}
+  {}
+
+
+
+  void  P::Stopper::operator()  ()  const  noexcept
+  {   state->finish (nullptr, make_exception_ptr (Request_Cancelled {}));   }
+
+
+
+  bool  P::suspend  (coroutine_handle<> const h)
+  {
+    auto  &S  =  *state;
+    S.handle  =  h;
+
+    if (stop.stop_possible ())
+      on_stop  =  make_unique<stop_callback<Stopper>> (stop, Stopper {state});
+
+    if (S.timeout.count () > 0)
+      timers ().add (Clock::now () + S.timeout,
+                     [W = weak_ptr<State> {state}]
+                         {
+                           if (auto  s  =  W.lock ())
+                             s->finish (nullptr,
+                                        make_exception_ptr
+                                              (Request_Timed_Out {}));
+                         });
+
+    State::admit (state);
+
+    if (S.waiting.fetch_sub (1) != 1)   return true;
+
+    /*  It finished before we got here. */
+    if (! S.executor)   return false;
+    S.executor (h);
+    return true;
+  }
+
+
+
+  string  P::result  ()
+  {
+    if (state->error)   rethrow_exception (state->error);
+    return move (state->body);
+  }
+
+
+
+  Reply<string>  A::text  (Pending_Request::Start start,
+                           Pending_Request::Limit L,
+                           stop_token S)  const
+  {
+    return  {Pending_Request {*api, move (start), move (L), executor,
+                              timeout, move (S)},
+             [] (string const &json)  {  return json;  }};
+  }
+
+
+  template <Endpoint E>
+  Reply<string>  A::text  (string const *const argument,
+                           stop_token S)  const
+  {
+    if (! argument)
+      return  text ([&K = *api] (Kraken_API::Completion done)
+                        {  endpoint_submit<E> (K, K.options_table, nullptr,
+                                               move (done));  },
+                    limit<E> (),
+                    move (S));
+
+    return  text ([&K = *api,  argument = *argument]
+                      (Kraken_API::Completion done)
+                      {  endpoint_submit<E> (K, K.options_table, &argument,
+                                             move (done));  },
+                  limit<E> (),
+                  move (S));
+  }
+
+
+
+  Reply<string>  A::server_time  (stop_token S)  const
+  {   return text<Endpoint::TIME> (nullptr, move (S));   }
+
+  Reply<string>  A::asset_info  (stop_token S)  const
+  {   return text<Endpoint::ASSETS> (nullptr, move (S));   }
+
+  Reply<string>  A::asset_pairs  (stop_token S)  const
+  {   return text<Endpoint::ASSET_PAIRS> (nullptr, move (S));   }
+
+  Reply<string>  A::ticker_info  (string const &pair,  stop_token S)  const
+  {   return text<Endpoint::TICKER> (&pair, move (S));   }
+
+  Reply<string>  A::ohlc_data  (string const &pair,  stop_token S)  const
+  {   return text<Endpoint::OHLC> (&pair, move (S));   }
+
+  Reply<string>  A::order_book  (string const &pair,  stop_token S)  const
+  {   return text<Endpoint::DEPTH> (&pair, move (S));   }
+
+  Reply<string>  A::recent_trades  (string const &pair,  stop_token S)  const
+  {   return text<Endpoint::TRADES> (&pair, move (S));   }
+
+  Reply<string>  A::spread_data  (string const &pair,  stop_token S)  const
+  {   return text<Endpoint::SPREAD> (&pair, move (S));   }
+
+
+  Reply<string>  A::account_balance  (stop_token S)  const
+  {   return text<Endpoint::BALANCE> (nullptr, move (S));   }
+
+  Reply<string>  A::trade_balance  (stop_token S)  const
+  {   return text<Endpoint::TRADE_BALANCE> (nullptr, move (S));   }
+
+  Reply<string>  A::open_orders  (stop_token S)  const
+  {   return text<Endpoint::OPEN_ORDERS> (nullptr, move (S));   }
+
+  Reply<string>  A::closed_orders  (stop_token S)  const
+  {   return text<Endpoint::CLOSED_ORDERS> (nullptr, move (S));   }
+
+  Reply<string>  A::query_orders  (string const &txid,  stop_token S)  const
+  {   return text<Endpoint::QUERY_ORDERS> (&txid, move (S));   }
+
+  Reply<string>  A::trades_history  (stop_token S)  const
+  {   return text<Endpoint::TRADES_HISTORY> (nullptr, move (S));   }
+
+  Reply<string>  A::trades_info  (string const &txid,  stop_token S)  const
+  {   return text<Endpoint::QUERY_TRADES> (&txid, move (S));   }
+
+  Reply<string>  A::open_positions  (string const &txid,  stop_token S)  const
+  {   return text<Endpoint::OPEN_POSITIONS> (&txid, move (S));   }
+
+  Reply<string>  A::ledgers_info  (stop_token S)  const
+  {   return text<Endpoint::LEDGERS> (nullptr, move (S));   }
+
+  Reply<string>  A::query_ledgers  (string const &id,  stop_token S)  const
+  {   return text<Endpoint::QUERY_LEDGERS> (&id, move (S));   }
+
+  Reply<string>  A::trade_volume  (stop_token S)  const
+  {   return text<Endpoint::TRADE_VOLUME> (nullptr, move (S));   }
+
+
+  Reply<string>  A::add_order  (Kraken_API::Order const &order,
+                                stop_token S)  const
+  {
+    /*  Trading functions are never held back by the limiter, so
+     *  add_order_async will not block.  */
+    return  text ([&K = *api,  order] (Kraken_API::Completion done)
+                      {  K.add_order_async (order, move (done));  },
+                  {},
+                  move (S));
+  }
+
+  Reply<string>  A::cancel_order  (string const &txid,  stop_token S)  const
+  {   return text<Endpoint::CANCEL_ORDER> (&txid, move (S));   }
+
+  Reply<string>  A::cancel_all  (stop_token S)  const
+  {   return text<Endpoint::CANCEL_ALL> (nullptr, move (S));   }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,253 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Benchmarks of the whole request path against a local stand-in for the
+ *  exchange (so that only this libraryʼs costs, and those of libcurl and
+ *  the loop-back interface, are measured), and of its parts on their
+ *  own: building queries, signing them and parsing the responses.
+
+ *      bench/exchange [requests [window]]
+
+ *  The exit status is non-zero if the stand-in saw any bad signatures or
+ *  nonces.  */
+
+
+#include "mock-exchange.h"
+#include <dmbcs-kraken-api.h>
+#include <dmbcs-kraken-market.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+  /*  Defined in dmbcs-kraken-api.cc.  */
+  void  query_add_options  (string &query,
+                            Kraken_API::Options const &values,
+                            initializer_list<Kraken_API::Option> options,
+                            char joiner);
+
+}
+
+
+using namespace DMBCS;
+
+using  Clock  =  chrono::steady_clock;
+
+
+
+template <typename F>
+static  double  nanoseconds_per_call  (size_t const  n,  F  f)
+{
+  auto const  start  =  Clock::now ();
+  for (auto i = size_t {0};  i < n;  ++i)   f ();
+  auto const  end  =  Clock::now ();
+
+  return  chrono::duration<double, nano> (end - start).count () / n;
+}
+
+
+
+/*  Print a line of latency percentiles, in microseconds, and the rate at
+ *  which the requests were completed.  */
+static  void  report  (char const *const name,
+                       vector<double> latencies,
+                       double const seconds)
+{
+  sort (latencies.begin (), latencies.end ());
+
+  auto  at  =  [&latencies] (double const q)
+    {  return latencies [size_t (q * (latencies.size () - 1))];  };
+
+  printf ("  %-26s %9.0f req/s   p50 %7.1f  p90 %7.1f  p99 %7.1f"
+          "  max %8.1f us\n",
+          name,  latencies.size () / seconds,
+          at (0.5),  at (0.9),  at (0.99),  latencies.back ());
+}
+
+
+
+template <typename F>
+static  void  sequential  (char const *const name,  size_t const n,  F f)
+{
+  auto  latencies  =  vector<double> (n);
+  auto const  start  =  Clock::now ();
+
+  for (auto &L  :  latencies)
+    {
+      auto const  t  =  Clock::now ();
+      f ();
+      L  =  chrono::duration<double, micro> (Clock::now () - t).count ();
+    }
+
+  report (name,  move (latencies),
+          chrono::duration<double> (Clock::now () - start).count ());
+}
+
+
+
+/*  Keep window requests in flight at all times. */
+static  void  windowed  (char const *const name,
+                         size_t const n,
+                         size_t const window,
+                         Kraken_API const &K)
+{
+  auto  latencies  =  vector<double> (n);
+  auto  pending    =  deque<future<string>> {};
+  auto  measured   =  atomic<size_t> {0};
+  auto const  start  =  Clock::now ();
+
+  for (auto i = size_t {0};  i < n;  ++i)
+    {
+      if (pending.size () >= window)
+        {
+          pending.front ().get ();
+          pending.pop_front ();
+        }
+
+      pending.push_back
+        (K.ticker_info_async ("XXBTZUSD",
+                              [&L = latencies [i], &measured,
+                               t = Clock::now ()]
+                                  (string const &, exception_ptr)
+                              {
+                                L  =  chrono::duration<double, micro>
+                                          (Clock::now () - t).count ();
+                                ++measured;
+                              }));
+    }
+
+  for (auto &P  :  pending)   P.get ();
+
+  /*  The futures are ready just before the completions are called. */
+  while (measured < n)   this_thread::yield ();
+
+  report (name,  move (latencies),
+          chrono::duration<double> (Clock::now () - start).count ());
+}
+
+
+
+int  main  (int argc,  char **argv)
+{
+  auto const  n       =  argc > 1  ?  size_t (stoul (argv [1]))  :  size_t {2000};
+  auto const  window  =  argc > 2  ?  size_t (stoul (argv [2]))  :  size_t {16};
+
+  /*  Any 64 bytes will do. */
+  auto const  secret  =  string {"kQH5HW/8p1uGOVjbgWA7FunAmGO8lsSUXNsu3eow76sz"
+                                 "84Q18fWxnyRzBHCd3pd5nE9qa99HAZtuZuj6F1huXg=="};
+
+  auto  exchange  =  Mock_Exchange {secret};
+
+  auto  K  =  Kraken_API {"bench-key",  secret,
+                          make_shared<Connection_Pool> (),  nullptr};
+  K.set_url_base (exchange.url_base ());
+
+  auto  sink  =  size_t {0};
+
+
+  cout  <<  "parts of a request, per call:\n";
+
+  {
+    auto  options  =  Kraken_API::Options {};
+    options.set (K.TRADES, true)  .set (K.USERREF, 1234)
+           .set (K.START, 1688669000)  .set (K.END, 1688669448)
+           .set (K.OFS, 50)  .set (K.CLOSE_TIME, "both");
+
+    auto const  ns  =  nanoseconds_per_call (n * 100,  [&]
+      {
+        auto  query  =  string {"ClosedOrders"};
+        query_add_options (query, options,
+                           {K.TRADES, K.USERREF, K.START, K.END, K.OFS,
+                            K.CLOSE_TIME},
+                           '?');
+        sink  +=  query.length ();
+      });
+
+    printf ("  %-26s %9.0f ns\n",  "build query",  ns);
+  }
+
+  {
+    auto const  signer  =  Request_Signer {secret};
+    auto  signature  =  Request_Signer::Signature {};
+    auto const  ns  =  nanoseconds_per_call (n * 10,  [&]
+      {
+        signer.sign ("/0/private/Balance", "1616492376594",
+                     "nonce=1616492376594", signature);
+        sink  +=  signature [0];
+      });
+
+    printf ("  %-26s %9.0f ns\n",  "sign",  ns);
+  }
+
+  for (auto const &[function, parse]
+          :  {pair<char const *, size_t (*) (string_view)>
+                 {"Depth",
+                  [] (string_view J) {  return parse_order_book (J)
+                                                   .asks.size ();  }},
+              pair<char const *, size_t (*) (string_view)>
+                 {"Trades",
+                  [] (string_view J) {  return parse_recent_trades (J)
+                                                   .size ();  }}})
+    {
+      auto const  json  =  exchange.response (function);
+      auto const  ns    =  nanoseconds_per_call (n,  [&]
+                                                 {  sink += parse (json);  });
+
+      printf ("  %-26s %9.0f ns   %6.0f MB/s\n",
+              (string {"parse "} + function).c_str (),
+              ns,  json.length () * 1.0e3 / ns);
+    }
+
+
+  cout  <<  "\nrequests to " << exchange.url_base () << ":\n";
+
+  sequential ("public, one at a time",  n,
+              [&K, &sink] {  sink += K.ticker_info ("XXBTZUSD").length ();  });
+
+  sequential ("private, one at a time",  n,
+              [&K, &sink] {  sink += K.account_balance ().length ();  });
+
+  windowed ((to_string (window) + " public in flight").c_str (),
+            n,  window,  K);
+
+
+  auto const  S  =  exchange.statistics ();
+  auto const  C  =  K.connection_statistics ();
+  auto const  A  =  Request_Arena::statistics ();
+
+  cout  <<  "\nconnections opened " << C.connections_opened
+        <<  ", reused " << C.connections_reused
+        <<  "; bad signatures " << S.bad_signatures
+        <<  ", stale nonces " << S.stale_nonces << '\n';
+
+  cout  <<  "request arena: " << A.requests << " requests, at most "
+        <<  A.high_water << " bytes, " << A.heap_allocations
+        <<  " heap allocations\n";
+
+  return  S.bad_signatures != 0  ||  S.stale_nonces != 0
+            ||  A.heap_allocations != 0  ||  sink == 0;
+}
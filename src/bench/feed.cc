@@ -0,0 +1,187 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Kraken_Feed driven against a local stand-in for Krakenʼs WebSocket
+ *  server (see mock-feed.h): through the upgrade, subscriptions answered
+ *  with fragmented messages (a ping in among the fragments) and with one
+ *  needing a 64-bit length, a close from the server side and the
+ *  resubscription which follows, and a frame too big to take, which
+ *  must be refused with close code 1009 before the client reconnects.
+
+ *      bench/feed
+
+ *  Prints what it checks, and how long the feed took over each step; the
+ *  exit status is non-zero if any check fails.  */
+
+
+#include "mock-feed.h"
+#include <dmbcs-kraken-feed.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace DMBCS;
+using namespace std;
+
+
+using  Clock  =  chrono::steady_clock;
+
+
+static  auto  failures  =  0;
+
+
+static  void  check  (char const *const what,  bool const ok)
+{
+  printf ("  %-56s %s\n",  what,  ok ? "ok" : "FAILED");
+  if (! ok)   ++failures;
+}
+
+
+/*  True if the condition came about within the time. */
+static  bool  wait_until  (function<bool ()> const &condition,
+                           chrono::seconds const limit
+                                                  =  chrono::seconds {10})
+{
+  auto const  deadline  =  Clock::now ()  +  limit;
+  while (! condition ())
+    {
+      if (Clock::now () > deadline)   return false;
+      this_thread::sleep_for (chrono::milliseconds {5});
+    }
+  return true;
+}
+
+
+
+int  main  ()
+{
+  auto  server  =  Mock_Feed {};
+
+  auto  lock      =  mutex {};
+  auto  statuses  =  vector<string> {};
+
+  auto  has_status  =  [&] (string const &fragment,  size_t const times)
+    {
+      auto  guard  =  lock_guard<mutex> {lock};
+      auto  n  =  size_t {0};
+      for (auto const &S  :  statuses)
+        if (S.find (fragment) != S.npos)   ++n;
+      return n >= times;
+    };
+
+  auto  trades  =  atomic<uint64_t> {0};
+  auto  books   =  atomic<uint64_t> {0};
+  auto  wrong   =  atomic<uint64_t> {0};
+
+  auto  feed  =  Kraken_Feed {server.url (),
+                              [&] (string_view const message)
+                                  {
+                                    auto  guard  =  lock_guard<mutex> {lock};
+                                    statuses.emplace_back (message);
+                                  }};
+
+  auto const  start  =  Clock::now ();
+  auto  step  =  start;
+  auto  lap   =  [&step] ()
+    {
+      auto const  now  =  Clock::now ();
+      auto const  ms   =  chrono::duration<double, milli> (now - step);
+      step  =  now;
+      return  ms.count ();
+    };
+
+  feed.subscribe (Kraken_Feed::TRADE,  {"XBT/USD", "ETH/USD"},
+                  [&] (Kraken_Feed::Channel,  string_view const pair,
+                       string_view const message)
+                      {
+                        if (message == Mock_Feed::message ("trade", pair))
+                          ++trades;
+                        else
+                          ++wrong;
+                      });
+
+  feed.subscribe (Kraken_Feed::BOOK,  {"XBT/USD"},
+                  [&] (Kraken_Feed::Channel,  string_view const pair,
+                       string_view const message)
+                      {
+                        if (message == Mock_Feed::message ("book-10", pair))
+                          ++books;
+                        else
+                          ++wrong;
+                      },
+                  10);
+
+  printf ("handshake and subscriptions\n");
+  check ("connected, and the systemStatus passed on",
+         wait_until ([&] {  return  has_status ("feedConnected", 1)
+                                &&  has_status ("systemStatus", 1);  }));
+  check ("fragmented trade messages put back together",
+         wait_until ([&] {  return trades >= 2;  }));
+  check ("book message with a 64-bit length",
+         wait_until ([&] {  return books >= 1;  }));
+  check ("pings among the fragments answered",
+         wait_until ([&] {  return server.statistics ().pongs >= 2;  }));
+  printf ("  (%.1f ms)\n",  lap ());
+
+  printf ("close from the server\n");
+  server.close_connections ();
+  check ("close echoed with the same code",
+         wait_until ([&] {  return server.statistics ().close_code
+                                     ==  1001;  }));
+  check ("disconnection reported",
+         wait_until ([&] {  return has_status ("feedDisconnected", 1);  }));
+  check ("reconnected",
+         wait_until ([&] {  return feed.reconnections () == 1
+                                &&  feed.connected ();  }));
+  check ("all three subscriptions renewed, and data flowing again",
+         wait_until ([&] {  return server.statistics ().subscriptions >= 6
+                                &&  trades >= 4  &&  books >= 2;  }));
+  printf ("  (%.1f ms)\n",  lap ());
+
+  printf ("oversized frame\n");
+  server.send_oversized ();
+  check ("refused with close code 1009",
+         wait_until ([&] {  return server.statistics ().close_code
+                                     ==  1009;  }));
+  check ("reconnected and resubscribed",
+         wait_until ([&] {  return feed.reconnections () == 2
+                                &&  server.statistics ().subscriptions >= 9
+                                &&  trades >= 6  &&  books >= 3;  }));
+  printf ("  (%.1f ms)\n",  lap ());
+
+  auto const  S  =  server.statistics ();
+  check ("no message handed over wrongly",  wrong == 0);
+
+  cout  <<  '\n'  <<  S.connections  <<  " connections, "
+        <<  S.subscriptions  <<  " subscriptions, "  <<  S.pongs
+        <<  " pongs, "  <<  feed.messages_received ()
+        <<  " messages received in "
+        <<  chrono::duration<double, milli> (Clock::now () - start).count ()
+        <<  " ms\n";
+
+  return  failures != 0;
+}
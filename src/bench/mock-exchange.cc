@@ -0,0 +1,445 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "mock-exchange.h"
+#include <dmbcs-kraken-api.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Mock_Exchange  M;
+
+
+
+  /*  Responses as Kraken sent them, trimmed to one pair. */
+  static  char const *const  RECORDED [][2]
+  {
+    {"Time",
+     R"({"error":[],"result":{"unixtime":1688669448,)"
+     R"("rfc1123":"Thu, 06 Jul 23 18:50:48 +0000"}})"},
+
+    {"Ticker",
+     R"({"error":[],"result":{"XXBTZUSD":{"a":["30300.10000","1","1.000"],)"
+     R"("b":["30300.00000","1","1.000"],"c":["30303.20000","0.00067643"],)"
+     R"("v":["4083.67001100","4412.73601799"],)"
+     R"("p":["30706.77771","30689.13205"],"t":[34619,38907],)"
+     R"("l":["29868.30000","29868.30000"],)"
+     R"("h":["31631.00000","31631.00000"],"o":"30502.80000"}}})"},
+
+    {"Balance",
+     R"({"error":[],"result":{"ZUSD":"171288.6158","ZEUR":"504861.8946",)"
+     R"("XXBT":"1011.1908877900","XETH":"818.5500000000"}})"},
+
+    {"TradeBalance",
+     R"({"error":[],"result":{"eb":"1101.3425","tb":"392.2264",)"
+     R"("m":"7.0354","n":"-10.0232","c":"21.1063","v":"31.1297",)"
+     R"("e":"382.2032","mf":"375.1678","ml":"5432.57"}})"},
+
+    {"OpenOrders",
+     R"({"error":[],"result":{"open":{"OQCLML-BW3P3-BUCMWZ":{"refid":null,)"
+     R"("userref":0,"status":"open","opentm":1688666559.8974,)"
+     R"("starttm":0,"expiretm":0,"descr":{"pair":"XBTUSD","type":"buy",)"
+     R"("ordertype":"limit","price":"30010.0","price2":"0",)"
+     R"("leverage":"none","order":"buy 1.25000000 XBTUSD @ limit 30010.0",)"
+     R"("close":""},"vol":"1.25000000","vol_exec":"0.37500000",)"
+     R"("cost":"11253.7","fee":"0.00000","price":"30010.0",)"
+     R"("stopprice":"0.00000","limitprice":"0.00000","misc":"",)"
+     R"("oflags":"fciq","trades":["TCCCTY-WE2O6-P3NB37"]}}}})"},
+
+    {"AddOrder",
+     R"({"error":[],"result":{"descr":{"order":)"
+     R"("buy 1.25000000 XBTUSD @ limit 27500.0"},)"
+     R"("txid":["OU22CG-KLAF2-FWUDD7"]}})"},
+
+    {"CancelOrder",
+     R"({"error":[],"result":{"count":1}})"},
+
+    {"AddOrderBatch",
+     R"({"error":[],"result":{"orders":[{"txid":"65LRD3-AHGRA-YAH8V5",)"
+     R"("descr":{"order":"buy 0.80300000 XBTUSD @ limit 28300.0"}},)"
+     R"({"error":"EOrder:Insufficient funds"}]}})"},
+
+    {"CancelOrderBatch",
+     R"({"error":[],"result":{"count":2}})"},
+
+    {"CancelAll",
+     R"({"error":[],"result":{"count":4}})"},
+  };
+
+
+
+  /*  Larger responses, in the form Kraken sends them, made up so as not
+   *  to have pages of numbers here.  */
+
+  static  string  made_up_depth  (size_t const levels)
+  {
+    auto  ret  =  string {R"({"error":[],"result":{"XXBTZUSD":{"asks":[)"};
+    char  buffer [96];
+
+    for (auto side = 0;  side < 2;  ++side)
+      {
+        if (side)   ret  +=  R"(],"bids":[)";
+        for (auto i = size_t {0};  i < levels;  ++i)
+          {
+            auto const  price  =  side ? 30300.0 - 0.1 * i : 30300.1 + 0.1 * i;
+            snprintf (buffer, sizeof buffer,
+                      R"(%s["%.5f","%.3f",%zu])",
+                      i ? "," : "",  price,  0.125 * (i % 17 + 1),
+                      size_t {1688669000} + i);
+            ret  +=  buffer;
+          }
+      }
+
+    return  ret  +  "]}}}";
+  }
+
+
+  static  string  made_up_trades  (size_t const count)
+  {
+    auto  ret  =  string {R"({"error":[],"result":{"XXBTZUSD":[)"};
+    char  buffer [128];
+
+    for (auto i = size_t {0};  i < count;  ++i)
+      {
+        snprintf (buffer, sizeof buffer,
+                  R"(%s["%.5f","%.8f",%.4f,"%c","%c","",%zu])",
+                  i ? "," : "",  30300.0 + 0.1 * (i % 50),
+                  0.00012345 * (i % 29 + 1),  1688669000.0 + 0.25 * i,
+                  i % 3 ? 'b' : 's',  i % 5 ? 'l' : 'm',  i + 1);
+        ret  +=  buffer;
+      }
+
+    return  ret  +  R"(],"last":"1688669250000000000"}})";
+  }
+
+
+
+  struct  M::Implementation
+  {
+    explicit  Implementation  (string const &secret)  :  signer {secret}
+    {
+      for (auto const &R  :  RECORDED)
+        responses [R [0]]  =  make_shared<string const> (R [1]);
+
+      responses ["Depth"]   =  make_shared<string const> (made_up_depth (100));
+      responses ["Trades"]  =  make_shared<string const>
+                                                     (made_up_trades (1000));
+
+      listener  =  socket (AF_INET, SOCK_STREAM, 0);
+      if (listener < 0)   throw runtime_error {"mock exchange: no socket"};
+
+      auto  one  =  1;
+      setsockopt (listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+      auto  address  =  sockaddr_in {};
+      address.sin_family       =  AF_INET;
+      address.sin_addr.s_addr  =  htonl (INADDR_LOOPBACK);
+      address.sin_port         =  0;
+
+      auto  length  =  socklen_t {sizeof address};
+      if (bind (listener,
+                reinterpret_cast<sockaddr*> (&address), sizeof address)
+            ||  listen (listener, 64)
+            ||  getsockname (listener,
+                             reinterpret_cast<sockaddr*> (&address),
+                             &length))
+        {
+          close (listener);
+          throw runtime_error {"mock exchange: cannot listen"};
+        }
+
+      port  =  ntohs (address.sin_port);
+
+      acceptor  =  thread {[this] {  accept_connections ();  }};
+    }
+
+
+    ~Implementation  ()
+    {
+      stopping  =  true;
+      shutdown (listener, SHUT_RDWR);
+      acceptor.join ();
+      close (listener);
+
+      {
+        auto  guard  =  lock_guard<mutex> {lock};
+        for (auto const fd  :  open)   shutdown (fd, SHUT_RDWR);
+      }
+
+      for (auto &W  :  workers)   W.join ();
+    }
+
+
+    void  accept_connections  ()
+    {
+      while (! stopping)
+        {
+          auto const  fd  =  accept (listener, nullptr, nullptr);
+          if (fd < 0)   continue;
+
+          auto  one  =  1;
+          setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+          auto  guard  =  lock_guard<mutex> {lock};
+          if (stopping)   {  close (fd);  break;  }
+          open.push_back (fd);
+          workers.emplace_back ([this, fd] {  serve (fd);  });
+        }
+    }
+
+
+    static  string_view  header  (string_view const head,
+                                  string_view const name)
+    {
+      for (auto at = head.find ("\r\n");  at != head.npos;
+               at = head.find ("\r\n", at + 2))
+        {
+          auto const  line  =  head.substr (at + 2,
+                                            head.find ("\r\n", at + 2)
+                                              - at - 2);
+          if (line.length () <= name.length ()
+                ||  line [name.length ()] != ':')
+            continue;
+
+          auto  match  =  true;
+          for (auto i = size_t {0};  i < name.length ()  &&  match;  ++i)
+            match  =  tolower (line [i]) == tolower (name [i]);
+
+          if (match)
+            {
+              auto  value  =  line.substr (name.length () + 1);
+              while (! value.empty ()  &&  value [0] == ' ')
+                value.remove_prefix (1);
+              return value;
+            }
+        }
+
+      return {};
+    }
+
+
+    /*  One connection, for as many requests as the client makes on it. */
+    void  serve  (int const fd)
+    {
+      auto  in      =  string {};
+      auto  buffer  =  array<char, 16384> {};
+
+      auto  fill  =  [&] ()
+        {
+          auto const  n  =  recv (fd, buffer.data (), buffer.size (), 0);
+          if (n <= 0)   return false;
+          in.append (buffer.data (), n);
+          return true;
+        };
+
+      auto  write  =  [fd] (string const &out)
+        {
+          for (auto sent = size_t {0};  sent < out.length ();  )
+            {
+              auto const  n  =  send (fd, out.data () + sent,
+                                      out.length () - sent, MSG_NOSIGNAL);
+              if (n <= 0)   return false;
+              sent  +=  n;
+            }
+          return true;
+        };
+
+      for (auto alive = true;  alive;  )
+        {
+          auto const  head_end  =  in.find ("\r\n\r\n");
+          if (head_end == in.npos)
+            {
+              alive  =  fill ();
+              continue;
+            }
+
+          auto const  head    =  string {in, 0, head_end + 2};
+          auto const  field   =  header (head, "Content-Length");
+          auto        length  =  size_t {0};
+          from_chars (field.data (), field.data () + field.length (), length);
+
+          auto const  total  =  head_end + 4 + length;
+          while (alive  &&  in.length () < total)   alive  =  fill ();
+          if (! alive)   break;
+
+          auto const  start   =  head.find (' ') + 1;
+          auto const  end     =  head.find (' ', start);
+          auto const  target  =  string_view {head}.substr (start,
+                                                            end - start);
+          auto const  reply   =  respond (target,
+                                          header (head, "API-Key"),
+                                          header (head, "API-Sign"),
+                                          string_view {in}.substr
+                                                     (head_end + 4, length));
+
+          auto  out  =  string {"HTTP/1.1 200 OK\r\n"
+                                "Content-Type: application/json\r\n"
+                                "Content-Length: "};
+          out  +=  to_string (reply->length ());
+          out  +=  "\r\n\r\n";
+          out  +=  *reply;
+
+          alive  =  write (out);
+          in.erase (0, total);
+        }
+
+      auto  guard  =  lock_guard<mutex> {lock};
+      open.erase (find (open.begin (), open.end (), fd));
+      close (fd);
+    }
+
+
+    shared_ptr<string const>  respond  (string_view const target,
+                                        string_view const api_key,
+                                        string_view const api_sign,
+                                        string_view const body)
+    {
+      auto const  path      =  target.substr (0, target.find ('?'));
+      auto const  function  =  string {path.substr (path.rfind ('/') + 1)};
+
+      if (path.find ("/private/") != path.npos)
+        {
+          ++private_requests;
+
+          auto const  at     =  body.find ("nonce=");
+          auto const  nonce  =  at == body.npos
+                                   ?  string_view {}
+                                   :  body.substr (at + 6,
+                                                   body.find ('&', at)
+                                                     - at - 6);
+
+          auto  signature  =  Request_Signer::Signature {};
+          signer.sign (path, nonce, body, signature);
+          if (api_sign != signature.data ())
+            {
+              ++bad_signatures;
+              return  invalid_key;
+            }
+
+          /*  Kraken keeps the last nonce of each key. */
+          auto  n  =  uint64_t {0};
+          from_chars (nonce.data (), nonce.data () + nonce.length (), n);
+
+          auto  guard  =  lock_guard<mutex> {lock};
+          auto &last  =  last_nonces [string {api_key}];
+          if (n <= last)
+            {
+              ++stale_nonces;
+              return  invalid_nonce;
+            }
+          last  =  n;
+        }
+      else
+        ++public_requests;
+
+      auto  guard  =  lock_guard<mutex> {lock};
+      auto const  R  =  responses.find (function);
+      return  R == responses.end ()  ?  unknown_method  :  R->second;
+    }
+
+
+    Request_Signer const  signer;
+
+    int       listener  {-1};
+    uint16_t  port      {0};
+
+    atomic<bool>      stopping          {false};
+    atomic<uint64_t>  public_requests   {0};
+    atomic<uint64_t>  private_requests  {0};
+    atomic<uint64_t>  bad_signatures    {0};
+    atomic<uint64_t>  stale_nonces      {0};
+
+    mutable mutex                             lock;
+    map<string, shared_ptr<string const>>     responses;
+    map<string, uint64_t>                     last_nonces;
+    vector<int>                               open;
+    vector<thread>                            workers;
+    thread                                    acceptor;
+
+    shared_ptr<string const> const  invalid_key
+      {make_shared<string const> (R"({"error":["EAPI:Invalid key"]})")};
+    shared_ptr<string const> const  invalid_nonce
+      {make_shared<string const> (R"({"error":["EAPI:Invalid nonce"]})")};
+    shared_ptr<string const> const  unknown_method
+      {make_shared<string const> (R"({"error":["EGeneral:Unknown method"]})")};
+  };
+
+
+
+  M::Mock_Exchange  (string const &secret)
+    :  implementation {make_unique<Implementation> (secret)}
+  {}
+
+
+  M::~Mock_Exchange  ()  =  default;
+
+
+  string  M::url_base  ()  const
+  {
+    return  "http://127.0.0.1:"  +  to_string (implementation->port)  +  "/0/";
+  }
+
+
+  void  M::set_response  (string const &function,  string json)
+  {
+    auto  guard  =  lock_guard<mutex> {implementation->lock};
+    implementation->responses [function]
+                     =  make_shared<string const> (move (json));
+  }
+
+
+  string  M::response  (string const &function)  const
+  {
+    auto  guard  =  lock_guard<mutex> {implementation->lock};
+    auto const  R  =  implementation->responses.find (function);
+    return  R == implementation->responses.end ()  ?  string {}  :  *R->second;
+  }
+
+
+  M::Statistics  M::statistics  ()  const
+  {
+    auto const &I  =  *implementation;
+    auto  ret  =  Statistics {};
+    ret.public_requests   =  I.public_requests;
+    ret.private_requests  =  I.private_requests;
+    ret.bad_signatures    =  I.bad_signatures;
+    ret.stale_nonces      =  I.stale_nonces;
+    return ret;
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,92 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_API__MOCK_EXCHANGE__H
+#define DMBCS_KRAKEN_API__MOCK_EXCHANGE__H
+
+
+/*  A stand-in for Krakenʼs REST server, for the benchmarks: plain HTTP/1.1
+ *  with keep-alive on the loop-back interface, answering each API
+ *  function with a recorded response and checking the API-Sign header of
+ *  every private request against the secret it was given.  */
+
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  class  Mock_Exchange
+  {
+  public:
+
+    struct  Statistics
+    {
+      uint64_t  public_requests   {0};
+      uint64_t  private_requests  {0};
+
+      /*  Private requests whose API-Sign did not match. */
+      uint64_t  bad_signatures    {0};
+
+      /*  Private requests whose nonce was not greater than the last with
+       *  the same key.  */
+      uint64_t  stale_nonces      {0};
+    };
+
+
+    /*  Listens on an ephemeral port of 127.0.0.1 from the start. */
+    explicit  Mock_Exchange  (string const &secret);
+
+    ~Mock_Exchange  ();
+
+    Mock_Exchange  (Mock_Exchange const &)  =  delete;
+    Mock_Exchange &  operator=  (Mock_Exchange const &)  =  delete;
+
+
+    /*  To pass to Kraken_API::set_url_base. */
+    string  url_base  ()  const;
+
+    /*  Replace the recorded response to an API function, by name. */
+    void  set_response  (string const &function,  string json);
+
+    string  response  (string const &function)  const;
+
+    Statistics  statistics  ()  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Mock_Exchange.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_API__MOCK_EXCHANGE__H.  */
@@ -0,0 +1,434 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "mock-feed.h"
+#include <openssl/evp.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Mock_Feed  M;
+
+
+
+  /*  The payload of every ping the stand-in sends. */
+  static  constexpr  string_view  PING  {"mock-ping"};
+
+
+
+  /*  An unmasked frame, as servers send them. */
+  static  string  frame  (uint8_t const opcode,  string_view const payload,
+                          bool const fin  =  true)
+  {
+    auto  ret  =  string {};
+    ret  +=  static_cast<char> ((fin ? 0x80 : 0)  |  opcode);
+
+    auto const  length  =  uint64_t {payload.length ()};
+    if (length < 126)
+      ret  +=  static_cast<char> (length);
+    else if (length < 65536)
+      {
+        ret  +=  static_cast<char> (126);
+        for (auto shift = 8;  shift >= 0;  shift -= 8)
+          ret  +=  static_cast<char> (length >> shift);
+      }
+    else
+      {
+        ret  +=  static_cast<char> (127);
+        for (auto shift = 56;  shift >= 0;  shift -= 8)
+          ret  +=  static_cast<char> (length >> shift);
+      }
+
+    return  ret  +=  payload;
+  }
+
+
+
+  /*  The first string value after "key": in text, which is small. */
+  static  string  value_of  (string_view const text,  string_view const key)
+  {
+    auto const  at  =  text.find ("\"" + string {key} + "\":");
+    if (at == text.npos)   return {};
+
+    auto const  start  =  text.find_first_not_of (" \"", at + key.length ()
+                                                          + 3);
+    auto const  end    =  text.find_first_of ("\",}", start);
+    return  string {text.substr (start, end - start)};
+  }
+
+
+
+  struct  M::Implementation
+  {
+    /*  One client; frames may be sent on it from the controlling thread
+     *  as well as its own.  */
+    struct  Connection
+    {
+      explicit  Connection  (int const F)  :  fd {F}  {}
+
+      bool  write  (string_view out)
+      {
+        auto  guard  =  lock_guard<mutex> {lock};
+        while (! out.empty ())
+          {
+            auto const  n  =  send (fd, out.data (), out.length (),
+                                    MSG_NOSIGNAL);
+            if (n <= 0)   return false;
+            out.remove_prefix (n);
+          }
+        return true;
+      }
+
+      int const  fd;
+      mutex      lock;
+    };
+
+
+    Implementation  ()
+    {
+      listener  =  socket (AF_INET, SOCK_STREAM, 0);
+      if (listener < 0)   throw runtime_error {"mock feed: no socket"};
+
+      auto  one  =  1;
+      setsockopt (listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+      auto  address  =  sockaddr_in {};
+      address.sin_family       =  AF_INET;
+      address.sin_addr.s_addr  =  htonl (INADDR_LOOPBACK);
+      address.sin_port         =  0;
+
+      auto  length  =  socklen_t {sizeof address};
+      if (bind (listener,
+                reinterpret_cast<sockaddr*> (&address), sizeof address)
+            ||  listen (listener, 16)
+            ||  getsockname (listener,
+                             reinterpret_cast<sockaddr*> (&address),
+                             &length))
+        {
+          close (listener);
+          throw runtime_error {"mock feed: cannot listen"};
+        }
+
+      port  =  ntohs (address.sin_port);
+
+      acceptor  =  thread {[this] {  accept_connections ();  }};
+    }
+
+
+    ~Implementation  ()
+    {
+      stopping  =  true;
+      shutdown (listener, SHUT_RDWR);
+      acceptor.join ();
+      close (listener);
+
+      {
+        auto  guard  =  lock_guard<mutex> {lock};
+        for (auto const &C  :  open)   shutdown (C->fd, SHUT_RDWR);
+      }
+
+      for (auto &W  :  workers)   W.join ();
+    }
+
+
+    void  accept_connections  ()
+    {
+      while (! stopping)
+        {
+          auto const  fd  =  accept (listener, nullptr, nullptr);
+          if (fd < 0)   continue;
+
+          auto  one  =  1;
+          setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+          auto  guard  =  lock_guard<mutex> {lock};
+          if (stopping)   {  close (fd);  break;  }
+          auto  C  =  make_shared<Connection> (fd);
+          open.push_back (C);
+          workers.emplace_back ([this, C] {  serve (*C);  });
+        }
+    }
+
+
+    static  string  accept_key  (string const &key)
+    {
+      auto const  text  =  key  +  "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+      auto  digest  =  array<unsigned char, EVP_MAX_MD_SIZE> {};
+      auto  length  =  0u;
+      EVP_Digest (text.data (), text.length (), digest.data (), &length,
+                  EVP_sha1 (), nullptr);
+
+      auto  ret  =  string (4 * ((length + 2) / 3),  '\0');
+      EVP_EncodeBlock (reinterpret_cast<unsigned char*> (ret.data ()),
+                       digest.data (),  int (length));
+      return ret;
+    }
+
+
+    /*  The answer to a subscribe request. */
+    bool  subscribed  (Connection &C,  string_view const request)
+    {
+      auto const  name   =  value_of (request, "name");
+      auto const  depth  =  value_of (request, "depth");
+      auto const  channel  =  depth.empty ()  ?  name  :  name + '-' + depth;
+
+      auto const  list   =  request.find ("\"pair\":[");
+      auto const  end    =  request.find (']', list);
+
+      for (auto at = request.find ('"', list + 8);
+               at != request.npos  &&  at < end;
+               at = request.find ('"', request.find ('"', at + 1) + 1))
+        {
+          auto const  pair  =  request.substr (at + 1,
+                                               request.find ('"', at + 1)
+                                                 - at - 1);
+          ++subscriptions;
+
+          auto  out  =  frame (0x1, "{\"channelName\":\"" + channel
+                                    + "\",\"event\":\"subscriptionStatus\","
+                                    "\"pair\":\"" + string {pair}
+                                    + "\",\"status\":\"subscribed\","
+                                    "\"subscription\":{\"name\":\""
+                                    + name + "\"}}");
+
+          auto const  data  =  message (channel, pair);
+          if (name == "book")
+            out  +=  frame (0x1, data);
+          else
+            {
+              auto const  third  =  data.length () / 3;
+              out  +=  frame (0x1, string_view {data}.substr (0, third),
+                              false);
+              out  +=  frame (0x9, PING);
+              out  +=  frame (0x0, string_view {data}.substr (third, third),
+                              false);
+              out  +=  frame (0x0, string_view {data}.substr (2 * third));
+            }
+
+          out  +=  frame (0x1, "{\"event\":\"heartbeat\"}");
+
+          if (! C.write (out))   return false;
+        }
+
+      return true;
+    }
+
+
+    /*  One client, from the upgrade until either side closes. */
+    void  serve  (Connection &C)
+    {
+      auto  in      =  string {};
+      auto  buffer  =  array<char, 16384> {};
+
+      auto  fill  =  [&] ()
+        {
+          auto const  n  =  recv (C.fd, buffer.data (), buffer.size (), 0);
+          if (n <= 0)   return false;
+          in.append (buffer.data (), n);
+          return true;
+        };
+
+      auto  alive  =  true;
+
+      auto  head_end  =  string::npos;
+      while (alive  &&  (head_end = in.find ("\r\n\r\n")) == in.npos)
+        alive  =  fill ();
+
+      if (alive)
+        {
+          ++connections;
+
+          auto const  field  =  in.find ("Sec-WebSocket-Key:");
+          auto  key  =  string {};
+          if (field < head_end)
+            {
+              auto const  start  =  in.find_first_not_of (' ', field + 18);
+              key  =  in.substr (start,  in.find ('\r', start) - start);
+            }
+          in.erase (0, head_end + 4);
+
+          alive  =  C.write ("HTTP/1.1 101 Switching Protocols\r\n"
+                             "Upgrade: websocket\r\n"
+                             "Connection: Upgrade\r\n"
+                             "Sec-WebSocket-Accept: " + accept_key (key)
+                             + "\r\n\r\n"
+                             +  frame (0x1, "{\"connectionID\":1,"
+                                            "\"event\":\"systemStatus\","
+                                            "\"status\":\"online\","
+                                            "\"version\":\"1.9.0\"}"));
+        }
+
+      while (alive)
+        {
+          /*  Clientsʼ frames are masked, and are never big here. */
+          if (in.length () < 2)   {  alive  =  fill ();  continue;  }
+
+          auto const  *const  B  =  reinterpret_cast<uint8_t const*>
+                                                               (in.data ());
+          auto const  opcode  =  B [0] & 0x0f;
+          auto  length  =  size_t {B [1] & 0x7fu};
+          auto  header  =  size_t {6};
+          if (length == 126)
+            {
+              if (in.length () < 4)   {  alive  =  fill ();  continue;  }
+              length  =  (size_t {B [2]} << 8)  |  B [3];
+              header  =  8;
+            }
+
+          if (in.length () < header + length)   {  alive  =  fill ();
+                                                   continue;  }
+
+          auto  payload  =  in.substr (header, length);
+          for (auto i = size_t {0};  i < length;  ++i)
+            payload [i]  ^=  B [header - 4 + i % 4];
+          in.erase (0, header + length);
+
+          switch (opcode)
+            {
+            case 0x1:
+              if (value_of (payload, "event") == "subscribe")
+                alive  =  subscribed (C, payload);
+              break;
+
+            case 0x8:
+              if (payload.length () >= 2)
+                close_code  =  uint16_t ((uint8_t (payload [0]) << 8)
+                                         |  uint8_t (payload [1]));
+              C.write (frame (0x8, payload.substr (0, 2)));
+              alive  =  false;
+              break;
+
+            case 0xa:
+              if (payload == PING)   ++pongs;
+              break;
+            }
+        }
+
+      auto  guard  =  lock_guard<mutex> {lock};
+      open.erase (find_if (open.begin (), open.end (),
+                           [&C] (auto const &O)
+                             {  return O.get () == &C;  }));
+      shutdown (C.fd, SHUT_RDWR);
+      close (C.fd);
+    }
+
+
+    void  to_all  (string const &out)
+    {
+      auto  guard  =  lock_guard<mutex> {lock};
+      for (auto const &C  :  open)   C->write (out);
+    }
+
+
+    int       listener  {-1};
+    uint16_t  port      {0};
+
+    atomic<bool>      stopping       {false};
+    atomic<uint64_t>  connections    {0};
+    atomic<uint64_t>  subscriptions  {0};
+    atomic<uint64_t>  pongs          {0};
+    atomic<uint16_t>  close_code     {0};
+
+    mutable mutex                    lock;
+    list<shared_ptr<Connection>>     open;
+    vector<thread>                   workers;
+    thread                           acceptor;
+  };
+
+
+
+  M::Mock_Feed  ()  :  implementation {make_unique<Implementation> ()}
+  {}
+
+
+  M::~Mock_Feed  ()  =  default;
+
+
+  string  M::url  ()  const
+  {
+    return  "ws://127.0.0.1:"  +  to_string (implementation->port)  +  "/";
+  }
+
+
+  string  M::message  (string_view const channel,  string_view const pair)
+  {
+    auto  ret  =  string {"[0,"};
+
+    if (channel.compare (0, 4, "book") == 0)
+      {
+        /*  Enough levels to need a 64-bit frame length. */
+        ret  +=  "{\"as\":[";
+        for (auto i = 0;  i < 3000;  ++i)
+          {
+            if (i)   ret  +=  ',';
+            ret  +=  "[\"" + to_string (30300 + i) + ".10000\",\"0.50000000\","
+                     "\"1688669448.885400\"]";
+          }
+        ret  +=  "]}";
+      }
+    else
+      ret  +=  "[[\"30300.10000\",\"0.00067643\",\"1688669448.885400\","
+               "\"s\",\"l\",\"\"]]";
+
+    return  ret  +  ",\""  +  string {channel}  +  "\",\""  +  string {pair}
+                 +  "\"]";
+  }
+
+
+  void  M::close_connections  ()
+  {   implementation->to_all (frame (0x8, string_view {"\x03\xe9", 2}));   }
+
+
+  void  M::send_oversized  ()
+  {
+    implementation->to_all (string {"\x81\x7f\x7f\xff\xff\xff\xff\xff\xff"
+                                    "\xff", 10});
+  }
+
+
+  M::Statistics  M::statistics  ()  const
+  {
+    auto const &I  =  *implementation;
+    auto  ret  =  Statistics {};
+    ret.connections    =  I.connections;
+    ret.subscriptions  =  I.subscriptions;
+    ret.pongs          =  I.pongs;
+    ret.close_code     =  I.close_code;
+    return ret;
+  }
+
+
+}  /* End of namespace DMBCS. */
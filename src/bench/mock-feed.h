@@ -0,0 +1,105 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_API__MOCK_FEED__H
+#define DMBCS_KRAKEN_API__MOCK_FEED__H
+
+
+/*  A stand-in for Krakenʼs WebSocket feed, for exercising Kraken_Feed on
+ *  the loop-back interface: it answers the HTTP upgrade, and answers
+ *  each subscription with a subscriptionStatus and then a data message
+ *  for every pair, the trade data split over three frames with a ping
+ *  between them, the book data in one frame large enough to need a
+ *  64-bit length.  The connections can be closed from the server side,
+ *  or sent a frame too big for the client to take, at any time.  */
+
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  class  Mock_Feed
+  {
+  public:
+
+    struct  Statistics
+    {
+      uint64_t  connections    {0};
+
+      /*  Of one pair to one channel; renewals after a reconnection
+       *  count again.  */
+      uint64_t  subscriptions  {0};
+
+      /*  Answers to pings which carried the payload the ping did. */
+      uint64_t  pongs          {0};
+
+      /*  The code in the last close frame the client sent, or zero. */
+      uint16_t  close_code     {0};
+    };
+
+
+    /*  Listens on an ephemeral port of 127.0.0.1 from the start. */
+    Mock_Feed  ();
+
+    ~Mock_Feed  ();
+
+    Mock_Feed  (Mock_Feed const &)  =  delete;
+    Mock_Feed &  operator=  (Mock_Feed const &)  =  delete;
+
+
+    /*  To give to the Kraken_Feed constructor. */
+    string  url  ()  const;
+
+    /*  The data message sent for a pair on a channel, the channel named
+     *  as in the messages (e.g. "book-10").  */
+    static  string  message  (string_view channel,  string_view pair);
+
+    /*  Send a close frame, with code 1001 (going away), on every open
+     *  connection.  */
+    void  close_connections  ();
+
+    /*  Send, on every open connection, the header of a frame claiming
+     *  more bytes than anyone should accept.  */
+    void  send_oversized  ();
+
+    Statistics  statistics  ()  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Mock_Feed.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_API__MOCK_FEED__H.  */
@@ -0,0 +1,123 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*  Micro-benchmark of the private-request signing path: the original
+ *  method, which decodes the secret and builds fresh OpenSSL contexts and
+ *  strings for every request, against Request_Signer.  */
+
+
+#include <dmbcs-kraken-api.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+  /*  Defined in crypto.cc.  */
+  array<uint8_t, 32>  sha256         (string const &);
+  vector<uint8_t>     hmac_sha512    (vector<uint8_t> const &data,
+                                      vector<uint8_t> const &key);
+  vector<uint8_t>     base64_decode  (string const  &);
+  string              base64_encode  (vector<uint8_t> const &);
+
+}
+
+
+using namespace DMBCS;
+
+
+
+/*  Exactly as query_private used to do it. */
+static  string  sign_per_call  (string const &secret,
+                                string const &short_url,
+                                string const &nonce,
+                                string const &post_data)
+{
+  auto const  D       =  sha256 (nonce  +  post_data);
+  auto const  digest  =  short_url  +  string {begin (D), end (D)};
+
+  return  base64_encode  
+              (hmac_sha512  (vector<uint8_t> {begin (digest), end (digest)},
+                             base64_decode (secret)));
+}
+
+
+
+template <typename F>
+static  double  nanoseconds_per_call  (size_t const  n,  F  f)
+{
+  auto const  start  =  chrono::steady_clock::now ();
+  for (auto i = size_t {0};  i < n;  ++i)   f ();
+  auto const  end  =  chrono::steady_clock::now ();
+
+  return  chrono::duration<double, nano> (end - start).count () / n;
+}
+
+
+
+int  main  (int argc,  char **argv)
+{
+  auto const  n  =  argc > 1  ?  size_t (stoul (argv [1]))  :  size_t {200000};
+
+  /*  Any 64 bytes will do. */
+  auto const  secret  =  string {"kQH5HW/8p1uGOVjbgWA7FunAmGO8lsSUXNsu3eow76sz"
+                                 "84Q18fWxnyRzBHCd3pd5nE9qa99HAZtuZuj6F1huXg=="};
+
+  auto const  short_url  =  string {"/0/private/AddOrder"};
+  auto const  nonce      =  string {"1616492376594"};
+  auto const  post_data  =  string {"pair=XXBTZUSD&type=buy&ordertype=limit"
+                                    "&volume=1.25&price=37500"
+                                    "&nonce=1616492376594"};
+
+  auto const  signer  =  Request_Signer {secret};
+  auto  signature  =  Request_Signer::Signature {};
+
+  signer.sign (short_url, nonce, post_data, signature);
+  if (sign_per_call (secret, short_url, nonce, post_data)
+        !=  signature.data ())
+    {
+      cerr  <<  "signatures differ\n";
+      return 1;
+    }
+
+  auto  sink  =  size_t {0};
+
+  auto const  before
+    =  nanoseconds_per_call (n,  [&]
+                                 {  sink += sign_per_call (secret, short_url,
+                                                           nonce, post_data)
+                                                .length ();  });
+
+  auto const  after
+    =  nanoseconds_per_call (n,  [&]
+                                 {  signer.sign (short_url, nonce, post_data,
+                                                 signature);
+                                    sink += signature [0];  });
+
+  cout  <<  "signing, per call (" << n << " iterations):\n"
+        <<  "  decode and sign afresh:  " << before << " ns\n"
+        <<  "  Request_Signer:          " << after  << " ns\n";
+
+  return  sink == 0;
+}
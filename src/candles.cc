@@ -0,0 +1,381 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-candles.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Candle_Store  C;
+
+
+  /*  Those Kraken will give. */
+  static  constexpr  array<int, 9>  KRAKEN_INTERVALS
+                            {  1, 5, 15, 30, 60, 240, 1440, 10080, 21600  };
+
+
+
+  /*  A ringʼs bars are storage [offset, offset + capacity) of its
+   *  seriesʼ block, the oldest being at offset + start.  */
+  struct  Ring
+  {
+    size_t  offset    {0};
+    size_t  capacity  {0};
+    size_t  start     {0};
+    size_t  count     {0};
+
+    /*  Whether bars have ever been pushed out of the full ring. */
+    bool    dropped   {false};
+  };
+
+
+  struct  Series
+  {
+    vector<OHLC_Bar>  storage;
+    vector<Ring>      rings;
+    int64_t           since  {0};
+
+
+    OHLC_Bar &  bar  (Ring const &R,  size_t const i)
+    {   return storage [R.offset + (R.start + i) % R.capacity];   }
+
+
+    /*  Add the bar after the newest, or replace the newest if it has the
+     *  same time; older bars are ignored.  */
+    bool  put  (Ring &R,  OHLC_Bar const &B)
+    {
+      if (R.count)
+        {
+          auto &last  =  bar (R, R.count - 1);
+          if (B.time == last.time)   {  last  =  B;   return true;  }
+          if (B.time < last.time)    return false;
+        }
+
+      if (R.count < R.capacity)
+        ++R.count;
+      else
+        {
+          R.start    =  (R.start + 1) % R.capacity;
+          R.dropped  =  true;
+        }
+
+      bar (R, R.count - 1)  =  B;
+      return true;
+    }
+
+
+    /*  Rebuild the bars of ring r, width seconds long, which cover the
+     *  base bars from index from onwards.  */
+    void  aggregate  (size_t const r,  int64_t const width,  size_t from)
+    {
+      auto const &base    =  rings [0];
+      auto const  bucket  =  [width] (int64_t const t)
+                                {  return t - t % width;  };
+
+      auto const  first  =  bucket (bar (base, from).time);
+      while (from > 0  &&  bar (base, from - 1).time >= first)   --from;
+
+      /*  The bars before the first held may have been in its bucket. */
+      auto  skip  =  from == 0  &&  base.dropped
+                               &&  bar (base, 0).time != first;
+
+      auto  current  =  OHLC_Bar {};
+      auto  value    =  0.0;
+      auto  open     =  false;
+
+      auto const  finish  =  [&] ()
+        {
+          current.vwap  =  current.volume > 0  ?  value / current.volume
+                                               :  current.close;
+          put (rings [r],  current);
+          open  =  false;
+        };
+
+      for (auto i  =  from;  i < base.count;  ++i)
+        {
+          auto const &B  =  bar (base, i);
+          auto const  t  =  bucket (B.time);
+
+          if (skip)
+            {
+              if (t == first)   continue;
+              skip  =  false;
+            }
+
+          if (open  &&  t != current.time)   finish ();
+
+          if (! open)
+            {
+              current  =  OHLC_Bar {t, B.open, B.high, B.low, B.close,
+                                    0.0, 0.0, 0};
+              value    =  0.0;
+              open     =  true;
+            }
+
+          current.high     =  max (current.high, B.high);
+          current.low      =  min (current.low, B.low);
+          current.close    =  B.close;
+          current.volume  +=  B.volume;
+          current.count   +=  B.count;
+          value           +=  B.vwap * B.volume;
+        }
+
+      if (open)   finish ();
+    }
+  };
+
+
+
+  struct  C::Implementation
+  {
+    Implementation  (Kraken_API const &K_,  vector<string> P,
+                     vector<int> I,  size_t const capacity)
+      :  K {K_},  pairs {move (P)},  intervals {move (I)}
+    {
+      if (intervals.empty ()
+            ||  find (KRAKEN_INTERVALS.begin (),  KRAKEN_INTERVALS.end (),
+                      intervals [0]) == KRAKEN_INTERVALS.end ())
+        throw invalid_argument {"candle store: the first interval must be "
+                                "one Kraken offers"};
+
+      if (capacity == 0)
+        throw invalid_argument {"candle store: no capacity"};
+
+      /*  The base ring must hold at least one whole bar of every other
+       *  interval.  */
+      auto  base_capacity  =  capacity;
+      for (auto i  =  size_t {1};  i < intervals.size ();  ++i)
+        {
+          if (intervals [i] <= intervals [0]
+                ||  intervals [i] % intervals [0]
+                ||  count (intervals.begin (), intervals.end (),
+                           intervals [i]) > 1)
+            throw invalid_argument {"candle store: interval "
+                                    + to_string (intervals [i])
+                                    + " is not a multiple of "
+                                    + to_string (intervals [0])};
+
+          base_capacity  =  max (base_capacity,
+                                 size_t (intervals [i] / intervals [0]));
+        }
+
+      series.resize (pairs.size ());
+      for (auto p  =  size_t {0};  p < pairs.size ();  ++p)
+        {
+          if (! index.emplace (pairs [p], p).second)
+            throw invalid_argument {"candle store: pair " + pairs [p]
+                                    + " given twice"};
+
+          auto &S  =  series [p];
+          S.storage.resize (base_capacity
+                              +  capacity * (intervals.size () - 1));
+          S.rings.push_back (Ring {0, base_capacity});
+          for (auto i  =  size_t {1};  i < intervals.size ();  ++i)
+            S.rings.push_back (Ring {base_capacity + capacity * (i - 1),
+                                     capacity});
+        }
+    }
+
+
+    size_t  find_pair  (string_view const pair)  const
+    {
+      auto const  i  =  index.find (pair);
+      if (i == index.end ())
+        throw out_of_range {"candle store: no pair " + string {pair}};
+      return i->second;
+    }
+
+
+    size_t  find_interval  (int const interval)  const
+    {
+      auto const  i  =  find (intervals.begin (), intervals.end (), interval);
+      if (i == intervals.end ())
+        throw out_of_range {"candle store: no interval "
+                            + to_string (interval)};
+      return  size_t (i - intervals.begin ());
+    }
+
+
+    Bars  bars  (string_view const pair,  int const interval)  const
+    {
+      auto const &S  =  series [find_pair (pair)];
+      auto const &R  =  S.rings [find_interval (interval)];
+
+      auto  ret  =  Bars {};
+      ret.first        =  S.storage.data () + R.offset + R.start;
+      ret.first_size   =  min (R.count,  R.capacity - R.start);
+      ret.second       =  S.storage.data () + R.offset;
+      ret.second_size  =  R.count - ret.first_size;
+      return ret;
+    }
+
+
+    /*  Put the new base bars into the series, and rebuild the bars of the
+     *  other intervals from the first of them on.  */
+    size_t  apply  (Series &S,  OHLC_Series const &fetched)
+    {
+      auto &base     =  S.rings [0];
+      auto  changed  =  size_t {0};
+      auto  oldest   =  int64_t {0};
+
+      for (auto const &B  :  fetched.bars)
+        if (S.put (base, B)  &&  ! changed++)
+          oldest  =  B.time;
+
+      if (fetched.last)   S.since  =  fetched.last;
+
+      if (! changed)   return 0;
+
+      auto  from  =  base.count;
+      while (from > 0  &&  S.bar (base, from - 1).time >= oldest)   --from;
+
+      for (auto r  =  size_t {1};  r < S.rings.size ();  ++r)
+        S.aggregate (r,  int64_t {intervals [r]} * 60,  from);
+
+      return changed;
+    }
+
+
+    size_t  update  (Kraken_API::Options options,  size_t concurrency)
+    {
+      concurrency  =  max (concurrency, size_t {1});
+      options.set (Kraken_API::INTERVAL, intervals [0]);
+
+      /*  For the pairs which have not been fetched yet. */
+      auto const  first_since  =  options [Kraken_API::SINCE];
+
+      auto  pending  =  deque<pair<size_t, future<string>>> {};
+      auto  next     =  size_t {0};
+      auto  total    =  size_t {0};
+      auto  failure  =  exception_ptr {};
+
+      while (next < pairs.size ()  ||  ! pending.empty ())
+        {
+          while (next < pairs.size ()  &&  pending.size () < concurrency)
+            {
+              auto const  since  =  series [next].since;
+              if (since)   options.set (Kraken_API::SINCE, since);
+              else         options.set (Kraken_API::SINCE, first_since);
+
+              /*  The limiter may refuse it outright; the requests already
+               *  in flight are still seen through.  */
+              try
+                {
+                  auto  reply  =  K.ohlc_data_async (options, pairs [next]);
+                  pending.emplace_back (next,  move (reply));
+                }
+              catch (...)
+                {
+                  if (! failure)   failure  =  current_exception ();
+                }
+
+              ++next;
+            }
+
+          if (pending.empty ())   continue;
+
+          auto  [p, reply]  =  move (pending.front ());
+          pending.pop_front ();
+
+          try
+            {
+              auto const  fetched  =  parse_ohlc_data (reply.get ());
+
+              auto  guard  =  unique_lock<shared_mutex> {lock};
+              total  +=  apply (series [p],  fetched);
+            }
+          catch (...)
+            {
+              if (! failure)   failure  =  current_exception ();
+            }
+        }
+
+      if (failure)   rethrow_exception (failure);
+
+      return total;
+    }
+
+
+    Kraken_API const &         K;
+    vector<string> const       pairs;
+    vector<int> const          intervals;
+
+    map<string, size_t, less<>>  index;
+    vector<Series>               series;
+    mutable shared_mutex         lock;
+  };
+
+
+
+  C::Candle_Store  (Kraken_API const &K,
+                    vector<string> pairs,
+                    vector<int> intervals,
+                    size_t const capacity)
+    :  implementation {make_unique<Implementation> (K, move (pairs),
+                                                    move (intervals),
+                                                    capacity)}
+  {}
+
+
+  C::~Candle_Store  ()  =  default;
+
+
+  size_t  C::update  (Kraken_API::Options const &options,
+                      size_t const concurrency)
+  {   return implementation->update (options, concurrency);   }
+
+
+  void  C::read  (string_view const pair,  int const interval,
+                  function<void (Bars const &)> const &f)  const
+  {
+    auto  guard  =  shared_lock<shared_mutex> {implementation->lock};
+    f (implementation->bars (pair, interval));
+  }
+
+
+  C::Bars  C::bars  (string_view const pair,  int const interval)  const
+  {   return implementation->bars (pair, interval);   }
+
+
+  vector<string> const &  C::pairs  ()  const
+  {   return implementation->pairs;   }
+
+
+  vector<int> const &  C::intervals  ()  const
+  {   return implementation->intervals;   }
+
+
+  int64_t  C::since  (string_view const pair)  const
+  {
+    auto  guard  =  shared_lock<shared_mutex> {implementation->lock};
+    return  implementation->series [implementation->find_pair (pair)].since;
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,175 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-api.h>
+#include <curlpp/Easy.hpp>
+#include <curl/curl.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  struct  Connection_Pool::Implementation
+  {
+    CURLSH  *share  {curl_share_init ()};
+
+    /*  One lock for each class of data libcurl may ask us to protect. */
+    array<mutex, CURL_LOCK_DATA_LAST>  share_locks;
+
+    mutex                           idle_lock;
+    vector<unique_ptr<curlpp::Easy>>  idle;
+
+    atomic<uint64_t>  requests            {0};
+    atomic<uint64_t>  connections_opened  {0};
+    atomic<uint64_t>  connections_reused  {0};
+    atomic<uint64_t>  handles_created     {0};
+
+
+    static  void  lock  (CURL *,  curl_lock_data data,  curl_lock_access,
+                         void *self)
+    {   static_cast<Implementation*> (self)->share_locks [data].lock ();   }
+
+    static  void  unlock  (CURL *,  curl_lock_data data,  void *self)
+    {   static_cast<Implementation*> (self)->share_locks [data].unlock ();   }
+
+
+    Implementation  ()
+    {
+      if (! share)
+        throw runtime_error {"cannot create libcurl share object"};
+
+      curl_share_setopt (share, CURLSHOPT_LOCKFUNC,   lock);
+      curl_share_setopt (share, CURLSHOPT_UNLOCKFUNC, unlock);
+      curl_share_setopt (share, CURLSHOPT_USERDATA,   this);
+
+      curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+      curl_share_setopt (share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+
+
+    ~Implementation  ()
+    {
+      /*  The easy handles must let go of the share before it goes. */
+      idle.clear ();
+      curl_share_cleanup (share);
+    }
+
+
+    /*  The options which survive every reset of a pooled handle. */
+    void  bind  (curlpp::Easy &E)
+    {
+      auto *const  handle  =  E.getHandle ();
+
+      curl_easy_setopt (handle, CURLOPT_SHARE,         share);
+      curl_easy_setopt (handle, CURLOPT_HTTP_VERSION,  CURL_HTTP_VERSION_2TLS);
+      curl_easy_setopt (handle, CURLOPT_TCP_KEEPALIVE, 1L);
+      curl_easy_setopt (handle, CURLOPT_NOSIGNAL,      1L);
+    }
+  };
+
+
+
+  Connection_Pool::Connection_Pool  ()
+    :  implementation {make_unique<Implementation> ()}
+  {}
+
+
+  Connection_Pool::~Connection_Pool  ()  =  default;
+
+
+
+  Connection_Pool::Lease  Connection_Pool::lease  ()
+  {
+    auto  &I  =  *implementation;
+
+    auto  easy  =  unique_ptr<curlpp::Easy> {};
+
+    {
+      auto  guard  =  lock_guard<mutex> {I.idle_lock};
+      if (! I.idle.empty ())
+        {
+          easy  =  move (I.idle.back ());
+          I.idle.pop_back ();
+        }
+    }
+
+    if (easy)
+      easy->reset ();
+    else
+      {
+        easy  =  make_unique<curlpp::Easy> ();
+        ++I.handles_created;
+      }
+
+    I.bind (*easy);
+    ++I.requests;
+
+    return  Lease {*this, easy.release ()};
+  }
+
+
+
+  void  Connection_Pool::release  (curlpp::Easy *E)
+  {
+    auto  &I  =  *implementation;
+    auto  easy  =  unique_ptr<curlpp::Easy> {E};
+
+    /*  A handle given back without being performed, because something
+     *  threw before it was sent, has no transfer to count: lease () reset
+     *  its information along with its options, so its time is zero.  */
+    auto  opened  =  long {0};
+    auto  taken   =  curl_off_t {0};
+    if (curl_easy_getinfo (E->getHandle (), CURLINFO_TOTAL_TIME_T, &taken)
+          ==  CURLE_OK
+        &&  taken > 0
+        &&  curl_easy_getinfo (E->getHandle (), CURLINFO_NUM_CONNECTS,
+                               &opened)
+              ==  CURLE_OK)
+      {
+        if (opened > 0)  I.connections_opened  +=  opened;
+        else             ++I.connections_reused;
+      }
+
+    auto  guard  =  lock_guard<mutex> {I.idle_lock};
+    I.idle.push_back (move (easy));
+  }
+
+
+
+  Connection_Pool::Statistics  Connection_Pool::statistics  ()  const
+  {
+    auto const  &I  =  *implementation;
+
+    auto  ret  =  Statistics {};
+    ret.requests            =  I.requests;
+    ret.connections_opened  =  I.connections_opened;
+    ret.connections_reused  =  I.connections_reused;
+    ret.handles_created     =  I.handles_created;
+    return ret;
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -22,7 +22,14 @@
 #include <openssl/hmac.h>
 #include <openssl/sha.h>
 #include <openssl/buffer.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
 #include <dmbcs-kraken-api.h>
+#include <atomic>
 
 
 namespace  DMBCS  {
@@ -50,11 +57,8 @@ namespace  DMBCS  {
 
     auto  ret  =  vector<uint8_t> (length);
 
-    HMAC_CTX *const ctx  =  HMAC_CTX_new ();
-    HMAC_Init_ex   (ctx, key.data (), key.size (), EVP_sha512 (), nullptr);
-    HMAC_Update    (ctx, data.data (), data.size ());
-    HMAC_Final     (ctx, ret.data (),  &length);
-    HMAC_CTX_free  (ctx);
+    HMAC (EVP_sha512 (),  key.data (),  key.size (),
+          data.data (),  data.size (),  ret.data (),  &length);
 
     ret.resize (length);
 
@@ -105,4 +109,210 @@ namespace  DMBCS  {
   }
 
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+  /*  OpenSSL 3 deprecates HMAC_CTX in favour of the generic EVP_MAC
+   *  interface; older libraries do not have the latter.  */
+
+  typedef  EVP_MAC_CTX  Mac_Context;
+
+  static  Mac_Context  *new_mac_context  ()
+  {
+    auto *const  mac  =  EVP_MAC_fetch (nullptr, "HMAC", nullptr);
+    if (! mac)   return  nullptr;
+
+    /*  The context holds its own reference to the algorithm. */
+    auto *const  ret  =  EVP_MAC_CTX_new (mac);
+    EVP_MAC_free (mac);
+    return  ret;
+  }
+
+  static  void  free_mac_context  (Mac_Context *C)
+  {   EVP_MAC_CTX_free (C);   }
+
+  static  bool  key_mac_context  (Mac_Context *C,
+                                  uint8_t const *key,  size_t length)
+  {
+    char  digest []  =  "SHA512";
+    OSSL_PARAM  const  parameters []
+      =  {OSSL_PARAM_construct_utf8_string (OSSL_MAC_PARAM_DIGEST, digest, 0),
+          OSSL_PARAM_construct_end ()};
+
+    return  EVP_MAC_init (C, key, length, parameters);
+  }
+
+#else
+
+  typedef  HMAC_CTX  Mac_Context;
+
+  static  Mac_Context  *new_mac_context  ()   {   return  HMAC_CTX_new ();   }
+
+  static  void  free_mac_context  (Mac_Context *C)   {   HMAC_CTX_free (C);   }
+
+  static  bool  key_mac_context  (Mac_Context *C,
+                                  uint8_t const *key,  size_t length)
+  {   return  HMAC_Init_ex (C, key, length, EVP_sha512 (), nullptr);   }
+
+#endif
+
+
+
+  struct  Request_Signer::Implementation
+  {
+    /*  Distinguishes this signer from every other one which a thread may
+     *  have used before.  */
+    uint64_t  const  id;
+
+    /*  Keyed but never updated; the threadsʼ contexts are copied from
+     *  here.  */
+    Mac_Context  *const  keyed  {new_mac_context ()};
+
+    static  atomic<uint64_t>  next_id;
+
+    Implementation  ()  :  id {++next_id}  {}
+
+    ~Implementation  ()   {   free_mac_context (keyed);   }
+  };
+
+
+  atomic<uint64_t>  Request_Signer::Implementation::next_id  {0};
+
+
+
+  /*  The contexts a thread signs with, reset rather than remade between
+   *  uses.  */
+
+  struct  Signing_Contexts
+  {
+    uint64_t      signer        {0};
+    Mac_Context  *hmac          {new_mac_context ()};
+    EVP_MD_CTX   *digest        {EVP_MD_CTX_new ()};
+
+    /*  Copying this is much cheaper than initializing afresh, which
+     *  involves looking the algorithm up.  */
+    EVP_MD_CTX   *digest_start  {EVP_MD_CTX_new ()};
+
+    Signing_Contexts  ()
+    {   EVP_DigestInit_ex  (digest_start,  EVP_sha256 (),  nullptr);   }
+
+    ~Signing_Contexts  ()
+    {
+      free_mac_context  (hmac);
+      EVP_MD_CTX_free   (digest);
+      EVP_MD_CTX_free   (digest_start);
+    }
+  };
+
+
+  static  thread_local  Signing_Contexts  signing_contexts;
+
+
+
+  Request_Signer::Request_Signer  (string const &secret)
+    :  implementation {make_unique<Implementation> ()}
+  {
+    if (secret.length ()  !=  88)
+      throw runtime_error {"private key must be 88 characters long"};
+
+    /*  EVP_DecodeBlock does not strip the padding from its count. */
+    auto  key      =  array<uint8_t, 66> {};
+    auto  decoded  =  EVP_DecodeBlock
+                          (key.data (),
+                           reinterpret_cast<unsigned char const*> 
+                                                          (secret.data ()),
+                           secret.length ());
+
+    if (decoded  !=  66   ||   secret [86] != '='   ||   secret [87] != '=')
+      {
+        OPENSSL_cleanse (key.data (), key.size ());
+        throw runtime_error {"private key is not a base64 64-byte key"};
+      }
+
+    auto const  ok  =  implementation->keyed
+                         &&  key_mac_context (implementation->keyed,
+                                              key.data (),  64);
+
+    OPENSSL_cleanse (key.data (), key.size ());
+
+    if (! ok)
+      throw runtime_error {"cannot initialize HMAC-SHA512 context"};
+  }
+
+
+
+  Request_Signer::~Request_Signer  ()  =  default;
+
+
+
+  shared_ptr<Request_Signer const>
+  Request_Signer::make  (string const &secret)
+  {
+    try
+      {
+        return  make_shared<Request_Signer const> (secret);
+      }
+    catch (runtime_error const &)
+      {
+        return  nullptr;
+      }
+  }
+
+
+
+  void  Request_Signer::sign  (string_view path,
+                               string_view nonce,
+                               string_view post_data,
+                               Signature &out)  const
+  {
+    auto  &T  =  signing_contexts;
+    auto  &I  =  *implementation;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (T.signer  !=  I.id)
+      {
+        /*  There is no copying into an existing EVP_MAC_CTX. */
+        free_mac_context (T.hmac);
+        T.hmac    =  EVP_MAC_CTX_dup (I.keyed);
+        T.signer  =  I.id;
+      }
+    else
+      EVP_MAC_init (T.hmac, nullptr, 0, nullptr);
+#else
+    if (T.signer  !=  I.id)
+      {
+        HMAC_CTX_copy (T.hmac, I.keyed);
+        T.signer  =  I.id;
+      }
+    else
+      HMAC_Init_ex (T.hmac, nullptr, 0, nullptr, nullptr);
+#endif
+
+    auto  D  =  array<uint8_t, SHA256_DIGEST_LENGTH> {};
+    EVP_MD_CTX_copy_ex  (T.digest,  T.digest_start);
+    EVP_DigestUpdate    (T.digest,  nonce.data (),  nonce.length ());
+    EVP_DigestUpdate    (T.digest,  post_data.data (),  post_data.length ());
+    EVP_DigestFinal_ex  (T.digest,  D.data (),  nullptr);
+
+    auto  mac     =  array<uint8_t, SHA512_DIGEST_LENGTH> {};
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    auto  length  =  size_t {0};
+    EVP_MAC_update  (T.hmac,
+                     reinterpret_cast<unsigned char const*> (path.data ()),
+                     path.length ());
+    EVP_MAC_update  (T.hmac,  D.data (),  D.size ());
+    EVP_MAC_final   (T.hmac,  mac.data (),  &length,  mac.size ());
+#else
+    auto  length  =  unsigned {0};
+    HMAC_Update  (T.hmac,
+                  reinterpret_cast<unsigned char const*> (path.data ()),
+                  path.length ());
+    HMAC_Update  (T.hmac,  D.data (),  D.size ());
+    HMAC_Final   (T.hmac,  mac.data (),  &length);
+#endif
+
+    EVP_EncodeBlock  (reinterpret_cast<unsigned char*> (out.data ()),
+                      mac.data (),  length);
+  }
+
+
 }  /* End of namespace DMBCS. */
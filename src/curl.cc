@@ -22,6 +22,12 @@
 #include <dmbcs-kraken-api.h>
 #include <curlpp/Options.hpp>
 #include <curlpp/Easy.hpp>
+#include <curl/curl.h>
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <random>
+#include <thread>
 
 
 namespace  DMBCS  {
@@ -31,85 +37,938 @@ namespace  DMBCS  {
   namespace CO = C::Options;
 
 
-  /*  Defined in crypto.cc.  */
-  array<uint8_t, 32>  sha256         (string const &);
-  vector<uint8_t>     hmac_sha512    (vector<uint8_t> const &data,
-                                      vector<uint8_t> const &key);
-  vector<uint8_t>     base64_decode  (string const  &);
-  string              base64_encode  (vector<uint8_t> const &);
+  /*  The API function named at the start of a query. */
+  static  string_view  function_of  (string_view const query)
+  {   return  query.substr (0, query.find ('?'));   }
+
+
+  /*  Set up the request for the public API function described by query,
+   *  which is the function name optionally followed by a ?-separated
+   *  list of arguments.  */
+  static  void  prepare_public  (Kraken_API const &K,
+                                 string_view const query,
+                                 C::Easy &request)
+  {
+    auto  url  =  Request_Arena::String {&Request_Arena::resource ()};
+    url.reserve (K.url_base.length () + 7 + query.length ());
+    url  +=  K.url_base;
+    url  +=  "public/";
+    url  +=  query;
+
+    /*  Which libcurl copies. */
+    curl_easy_setopt (request.getHandle (), CURLOPT_URL, url.c_str ());
+  }
 
 
 
-  void  query_public  (Kraken_API &K)
+  /*  The part of the base URL after the host, which is signed along with
+   *  the request: "/0/" for Kraken itself.  */
+  static  string_view  url_path  (string_view const base)
   {
-    auto  request  =  C::Easy {};
+    auto const  scheme  =  base.find ("://");
+    auto const  slash   =  base.find ('/',  scheme == base.npos
+                                                ?  0  :  scheme + 3);
+    return  slash == base.npos  ?  string_view {"/"}  :  base.substr (slash);
+  }
 
-    request.setOpt (CO::Url {string {K.url_base} + "public/" + K.query_url});
-    
-    K.query_result.clear ();
 
-    request.setOpt (CO::WriteFunction 
-                    {[&K] (char *buffer, size_t size, size_t n) 
-                              { K.query_result += string {buffer, 
-                                                          buffer + size * n};
-                                return size * n; }});
 
-    request.perform ();
+  static constexpr auto  SIGN_HEADER  =  string_view {"API-Sign: "};
+
+
+  /*  What libcurl does not copy of a private request: the post data, and
+   *  the list of API-Key and API-Sign headers.  The list is made once for
+   *  each key, each new signature being written over the last, and the
+   *  post data keeps its capacity, so that in the steady state neither
+   *  allocates.  The blocking calls use one of these for each thread; a
+   *  request handed to the engine has its own.  */
+  struct  Signed_Request
+  {
+    Signed_Request  ()  =  default;
+
+    ~Signed_Request  ()   {   curl_slist_free_all (headers);   }
+
+    Signed_Request  (Signed_Request const &)  =  delete;
+    Signed_Request &  operator=  (Signed_Request const &)  =  delete;
+
+    void  use_key  (string const &K)
+    {
+      if (headers  &&  K == key)   return;
+
+      curl_slist_free_all (headers);
+      headers  =  nullptr;
+      key  =  K;
+
+      auto  line  =  "API-Key: " + key;
+      headers  =  curl_slist_append (nullptr, line.c_str ());
+
+      line  =  string {SIGN_HEADER};
+      line.append (Request_Signer::Signature {}.size () - 1,  '=');
+      if (headers)   headers  =  curl_slist_append (headers, line.c_str ());
+
+      if (! headers  ||  ! headers->next)
+        {
+          curl_slist_free_all (headers);
+          headers  =  nullptr;
+          throw  bad_alloc {};
+        }
+
+      signature  =  headers->next->data + SIGN_HEADER.length ();
+    }
+
+    string       key;
+    curl_slist  *headers    {nullptr};
+    char        *signature  {nullptr};
+    string       post_data;
+  };
+
+
+  static  Signed_Request  &thread_signed_request  ()
+  {
+    thread_local  auto  S  =  Signed_Request {};
+    return S;
   }
 
 
-
-  void  query_private  (Kraken_API &K)
+
+  /*  Set up the signed request for the private API function described by
+   *  query, keeping in S what must last until it is done.  */
+  static  void  prepare_private  (Kraken_API const &K,
+                                  string_view const query,
+                                  C::Easy &request,
+                                  Signed_Request &S)
   {
-    if (K.secret.length ()  !=  88)
-      throw runtime_error {"private key must be 88 characters long"};
+    if (! K.signer)
+      /*  Making it again will throw the reason why it was not made. */
+      Request_Signer {K.secret};
+
+    S.use_key (K.key);
+
+    auto const  quiz      =  query.find ('?');
+    auto const  function  =  query.substr (0, quiz);
 
-    auto const quiz  =  K.query_url.find ('?');
+    auto  &post_data  =  S.post_data;
+    post_data.clear ();
+    if (quiz != query.npos)
+      post_data.append (query.substr (quiz + 1));
 
-    auto  post_data  =  string {};
-    if (quiz != K.query_url.npos)
+    auto &      source      =  K.nonce_source  ?  *K.nonce_source
+                                 :  *Nonce_Source::process_wide ();
+    auto        nonce_text  =  Nonce_Source::Text {};
+    auto const  nonce       =  source.next (nonce_text);
+
+    auto const  path  =  url_path (K.url_base);
+    auto  short_url  =  Request_Arena::String {&Request_Arena::resource ()};
+    short_url.reserve (path.length () + 8 + function.length ());
+    short_url  +=  path;
+    short_url  +=  "private/";
+    short_url  +=  function;
+
+    auto  url  =  Request_Arena::String {&Request_Arena::resource ()};
+    url.reserve (K.url_base.length () + 8 + function.length ());
+    url  +=  K.url_base;
+    url  +=  "private/";
+    url  +=  function;
+
+    if (! post_data.empty ())   post_data += '&';
+    post_data  +=  "nonce=";
+    post_data  +=  nonce;
+
+    auto  hmac  =  Request_Signer::Signature {};
+    if (K.metrics)
       {
-        post_data = K.query_url.substr (quiz+1);
-        K.query_url  =  K.query_url.substr (0, quiz);
+        auto const  start  =  chrono::steady_clock::now ();
+        K.signer->sign (short_url, nonce, post_data, hmac);
+        K.metrics->record (function,  Request_Metrics::SIGNING,
+                           chrono::steady_clock::now () - start);
       }
+    else
+      K.signer->sign (short_url, nonce, post_data, hmac);
+
+    memcpy (S.signature, hmac.data (), hmac.size () - 1);
 
-    struct timeval sys_time;   gettimeofday  (&sys_time, nullptr);
+    auto *const  handle  =  request.getHandle ();
+    curl_easy_setopt (handle, CURLOPT_URL,            url.c_str ());
+    curl_easy_setopt (handle, CURLOPT_POSTFIELDS,     post_data.c_str ());
+    curl_easy_setopt (handle, CURLOPT_POSTFIELDSIZE,
+                      long (post_data.size ()));
+    curl_easy_setopt (handle, CURLOPT_HTTPHEADER,     S.headers);
+  }
 
-    auto nonce  =  ostringstream {};
-    
-    nonce << (uint64_t) ((sys_time.tv_sec * 1000000) + sys_time.tv_usec);
 
-    auto  short_url  =  string {"/0/private/"}  +  K.query_url;
-    K.query_url  =  string{K.url_base}  +  "private/"  +  K.query_url;
-    
 
-    if (! post_data.empty ())   post_data += '&';
-    post_data  +=  "nonce=" + nonce.str ();
+  /*  libcurlʼs write function for receive_into, given the handle, whose
+   *  private pointer is the body.  */
+  static  size_t  append_reply  (char *const buffer,
+                                 size_t const size,
+                                 size_t const n,
+                                 void *const handle)
+  {
+    auto  *target  =  (char *) nullptr;
+    curl_easy_getinfo (handle, CURLINFO_PRIVATE, &target);
+    auto  &body  =  *reinterpret_cast<string *> (target);
 
-    auto const  D       =  sha256 (nonce.str ()  +  post_data);
-    auto const  digest  =  short_url  +  string {begin (D), end (D)};
+    if (body.empty ())
+      {
+        auto  length  =  curl_off_t {-1};
+        curl_easy_getinfo (handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                           &length);
+        if (length > 0)   body.reserve (size_t (length));
+      }
+
+    body.append (buffer, size * n);
+    return size * n;
+  }
 
-    auto const  hmac
-      =  base64_encode  
-                 (hmac_sha512  (vector<uint8_t> {begin (digest), end (digest)},
-                                base64_decode (K.secret)));
 
-    auto  request  =  C::Easy {};
+  /*  Have the body of the reply appended to body.  The string is
+   *  reserved to expected now and, when the first piece arrives, to the
+   *  length the server gave if that is more, so that it need not grow
+   *  (and be copied) piece by piece.  Not static: the request engine and
+   *  the risk guard use it too.  */
+  void  receive_into  (string &body,  C::Easy &request,  size_t const expected)
+  {
+    auto *const  handle  =  request.getHandle ();
+
+    if (body.empty ())   body.reserve (expected);
+
+    curl_easy_setopt (handle, CURLOPT_PRIVATE,        &body);
+    curl_easy_setopt (handle, CURLOPT_WRITEFUNCTION,  append_reply);
+    curl_easy_setopt (handle, CURLOPT_WRITEDATA,      handle);
+  }
 
-    request.setOpt (CO::Url {K.query_url});
-    request.setOpt (CO::PostFields {post_data});
-    request.setOpt (CO::HttpHeader {{{"API-Key: " + K.key},
-                                     {"API-Sign: " + hmac}}});
-    
-    K.query_result.clear ();
 
-    request.setOpt (CO::WriteFunction 
-                    {[&K] (char *buffer, size_t size, size_t n) 
-                              { K.query_result += string {buffer, 
-                                                          buffer + size * n};
-                                return size * n; }});
 
+  /*  The size of the last reply to each API function (or to any other
+   *  which happens to share its slot), as a guess at the size of the
+   *  next where the server does not say.  */
+  static  array<atomic<size_t>, 64>  reply_sizes  {};
+
+  static  atomic<size_t>  &reply_size  (string_view const function)
+  {
+    return  reply_sizes [hash<string_view> {} (function)
+                           %  reply_sizes.size ()];
+  }
+
+
+
+  static  string  perform  (C::Easy &request,  string_view const function)
+  {
+    auto &      expected  =  reply_size (function);
+    auto        result    =  string {};
+
+    receive_into (result, request,
+                  expected.load (memory_order_relaxed));
     request.perform ();
+
+    expected.store (result.size () + result.size () / 8,
+                    memory_order_relaxed);
+    return result;
+  }
+
+
+
+  /*  Take libcurlʼs account of a finished transfer; nothing is recorded
+   *  for one which got no reply.  Not static: the risk guard uses it too.
+   */
+  void  measure  (Request_Metrics &M,
+                  string_view const function,
+                  C::Easy &request)
+  {
+    auto *const  handle  =  request.getHandle ();
+
+    auto  code  =  long {0};
+    curl_easy_getinfo (handle, CURLINFO_RESPONSE_CODE, &code);
+    if (code == 0)   return;
+
+    /*  All of these are microseconds from the start of the transfer. */
+    auto const  at  =  [handle] (CURLINFO const what)
+      {
+        auto  t  =  curl_off_t {0};
+        curl_easy_getinfo (handle, what, &t);
+        return  chrono::microseconds {t};
+      };
+
+    auto const  size  =  [handle] (CURLINFO const what)
+      {
+        auto  n  =  curl_off_t {0};
+        curl_easy_getinfo (handle, what, &n);
+        return  uint64_t (n);
+      };
+
+    auto const  header_size  =  [handle] (CURLINFO const what)
+      {
+        auto  n  =  long {0};
+        curl_easy_getinfo (handle, what, &n);
+        return  uint64_t (n);
+      };
+
+    auto  connects  =  long {0};
+    curl_easy_getinfo (handle, CURLINFO_NUM_CONNECTS, &connects);
+
+    auto const  looked_up     =  at (CURLINFO_NAMELOOKUP_TIME_T);
+    auto const  connected     =  at (CURLINFO_CONNECT_TIME_T);
+    auto const  app_connected =  at (CURLINFO_APPCONNECT_TIME_T);
+
+    auto  T  =  Request_Metrics::Transfer {};
+    T.new_connection  =  connects > 0;
+    T.name_lookup     =  looked_up;
+    T.connect         =  connected - looked_up;
+    if (app_connected.count ())   T.tls  =  app_connected - connected;
+    T.first_byte      =  at (CURLINFO_STARTTRANSFER_TIME_T)
+                           -  at (CURLINFO_PRETRANSFER_TIME_T);
+    T.total           =  at (CURLINFO_TOTAL_TIME_T);
+    T.sent            =  header_size (CURLINFO_REQUEST_SIZE)
+                           +  size (CURLINFO_SIZE_UPLOAD_T);
+    T.received        =  header_size (CURLINFO_HEADER_SIZE)
+                           +  size (CURLINFO_SIZE_DOWNLOAD_T);
+
+    M.record (function, T);
+  }
+
+
+
+  /*  As above, keeping the objectʼs metrics if it has any. */
+  static  string  perform  (Kraken_API const &K,
+                            string_view const query,
+                            C::Easy &request)
+  {
+    auto const  function  =  function_of (query);
+
+    if (! K.metrics)   return perform (request, function);
+
+    try
+      {
+        auto  result  =  perform (request, function);
+        measure (*K.metrics, function, request);
+        K.metrics->record_errors (function, result);
+        return result;
+      }
+    catch (...)
+      {
+        K.metrics->record_failure (function);
+        throw;
+      }
+  }
+
+
+
+  /*  The same for the asynchronous requests: what to tell the engine to
+   *  do with the handle at the end, and the completion to give it.  */
+
+  static  Request_Engine::Inspection  inspection  (Kraken_API const &K,
+                                                   string_view const query)
+  {
+    if (! K.metrics)   return {};
+
+    return  [M = K.metrics,  function = string {function_of (query)}]
+                (C::Easy &request)
+                {  measure (*M, function, request);  };
+  }
+
+
+  static  Kraken_API::Completion  measured  (Kraken_API const &K,
+                                             string_view const query,
+                                             Kraken_API::Completion done)
+  {
+    if (! K.metrics)   return done;
+
+    return  [M = K.metrics,  function = string {function_of (query)},
+             done {move (done)}]
+                (string const &result,  exception_ptr const error)
+                {
+                  if (error)   M->record_failure (function);
+                  else         M->record_errors (function, result);
+                  if (done)    done (result, error);
+                };
+  }
+
+
+
+  /*  The engine is made on first use; should two threads race to make it
+   *  the loser's is simply discarded.  Not static: the awaitable library
+   *  hands coroutines to the engine's thread too.  */
+  Request_Engine  &engine  (Kraken_API const &K)
+  {
+    auto  E  =  atomic_load (&K.request_engine);
+
+    if (! E)
+      {
+        auto  made  =  make_shared<Request_Engine> (K.connection_pool);
+        if (atomic_compare_exchange_strong (&K.request_engine, &E, made))
+          E  =  move (made);
+      }
+
+    return *E;
+  }
+
+
+
+  /*  Kraken is the final judge of the rate limit: if it says it has been
+   *  exceeded, the limiter had the counter too low.  */
+  static  void  check_limit  (shared_ptr<Rate_Limiter> const &L,
+                              string const &result)
+  {
+    if (L  &&  result.find ("EAPI:Rate limit exceeded") != result.npos)
+      L->saturate ();
+  }
+
+
+
+  /*  Note the validators in the headers of a response. */
+  static  size_t  read_header  (char *const buffer,
+                                size_t const size,
+                                size_t const n,
+                                void *const validators)
+  {
+    auto  line  =  string_view {buffer,  size * n};
+    while (! line.empty ()  &&  (line.back () == '\n'
+                                   ||  line.back () == '\r'))
+      line.remove_suffix (1);
+
+    auto &V  =  *static_cast<Response_Cache::Validators*> (validators);
+
+    for (auto const &[name, target]
+           :  {pair<string_view, string*> {"etag:", &V.etag},
+               pair<string_view, string*> {"last-modified:",
+                                           &V.last_modified}})
+      if (line.length () > name.length ()
+            &&  equal (name.begin (), name.end (), line.begin (),
+                       [] (char const a, char const b)
+                           {  return a == tolower (b);  }))
+        {
+          auto  value  =  line.substr (name.length ());
+          while (! value.empty ()  &&  value [0] == ' ')
+            value.remove_prefix (1);
+          *target  =  value;
+        }
+
+    return  size * n;
+  }
+
+
+
+  using  Clock  =  chrono::steady_clock;
+
+
+  /*  Bound the transfer by the policyʼs connect timeout, and by what is
+   *  left until the deadline.  */
+  static  void  set_deadline  (Kraken_API const &K,
+                               C::Easy &request,
+                               Clock::time_point const deadline)
+  {
+    auto const  left  =  chrono::duration_cast<chrono::milliseconds>
+                                (deadline - Clock::now ()).count ();
+    auto *const  handle  =  request.getHandle ();
+
+    curl_easy_setopt (handle, CURLOPT_CONNECTTIMEOUT_MS,
+                      long (K.policy.connect_timeout.count ()));
+    /*  Zero would mean no limit at all. */
+    curl_easy_setopt (handle, CURLOPT_TIMEOUT_MS,
+                      long (max (left, decltype (left) {1})));
+  }
+
+
+
+  /*  Failures of the transport which another try might not meet. */
+  static  bool  retryable  (CURLcode const code)
+  {
+    switch (code)
+      {
+      case CURLE_COULDNT_RESOLVE_HOST:
+      case CURLE_COULDNT_CONNECT:
+      case CURLE_OPERATION_TIMEDOUT:
+      case CURLE_SEND_ERROR:
+      case CURLE_RECV_ERROR:
+      case CURLE_GOT_NOTHING:
+      case CURLE_PARTIAL_FILE:
+      case CURLE_SSL_CONNECT_ERROR:
+      case CURLE_HTTP2:
+      case CURLE_HTTP2_STREAM:
+        return true;
+      default:
+        return false;
+      }
+  }
+
+
+
+  /*  Whether a reply is a server error, or carries one of the errors the
+   *  policy takes to be passing.  Kraken puts the error array first, so
+   *  only what comes before the result is searched.  */
+  static  bool  transient  (Request_Policy const &P,
+                            long const status,
+                            string const &reply)
+  {
+    if (status >= 500)   return true;
+
+    auto const  head  =  string_view {reply}.substr
+                                       (0,  reply.find ("\"result\""));
+    return  any_of (P.transient_errors.begin (),  P.transient_errors.end (),
+                    [head] (string const &E)
+                        {  return head.find (E) != head.npos;  });
+  }
+
+
+
+  /*  Wait a random time before trying again after the given attempt, or
+   *  return false if that would go past the deadline.  */
+  static  bool  back_off  (Request_Policy const &P,
+                           unsigned const attempt,
+                           Clock::time_point const deadline)
+  {
+    thread_local  auto  random  =  minstd_rand {random_device {} ()};
+
+    auto const  ceiling  =  min (P.max_backoff,
+                                 P.backoff * (1 << min (attempt - 1, 16u)));
+    auto const  delay    =  chrono::milliseconds
+                               {uniform_int_distribution<int64_t>
+                                    {0, ceiling.count ()} (random)};
+
+    if (Clock::now () + delay >= deadline)   return false;
+
+    this_thread::sleep_for (delay);
+    return true;
+  }
+
+
+
+  /*  Whether any of a failed request went out. */
+  static  bool  sent_any  (C::Easy &request)
+  {
+    auto  n  =  long {0};
+    curl_easy_getinfo (request.getHandle (), CURLINFO_REQUEST_SIZE, &n);
+    return n > 0;
+  }
+
+
+
+  /*  Set up a public request, made conditional on the validators if there
+   *  are any, noting those of the response in out.  */
+  static  void  prepare_fetch  (Kraken_API const &K,
+                                string_view const query,
+                                Response_Cache::Validators const &V,
+                                Response_Cache::Validators &out,
+                                C::Easy &request,
+                                Clock::time_point const deadline)
+  {
+    prepare_public (K, query, request);
+    set_deadline (K, request, deadline);
+
+    auto  conditions  =  list<string> {};
+    if (! V.etag.empty ())
+      conditions.push_back ("If-None-Match: " + V.etag);
+    if (! V.last_modified.empty ())
+      conditions.push_back ("If-Modified-Since: " + V.last_modified);
+    if (! conditions.empty ())
+      request.setOpt (CO::HttpHeader {conditions});
+
+    auto *const  handle  =  request.getHandle ();
+    curl_easy_setopt (handle, CURLOPT_HEADERFUNCTION, read_header);
+    curl_easy_setopt (handle, CURLOPT_HEADERDATA, &out);
+  }
+
+
+
+  static  Response_Cache::Fetched  fetch_once
+                                     (Kraken_API const &K,
+                                      string_view const query,
+                                      Response_Cache::Validators const &V,
+                                      Clock::time_point const deadline,
+                                      long &status)
+  {
+    auto const  lease  =  K.connection_pool->lease ();
+    auto  ret  =  Response_Cache::Fetched {};
+    prepare_fetch (K, query, V, ret.validators, *lease, deadline);
+
+    ret.body  =  perform (K, query, *lease);
+
+    curl_easy_getinfo (lease->getHandle (), CURLINFO_RESPONSE_CODE, &status);
+    ret.not_modified  =  status == 304;
+
+    return ret;
+  }
+
+
+
+  /*  How long to wait for an answer before sending a hedging request. */
+  static  chrono::microseconds  hedge_delay  (Kraken_API const &K,
+                                              string_view const function)
+  {
+    if (K.metrics)
+      {
+        auto const  H  =  K.metrics->histogram (function,
+                                                Request_Metrics::TOTAL);
+        auto const  target  =  (H.count * 95 + 99) / 100;
+        auto  seen  =  uint64_t {0};
+
+        if (H.count >= 20)
+          for (auto b = size_t {0};  b < Request_Metrics::BUCKETS.size ();
+                                     ++b)
+            if ((seen  +=  H.counts [b])  >=  target)
+              return  chrono::microseconds {Request_Metrics::BUCKETS [b]};
+      }
+
+    return K.policy.hedge_after;
+  }
+
+
+
+  /*  The same request made on one connection and, if it is slow to
+   *  answer, on a second, the first answer being taken and the other
+   *  request abandoned.  */
+  static  Response_Cache::Fetched  fetch_hedged
+                                     (Kraken_API const &K,
+                                      string_view const query,
+                                      Response_Cache::Validators const &V,
+                                      Clock::time_point const deadline,
+                                      long &status)
+  {
+    struct  Leg
+    {
+      explicit  Leg  (Connection_Pool::Lease &&L)  :  lease {move (L)}  {}
+
+      Connection_Pool::Lease   lease;
+      Response_Cache::Fetched  fetched;
+      bool                     running  {false};
+    };
+
+    struct  Race
+    {
+      ~Race  ()
+      {
+        for (auto &L  :  legs)
+          if (L.running)
+            curl_multi_remove_handle (multi, L.lease->getHandle ());
+        curl_multi_cleanup (multi);
+      }
+
+      CURLM *const  multi  {curl_multi_init ()};
+      list<Leg>     legs;
+    };
+
+    auto const  function  =  function_of (query);
+    auto  race  =  Race {};
+    if (! race.multi)
+      throw runtime_error {"cannot create libcurl multi handle"};
+
+    /*  The legs share the poolʼs connection cache; were they allowed to
+     *  multiplex, the second would ride on the firstʼs (perhaps stalled)
+     *  HTTP/2 connection instead of opening its own.  */
+    curl_multi_setopt (race.multi, CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+
+    auto const  start  =  [&K, &query, &V, deadline, &race, function] ()
+      {
+        auto &L  =  race.legs.emplace_back (K.connection_pool->lease ());
+        prepare_fetch (K, query, V, L.fetched.validators, *L.lease,
+                       deadline);
+        receive_into (L.fetched.body, *L.lease,
+                      reply_size (function).load (memory_order_relaxed));
+
+        curl_multi_add_handle (race.multi, L.lease->getHandle ());
+        L.running  =  true;
+      };
+
+    start ();
+    auto const  hedge_at  =  Clock::now () + hedge_delay (K, function);
+    auto  failure  =  CURLE_OK;
+
+    for (;;)
+      {
+        auto  running  =  int {0};
+        curl_multi_perform (race.multi, &running);
+
+        auto  queued  =  int {0};
+        while (auto *const  M  =  curl_multi_info_read (race.multi, &queued))
+          {
+            if (M->msg != CURLMSG_DONE)   continue;
+
+            auto  L  =  find_if (race.legs.begin (),  race.legs.end (),
+                                 [M] (Leg const &L)
+                                     {  return  L.lease->getHandle ()
+                                                  ==  M->easy_handle;  });
+            curl_multi_remove_handle (race.multi, M->easy_handle);
+            L->running  =  false;
+
+            if (M->data.result != CURLE_OK)
+              {
+                failure  =  M->data.result;
+                continue;
+              }
+
+            curl_easy_getinfo (M->easy_handle, CURLINFO_RESPONSE_CODE,
+                               &status);
+            L->fetched.not_modified  =  status == 304;
+            reply_size (function).store (L->fetched.body.size ()
+                                           +  L->fetched.body.size () / 8,
+                                         memory_order_relaxed);
+
+            if (K.metrics)
+              {
+                measure (*K.metrics, function, *L->lease);
+                K.metrics->record_errors (function, L->fetched.body);
+              }
+
+            return  move (L->fetched);
+          }
+
+        if (none_of (race.legs.begin (),  race.legs.end (),
+                     [] (Leg const &L)  {  return L.running;  }))
+          {
+            if (K.metrics)   K.metrics->record_failure (function);
+            throw C::LibcurlRuntimeError {curl_easy_strerror (failure),
+                                          failure};
+          }
+
+        auto const  now  =  Clock::now ();
+        auto  wait  =  chrono::milliseconds {100};
+
+        if (race.legs.size () == 1)
+          {
+            if (now < hedge_at)
+              wait  =  min (wait,
+                            chrono::ceil<chrono::milliseconds>
+                                                   (hedge_at - now));
+
+            else if (! K.rate_limiter
+                       ||  K.rate_limiter->public_headroom () >= 1.0)
+              {
+                if (K.rate_limiter)   K.rate_limiter->acquire_public ();
+                start ();
+                continue;
+              }
+          }
+
+        curl_multi_poll (race.multi, nullptr, 0, int (wait.count ()),
+                         nullptr);
+      }
+  }
+
+
+
+  /*  A public request, made again according to the policy if it fails.
+   */
+  static  Response_Cache::Fetched  fetch_public
+                                     (Kraken_API const &K,
+                                      string_view const query,
+                                      Response_Cache::Validators const &V)
+  {
+    auto const &P         =  K.policy;
+    auto const  function  =  function_of (query);
+    auto const  deadline  =  Clock::now () + P.timeout;
+    auto const  fetch     =  find (P.hedged.begin (), P.hedged.end (),
+                                   function) == P.hedged.end ()
+                               ?  fetch_once  :  fetch_hedged;
+
+    for (auto  attempt  =  1u;  ;  ++attempt)
+      {
+        if (K.rate_limiter)   K.rate_limiter->acquire_public ();
+
+        try
+          {
+            auto  status  =  long {0};
+            auto  ret     =  fetch (K, query, V, deadline, status);
+
+            if (! transient (P, status, ret.body)
+                  ||  attempt >= P.attempts
+                  ||  ! back_off (P, attempt, deadline))
+              return ret;
+          }
+        catch (C::LibcurlRuntimeError const &E)
+          {
+            if (! retryable (E.whatCode ())
+                  ||  attempt >= P.attempts
+                  ||  ! back_off (P, attempt, deadline))
+              throw;
+          }
+
+        if (K.metrics)   K.metrics->record_retry (function);
+      }
+  }
+
+
+
+  string  query_public  (Kraken_API const &K,  string_view const query)
+  {
+    auto const  arena  =  Request_Arena::Scope {};
+
+    if (K.response_cache)
+      return  K.response_cache->get
+                 (string {query},
+                  [&K, &query] (Response_Cache::Validators const &V)
+                      {  return fetch_public (K, query, V);  });
+
+    return  fetch_public (K, query, {}).body;
+  }
+
+
+
+  /*  Each try is signed afresh, with a new nonce. */
+  string  query_private  (Kraken_API const &K,  string_view const query)
+  {
+    if (K.rate_limiter)   K.rate_limiter->acquire (function_of (query));
+
+    auto const  arena     =  Request_Arena::Scope {};
+    auto const  deadline  =  Clock::now () + K.policy.timeout;
+
+    for (auto  attempt  =  1u;  ;  ++attempt)
+      {
+        auto const  lease  =  K.connection_pool->lease ();
+        prepare_private (K, query, *lease, thread_signed_request ());
+        set_deadline (K, *lease, deadline);
+
+        try
+          {
+            auto  result  =  perform (K, query, *lease);
+            check_limit (K.rate_limiter, result);
+            return result;
+          }
+        catch (C::LibcurlRuntimeError const &)
+          {
+            if (sent_any (*lease)
+                  ||  attempt >= K.policy.attempts
+                  ||  ! back_off (K.policy, attempt, deadline))
+              throw;
+          }
+
+        if (K.metrics)   K.metrics->record_retry (function_of (query));
+      }
+  }
+
+
+
+  /*  A public request whose reply goes to the sink as it arrives.  If the
+   *  sink throws, the transfer is abandoned and the exception passed on.
+   */
+  void  stream_public  (Kraken_API const &K,
+                        string_view const query,
+                        Kraken_API::Sink const &sink)
+  {
+    auto const &P         =  K.policy;
+    auto const  function  =  function_of (query);
+    auto const  deadline  =  Clock::now () + P.timeout;
+    auto const  arena     =  Request_Arena::Scope {};
+
+    for (auto  attempt  =  1u;  ;  ++attempt)
+      {
+        if (K.rate_limiter)   K.rate_limiter->acquire_public ();
+
+        auto const  lease    =  K.connection_pool->lease ();
+        auto        started  =  false;
+        auto        failure  =  exception_ptr {};
+
+        prepare_public (K, query, *lease);
+        set_deadline (K, *lease, deadline);
+
+        /*  Anything short of the whole piece makes libcurl stop. */
+        lease->setOpt (CO::WriteFunction
+                       {[&] (char *const buffer,
+                             size_t const size,
+                             size_t const n)  ->  size_t
+                          {
+                            auto const  piece  =  string_view {buffer,
+                                                               size * n};
+                            try
+                              {
+                                if (! started  &&  K.metrics)
+                                  K.metrics->record_errors (function, piece);
+                                started  =  true;
+                                sink (piece);
+                                return piece.size ();
+                              }
+                            catch (...)
+                              {
+                                failure  =  current_exception ();
+                                return 0;
+                              }
+                          }});
+
+        try
+          {
+            lease->perform ();
+            if (K.metrics)   measure (*K.metrics, function, *lease);
+            return;
+          }
+        catch (C::LibcurlRuntimeError const &E)
+          {
+            if (failure)     rethrow_exception (failure);
+            if (K.metrics)   K.metrics->record_failure (function);
+
+            if (started
+                  ||  ! retryable (E.whatCode ())
+                  ||  attempt >= P.attempts
+                  ||  ! back_off (P, attempt, deadline))
+              throw;
+          }
+
+        if (K.metrics)   K.metrics->record_retry (function);
+      }
+  }
+
+
+
+  /*  The asynchronous forms wait for the limiter on the callerʼs thread,
+   *  before anything is handed to the engine.  They are bound by the
+   *  policyʼs timeouts, but not tried again.  The send_ forms are for
+   *  callers which have already had the request let through the limiter
+   *  themselves.  */
+
+  void  send_public  (Kraken_API const &K,
+                      string_view const query,
+                      Kraken_API::Completion done)
+  {
+    auto const  arena  =  Request_Arena::Scope {};
+    auto  &E     =  engine (K);
+    auto  lease  =  E.pool ().lease ();
+    prepare_public (K, query, *lease);
+    set_deadline (K, *lease, Clock::now () + K.policy.timeout);
+    E.submit (move (lease),
+              measured (K, query, move (done)),
+              inspection (K, query));
+  }
+
+
+
+  void  send_private  (Kraken_API const &K,
+                       string_view const query,
+                       Kraken_API::Completion done)
+  {
+    auto const  arena  =  Request_Arena::Scope {};
+    auto  &E     =  engine (K);
+    auto  lease  =  E.pool ().lease ();
+    auto  S      =  make_shared<Signed_Request> ();
+    prepare_private (K, query, *lease, *S);
+    set_deadline (K, *lease, Clock::now () + K.policy.timeout);
+
+    /*  S must last until the transfer is done. */
+    E.submit (move (lease),
+              [L = K.rate_limiter,  S,
+               done {measured (K, query, move (done))}]
+                  (string const &result,  exception_ptr const error)
+                  {
+                    if (! error)   check_limit (L, result);
+                    if (done)      done (result, error);
+                  },
+              inspection (K, query));
+  }
+
+
+
+  void  submit_public  (Kraken_API const &K,
+                        string_view const query,
+                        Kraken_API::Completion done)
+  {
+    if (K.rate_limiter)   K.rate_limiter->acquire_public ();
+    send_public (K, query, move (done));
+  }
+
+
+  void  submit_private  (Kraken_API const &K,
+                         string_view const query,
+                         Kraken_API::Completion done)
+  {
+    if (K.rate_limiter)   K.rate_limiter->acquire (function_of (query));
+    send_private (K, query, move (done));
   }
 
 
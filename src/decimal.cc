@@ -0,0 +1,296 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-decimal.h>
+#include <cmath>
+#include <cstring>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Decimal  D;
+
+
+  static constexpr  array<int64_t, D::MAX_SCALE + 1>  POWERS
+    {1,  10,  100,  1'000,  10'000,  100'000,  1'000'000,  10'000'000,
+     100'000'000,  1'000'000'000,  10'000'000'000,  100'000'000'000,
+     1'000'000'000'000,  10'000'000'000'000,  100'000'000'000'000,
+     1'000'000'000'000'000,  10'000'000'000'000'000,
+     100'000'000'000'000'000,  1'000'000'000'000'000'000};
+
+
+
+  static  void  check_scale  (int const scale)
+  {
+    if (scale < 0  ||  scale > D::MAX_SCALE)
+      throw out_of_range {"decimal scale " + to_string (scale)};
+  }
+
+
+
+  from_chars_result  D::from_chars  (char const *const first,
+                                     char const *const last,
+                                     D &value,
+                                     int const scale)
+  {
+    auto  p  =  first;
+    auto const  negative  =  p != last  &&  *p == '-';
+    if (negative)   ++p;
+
+    auto const  digits  =  [last] (char const *q)
+      {  while (q != last  &&  *q >= '0'  &&  *q <= '9')   ++q;   return q; };
+
+    auto const  whole_end     =  digits (p);
+    auto        point         =  whole_end;
+    auto        fraction_end  =  whole_end;
+    if (whole_end != last  &&  *whole_end == '.')
+      fraction_end  =  digits (++point);
+
+    if (whole_end == p  &&  fraction_end == point)
+      return {first, errc::invalid_argument};
+
+    auto const  written  =  int (fraction_end - point);
+    auto const  target   =  scale < 0  ?  min (written, D::MAX_SCALE)
+                                       :  scale;
+    if (target > D::MAX_SCALE)
+      return {first, errc::invalid_argument};
+
+    /*  Accumulated as a negative number, which has the greater range.
+     */
+    auto  units  =  int64_t {0};
+    auto const  push  =  [&units] (int const d)
+      {
+        return  ! __builtin_mul_overflow (units, 10, &units)
+                  &&  ! __builtin_sub_overflow (units, d, &units);
+      };
+
+    for (auto q  =  p;  q != whole_end;  ++q)
+      if (! push (*q - '0'))
+        return {fraction_end, errc::result_out_of_range};
+
+    for (auto i  =  0;  i < target;  ++i)
+      if (! push (i < written  ?  point [i] - '0'  :  0))
+        return {fraction_end, errc::result_out_of_range};
+
+    if (written > target  &&  point [target] >= '5')
+      if (__builtin_sub_overflow (units, 1, &units))
+        return {fraction_end, errc::result_out_of_range};
+
+    if (! negative)
+      {
+        if (units == INT64_MIN)
+          return {fraction_end, errc::result_out_of_range};
+        units  =  -units;
+      }
+
+    value  =  D {units, target};
+    return {fraction_end, errc {}};
+  }
+
+
+
+  D  D::parse  (string_view const text,  int const scale)
+  {
+    auto        ret     =  D {};
+    auto const  result  =  from_chars (text.data (),
+                                       text.data () + text.size (),
+                                       ret,  scale);
+
+    if (result.ec != errc {}  ||  result.ptr != text.data () + text.size ())
+      throw invalid_argument {"not a decimal: " + string {text}};
+
+    return ret;
+  }
+
+
+
+  D  D::from_double  (double const value,  int const scale)
+  {
+    check_scale (scale);
+
+    auto const  scaled  =  round (value * double (POWERS [scale]));
+    if (! (fabs (scaled) < 9.2e18))
+      throw overflow_error {"decimal out of range"};
+
+    return  D {int64_t (scaled), scale};
+  }
+
+
+
+  double  D::to_double  ()  const
+  {
+    return  double (units) / double (POWERS [scale]);
+  }
+
+
+
+  D  D::rescale  (int const new_scale,  Rounding const rounding)  const
+  {
+    check_scale (new_scale);
+
+    if (new_scale >= scale)
+      {
+        auto  ret  =  D {0, new_scale};
+        if (__builtin_mul_overflow (units, POWERS [new_scale - scale],
+                                    &ret.units))
+          throw overflow_error {"decimal out of range"};
+        return ret;
+      }
+
+    auto const  divisor    =  POWERS [scale - new_scale];
+    auto        quotient   =  units / divisor;
+    auto const  remainder  =  units % divisor;
+
+    switch (rounding)
+      {
+      case NEAREST:
+        if (remainder >= (divisor + 1) / 2)          ++quotient;
+        else if (remainder <= -(divisor + 1) / 2)    --quotient;
+        break;
+      case DOWN:   if (remainder < 0)   --quotient;   break;
+      case UP:     if (remainder > 0)   ++quotient;   break;
+      }
+
+    return  D {quotient, new_scale};
+  }
+
+
+
+  to_chars_result  D::to_chars  (char *const first,
+                                 char *const last)  const
+  {
+    /*  The digits are made backwards at the end of a local buffer, with
+     *  zeros as needed up to the units place.  */
+    auto  buffer  =  Text {};
+    auto  p       =  buffer.data () + buffer.size ();
+
+    auto  magnitude  =  units < 0  ?  uint64_t (0) - uint64_t (units)
+                                   :  uint64_t (units);
+
+    for (auto i  =  0;  i < scale;  ++i,  magnitude /= 10)
+      *--p  =  char ('0' + magnitude % 10);
+
+    if (scale > 0)   *--p  =  '.';
+
+    do
+      *--p  =  char ('0' + magnitude % 10);
+    while (magnitude  /=  10);
+
+    if (units < 0)   *--p  =  '-';
+
+    auto const  length  =  size_t (buffer.data () + buffer.size () - p);
+    if (size_t (last - first) < length)
+      return {last, errc::value_too_large};
+
+    memcpy (first, p, length);
+    return {first + length, errc {}};
+  }
+
+
+
+  string_view  D::write  (Text &buffer)  const
+  {
+    auto const  end  =  to_chars (buffer.data (),
+                                  buffer.data () + buffer.size () - 1).ptr;
+    *end  =  '\0';
+    return  string_view (buffer.data (),  size_t (end - buffer.data ()));
+  }
+
+
+
+  string  D::str  ()  const
+  {
+    auto  buffer  =  Text {};
+    return  string {write (buffer)};
+  }
+
+
+
+  int  compare  (D const a,  D const b)
+  {
+    /*  Whole parts first, which cannot overflow, then the fractions at the
+     *  finer scale, which are less than 10^18.  */
+    auto const  whole_a  =  a.units / POWERS [a.scale];
+    auto const  whole_b  =  b.units / POWERS [b.scale];
+    if (whole_a != whole_b)   return  whole_a < whole_b  ?  -1  :  1;
+
+    auto const  scale  =  max (a.scale, b.scale);
+    auto const  part_a  =  a.units % POWERS [a.scale]
+                              *  POWERS [scale - a.scale];
+    auto const  part_b  =  b.units % POWERS [b.scale]
+                              *  POWERS [scale - b.scale];
+
+    return  part_a < part_b  ?  -1  :  part_a > part_b  ?  1  :  0;
+  }
+
+
+
+  D  operator+  (D const a,  D const b)
+  {
+    auto const  scale  =  max (a.scale, b.scale);
+    auto        ret    =  D {0, scale};
+
+    if (__builtin_add_overflow (a.rescale (scale).units,
+                                b.rescale (scale).units,
+                                &ret.units))
+      throw overflow_error {"decimal out of range"};
+
+    return ret;
+  }
+
+
+
+  D  operator-  (D const a,  D const b)
+  {
+    auto const  scale  =  max (a.scale, b.scale);
+    auto        ret    =  D {0, scale};
+
+    if (__builtin_sub_overflow (a.rescale (scale).units,
+                                b.rescale (scale).units,
+                                &ret.units))
+      throw overflow_error {"decimal out of range"};
+
+    return ret;
+  }
+
+
+
+  D  operator-  (D const a)
+  {
+    return  D {0, a.scale} - a;
+  }
+
+
+
+  D  operator*  (D const a,  int64_t const n)
+  {
+    auto  ret  =  D {0, a.scale};
+
+    if (__builtin_mul_overflow (a.units, n, &ret.units))
+      throw overflow_error {"decimal out of range"};
+
+    return ret;
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,113 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_ACCOUNTS__H
+#define DMBCS_KRAKEN_ACCOUNTS__H
+
+
+/*  Many accounts (sub-accounts, say) traded from one program, over one
+ *  connection pool and one request engine.  Each account keeps its own
+ *  rate limiter and nonces, as Kraken counts both per key.  */
+
+
+#include <dmbcs-kraken-api.h>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  class  Account_Manager
+  {
+  public:
+
+    explicit  Account_Manager  (shared_ptr<Connection_Pool> P
+                                    =  make_shared<Connection_Pool> ());
+
+    ~Account_Manager  ();
+
+    Account_Manager  (Account_Manager const &)  =  delete;
+    Account_Manager &  operator=  (Account_Manager const &)  =  delete;
+
+
+    /*  Add an account under the given name, and return the object
+     *  through which to make its calls; that stays valid until the
+     *  account is removed.  Its nonces are kept in memory, or in the
+     *  named file if nonce_file is not empty (see Nonce_Source).  Throws
+     *  invalid_argument if the name is already taken, and runtime_error
+     *  if the nonce file cannot be used.  */
+    Kraken_API &  add  (string const &name,
+                        string const &key,
+                        string const &secret,
+                        Rate_Limiter::Tier  =  Rate_Limiter::STARTER,
+                        string const &nonce_file  =  {});
+
+    /*  Nothing must still be using the accountʼs object. */
+    void  remove  (string const &name);
+
+
+    /*  Throws out_of_range if there is no such account. */
+    Kraken_API &  account  (string const &name)  const;
+
+    Kraken_API &  operator[]  (string const &name)  const
+    {   return account (name);   }
+
+    bool  contains  (string const &name)  const;
+
+    vector<string>  names  ()  const;
+
+    size_t  size  ()  const;
+
+
+    /*  An object with no key, for the public functions.  Kraken limits
+     *  these by address rather than by key, so they are best all made
+     *  through here, where one limiter counts them.  */
+    Kraken_API &  market  ()  const;
+
+
+    /*  Call f with the name and object of every account, e.g. to cancel
+     *  all their orders.  Accounts may not be added or removed by f.  */
+    void  for_each
+            (function<void (string const &, Kraken_API &)> const &f)  const;
+
+
+    /*  These apply to every account, those already added and those still
+     *  to come, and to market (); like the set_ functions of Kraken_API,
+     *  they must not be called while requests are being made.  */
+    void  set_url_base  (string const &);
+    void  set_metrics   (shared_ptr<Request_Metrics>);
+    void  set_policy    (Request_Policy const &);
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Account_Manager.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_ACCOUNTS__H.  */
@@ -20,8 +20,11 @@
 
 
 #include <dmbcs-kraken-api.h>
+#include <dmbcs-kraken-endpoints.h>
+#include <dmbcs-kraken-market.h>
+#include <json-reader.h>
+#include <algorithm>
 #include <cstdarg>
-#include <map>
 
 
 namespace  DMBCS  {
@@ -31,244 +34,1340 @@ namespace  DMBCS  {
 
 
   /* Defined in curl.cc. */
-  void  query_private  (K &);
-  void  query_public   (K &);
+  string  query_private   (K const &,  string_view query);
+  string  query_public    (K const &,  string_view query);
+  void    submit_private  (K const &,  string_view query,  K::Completion);
+  void    submit_public   (K const &,  string_view query,  K::Completion);
+  void    send_private    (K const &,  string_view query,  K::Completion);
+  void    send_public     (K const &,  string_view query,  K::Completion);
+  void    stream_public   (K const &,  string_view query,  K::Sink const &);
 
 
 
-  static  auto const  OPTION_STRING
-      = map<K::Option, string> { {K::INFO,          "info"             },
-                                 {K::ACLASS,        "aclass"           },
-                                 {K::ASSET,         "asset"            },
-                                 {K::TRADES,        "trades"           },
-                                 {K::USERREF,       "userref"          },
-                                 {K::START,         "start"            },
-                                 {K::END,           "end"              },
-                                 {K::OFS,           "ofs"              },
-                                 {K::CLOSE_TIME,    "closetime"        },
-                                 {K::DO_CALCS,      "docalcs"          },
-                                 {K::PAIR,          "pair"             },
-                                 {K::FEE_INFO,      "fee-info"         },
-                                 {K::OFLAGS,        "oflags"           },
-                                 {K::START_TIME,    "starttm"          },
-                                 {K::EXPIRE_TIME,   "expiretm"         },
-                                 {K::VALIDATE,      "validate"         },
-                                 {K::LEVERAGE,      "leverage"         },
-                                 {K::TYPE,          "type"             },
-                                 {K::CLOSE_TYPE,    "close[ordertype]" },
-                                 {K::CLOSE_PRICE_1, "close[price]"     },
-                                 {K::CLOSE_PRICE_2, "close[price2]"    },
-                                 {K::INTERVAL,      "interval"         },
-                                 {K::SINCE,         "since"            },
-                                 {K::COUNT,         "count"            }};
-  
-
-
-  static  void  query_add_options (K &k,
-                                   vector<K::Option> const &options,
-                                   char joiner)
+  /*  Indexed by K::Option. */
+  static  constexpr  array<char const *, K::__CEILING>  OPTION_STRING
+      {  "info",               /*  INFO           */
+         "aclass",             /*  ACLASS         */
+         "asset",              /*  ASSET          */
+         "trades",             /*  TRADES         */
+         "userref",            /*  USERREF        */
+         "start",              /*  START          */
+         "end",                /*  END            */
+         "ofs",                /*  OFS            */
+         "closetime",          /*  CLOSE_TIME     */
+         "docalcs",            /*  DO_CALCS       */
+         "pair",               /*  PAIR           */
+         "fee-info",           /*  FEE_INFO       */
+         "oflags",             /*  OFLAGS         */
+         "starttm",            /*  START_TIME     */
+         "expiretm",           /*  EXPIRE_TIME    */
+         "validate",           /*  VALIDATE       */
+         "leverage",           /*  LEVERAGE       */
+         "type",               /*  TYPE           */
+         "close[ordertype]",   /*  CLOSE_TYPE     */
+         "close[price]",       /*  CLOSE_PRICE_1  */
+         "close[price2]",      /*  CLOSE_PRICE_2  */
+         "interval",           /*  INTERVAL       */
+         "since",              /*  SINCE          */
+         "count"  };           /*  COUNT          */
+
+  static_assert (OPTION_STRING [K::COUNT] [0]  ==  'c',
+                 "OPTION_STRING out of step with K::Option");
+
+
+
+  /*  Enough for any query but those with very long lists of txids, so
+   *  that building one costs a single allocation.  */
+  static  constexpr  size_t  QUERY_RESERVE  {512};
+
+
+  /*  Queries are made in the threadʼs request arena, inside a
+   *  Request_Arena::Scope.  */
+  using  Query  =  Request_Arena::String;
+
+  static  Query  new_query  (string_view const function,
+                             size_t const reserve  =  QUERY_RESERVE)
+  {
+    auto  query  =  Query {&Request_Arena::resource ()};
+    query.reserve (reserve);
+    query  +=  function;
+    return query;
+  }
+
+
+
+  /*  Append value to the query, percent-encoding everything but RFC 3986
+   *  unreserved characters.  */
+  template <typename Text>
+  static  void  append_encoded  (Text &query,  string_view value)
+  {
+    static  constexpr  char  HEX []  {"0123456789ABCDEF"};
+
+    for (auto const c  :  value)
+      {
+        auto const  u  =  static_cast<unsigned char> (c);
+
+        if ((c >= 'A' && c <= 'Z')  ||  (c >= 'a' && c <= 'z')
+                ||  (c >= '0' && c <= '9')
+                ||  c == '-'  ||  c == '.'  ||  c == '_'  ||  c == '~')
+          query  +=  c;
+        else
+          {
+            query  +=  '%';
+            query  +=  HEX [u >> 4];
+            query  +=  HEX [u & 0x0f];
+          }
+      }
+  }
+
+
+
+  template <typename Text>
+  static  void  append_argument  (Text &query,
+                                  char const joiner,
+                                  string_view name,
+                                  string_view value)
+  {
+    query  +=  joiner;
+    query  +=  name;
+    query  +=  '=';
+    append_encoded (query, value);
+  }
+
+
+
+  template <typename Text>
+  static  void  add_options  (Text &query,
+                              K::Options const &values,
+                              initializer_list<K::Option> options,
+                              char joiner)
   {
     for (auto const &O  :  options)
       {
-        auto const &option  =  k.options_table [O];
+        auto const &option  =  values [O];
 
         if (option.length ())
           {
-            if (joiner)  k.query_url += joiner;
+            append_argument (query, joiner, OPTION_STRING [O], option);
             joiner  =  '&';
-
-            k.query_url  +=  OPTION_STRING.at (O)  +  '='  +  option;
           }
       }
   }
 
 
-
-  static  auto  const  ORDER_TYPE__STRING
-      = map<K::Order_Type, string>
-        { { K::MARKET,                 "market"                 },
-          { K::LIMIT,                  "limit"                  },
-          { K::STOP_LOSS,              "stop-loss"              },
-          { K::TAKE_PROFIT,            "take-profit"            },
-          { K::STOP_LOSS_PROFIT,       "stop-loss-profit"       },
-          { K::STOP_LOSS_PROFIT_LIMIT, "stop-loss-profit-limit" },
-          { K::STOP_LOSS_LIMIT,        "stop-loss-limit"        },
-          { K::TAKE_PROFIT_LIMIT,      "take-profit-limit"      },
-          { K::TRAILING_STOP,          "trailing-stop"          },
-          { K::TRAILING_STOP_LIMIT,    "trailing-stop-limit"    },
-          { K::STOP_LOSS_AND_LIMIT,    "stop-loss-and-limit"    },
-          { K::SETTLE_POSITION,        "settle-position"        } };
+  /*  Not static, so that the benchmarks can time it. */
+  void  query_add_options (string &query,
+                           K::Options const &values,
+                           initializer_list<K::Option> options,
+                           char joiner)
+  {   add_options (query, values, options, joiner);   }
+
+
+
+
+  /*  Indexed by K::Order_Type. */
+  static  constexpr  array<char const *, K::SETTLE_POSITION + 1>
+  ORDER_TYPE__STRING
+        {  "market",                   /*  MARKET                  */
+           "limit",                    /*  LIMIT                   */
+           "stop-loss",                /*  STOP_LOSS               */
+           "take-profit",              /*  TAKE_PROFIT             */
+           "stop-loss-profit",         /*  STOP_LOSS_PROFIT        */
+           "stop-loss-profit-limit",   /*  STOP_LOSS_PROFIT_LIMIT  */
+           "stop-loss-limit",          /*  STOP_LOSS_LIMIT         */
+           "take-profit-limit",        /*  TAKE_PROFIT_LIMIT       */
+           "trailing-stop",            /*  TRAILING_STOP           */
+           "trailing-stop-limit",      /*  TRAILING_STOP_LIMIT     */
+           "stop-loss-and-limit",      /*  STOP_LOSS_AND_LIMIT     */
+           "settle-position"  };       /*  SETTLE_POSITION         */
+
+
+
+  /*  The arguments of an order: named as AddOrder takes them if index is
+   *  negative, else as element index of AddOrderBatchʼs orders array, so
+   *  that "close[price]" becomes "orders[2][close][price]".  */
+  static  void  append_order  (Query &query,
+                               K::Order const &order,
+                               int const index)
+  {
+    auto  name   =  string {};
+    auto  field  =  [&name, index] (string_view const N)  ->  string_view
+      {
+        if (index < 0)   return N;
+
+        auto const  bracket  =  N.find ('[');
+        name  =  "orders[";
+        name  +=  to_string (index);
+        name  +=  "][";
+        name  +=  N.substr (0, bracket);
+        name  +=  ']';
+        if (bracket != N.npos)   name  +=  N.substr (bracket);
+        return name;
+      };
+
+    append_argument (query, '&', field ("type"),
+                     order.instruction == K::BUY ? "buy" : "sell");
+    append_argument (query, '&', field ("ordertype"),
+                     ORDER_TYPE__STRING [order.order_type]);
+    append_argument (query, '&', field ("volume"), order.volume);
+
+    if (! order.price.empty ())
+      append_argument (query, '&', field ("price"), order.price);
+    if (! order.price2.empty ())
+      append_argument (query, '&', field ("price2"), order.price2);
+
+    for (auto const O  :  {K::LEVERAGE, K::OFLAGS, K::START_TIME,
+                           K::EXPIRE_TIME, K::USERREF, K::CLOSE_TYPE,
+                           K::CLOSE_PRICE_1, K::CLOSE_PRICE_2})
+      if (! order.options [O].empty ())
+        append_argument (query, '&', field (OPTION_STRING [O]),
+                         order.options [O]);
+  }
+
+
+
+  static  Query  add_order_query  (K::Order const &order)
+  {
+    auto  query  =  new_query ("AddOrder");
+
+    append_argument (query, '?', "pair", order.pair);
+    append_order (query, order, -1);
+    append_argument (query, '&', "trading_agreement", "agree");
+    add_options (query, order.options, {K::VALIDATE}, '&');
+
+    return query;
+  }
+
+
+
+  /*  The prices, as many as the order type needs, are char* arguments. */
+  static  K::Order  variadic_order  (K::Options const &options,
+                                     K::Instruction const &instruction,
+                                     K::Order_Type const &order_type,
+                                     string const &asset,
+                                     string const &volume,
+                                     va_list ap)
+  {
+    auto  ret  =  K::Order {instruction, order_type, asset, volume,
+                            {}, {}, options};
+
+    switch (order_type)
+      {
+      case K::MARKET:
+      case K::SETTLE_POSITION:
+        break;
+
+      case K::LIMIT:
+      case K::STOP_LOSS:
+      case K::TAKE_PROFIT:
+      case K::TRAILING_STOP:
+        ret.price  =  va_arg (ap, char*);
+        break;
+
+      case K::STOP_LOSS_PROFIT:
+      case K::STOP_LOSS_PROFIT_LIMIT:
+      case K::STOP_LOSS_LIMIT:
+      case K::TAKE_PROFIT_LIMIT:
+      case K::TRAILING_STOP_LIMIT:
+      case K::STOP_LOSS_AND_LIMIT:
+        ret.price   =  va_arg (ap, char*);
+        ret.price2  =  va_arg (ap, char*);
+        break;
+      }
+
+    return ret;
+  }
 
 
 
   string  Kraken_API::add_order  (Instruction const &instruction,
                                   Order_Type const &order_type,
                                   string const &asset, string const &volume,
-                                  ...)
+                                  ...)  const
   {
     va_list ap;
     va_start (ap, volume);
+    auto const  order  =  variadic_order (options_table, instruction,
+                                          order_type, asset, volume, ap);
+    va_end (ap);
+    return add_order (order);
+  }
 
-    query_url  =  "AddOrder?pair="      +  asset
-                         +  "&type="    +  (instruction == BUY ? "buy" : "sell")
-                         +  "&ordertype="  +  ORDER_TYPE__STRING.at (order_type)
-                         +  "&volume="  +  volume
-                         +  "&trading_agreement=agree";
 
-    switch (order_type)
+
+  string  Kraken_API::add_order  (Options const &options,
+                                  Instruction const &instruction,
+                                  Order_Type const &order_type,
+                                  string const &asset, string const &volume,
+                                  ...)  const
+  {
+    va_list ap;
+    va_start (ap, volume);
+    auto const  order  =  variadic_order (options, instruction,
+                                          order_type, asset, volume, ap);
+    va_end (ap);
+    return add_order (order);
+  }
+
+
+
+  string  Kraken_API::add_order  (Instruction const &instruction,
+                                  Order_Type const &order_type,
+                                  string const &asset, string const &volume,
+                                  string const &price,
+                                  string const &price2)  const
+  {
+    return add_order (options_table, instruction, order_type, asset, volume,
+                      price, price2);
+  }
+
+
+
+  string  Kraken_API::add_order  (Options const &options,
+                                  Instruction const &instruction,
+                                  Order_Type const &order_type,
+                                  string const &asset, string const &volume,
+                                  string const &price,
+                                  string const &price2)  const
+  {
+    return add_order (Order {instruction, order_type, asset, volume,
+                             price, price2, options});
+  }
+
+
+
+  static  string  decimal_text  (optional<Decimal> const &D)
+  {
+    return  D  ?  D->str ()  :  string {};
+  }
+
+
+
+  string  Kraken_API::add_order  (Instruction const &instruction,
+                                  Order_Type const &order_type,
+                                  string const &asset,
+                                  Decimal const &volume,
+                                  optional<Decimal> const &price,
+                                  optional<Decimal> const &price2)  const
+  {
+    return add_order (options_table, instruction, order_type, asset, volume,
+                      price, price2);
+  }
+
+
+
+  string  Kraken_API::add_order  (Options const &options,
+                                  Instruction const &instruction,
+                                  Order_Type const &order_type,
+                                  string const &asset,
+                                  Decimal const &volume,
+                                  optional<Decimal> const &price,
+                                  optional<Decimal> const &price2)  const
+  {
+    return add_order (Order {instruction, order_type, asset, volume.str (),
+                             decimal_text (price), decimal_text (price2),
+                             options});
+  }
+
+
+
+  string  Kraken_API::add_order  (Order const &order)  const
+  {
+    auto const  arena  =  Request_Arena::Scope {};
+    return query_private (*this, add_order_query (order));
+  }
+
+
+
+  /*  Make a function which hands the request to the request engine with
+   *  the given submit function, and returns a future for its result.  */
+
+  static  auto  deferred  (void (*submit) (K const &, string_view,
+                                           K::Completion),
+                           K::Completion done)
+  {
+    return [submit, done {move (done)}] (K const &k, string_view query)
       {
-      case MARKET:
-      case SETTLE_POSITION:
-        break;
+        auto  promise  =  make_shared<std::promise<string>> ();
+        auto  ret      =  promise->get_future ();
 
-      case LIMIT:
-      case STOP_LOSS:
-      case TAKE_PROFIT:
-      case TRAILING_STOP:
-        query_url  +=  string {"&price="}  +  va_arg (ap, char*);
-        break;
+        submit (k,  query,
+                [promise, done] (string const &result, exception_ptr error)
+                    {
+                      /*  The future first, so that a callback which
+                       *  throws cannot leave it waiting forever. */
+                      if (error)  promise->set_exception (error);
+                      else        promise->set_value (result);
 
-      case STOP_LOSS_PROFIT:
-      case STOP_LOSS_PROFIT_LIMIT:
-      case STOP_LOSS_LIMIT:
-      case TAKE_PROFIT_LIMIT:
-      case TRAILING_STOP_LIMIT:
-      case STOP_LOSS_AND_LIMIT:
-        query_url  +=  string {"&price="}  +  va_arg (ap, char*)
-                            +  string {"&price2="}   +  va_arg (ap, char*);
-        break;
+                      if (done)
+                        try
+                          {
+                            done (result, error);
+                          }
+                        catch (...)
+                          {
+                          }
+                    });
+
+        return ret;
+      };
+  }
+
+
+
+  /*  The ways of making a request: there and then, returning the result;
+   *  by way of the request engine, returning a future for it or just
+   *  calling back when it is done (the caller having already let it
+   *  through the rate limiter); or handing the reply to a sink as it
+   *  arrives.  */
+
+  struct  Blocking
+  {
+    template <bool Private>
+    string  run  (K const &k,  string_view const query)
+    {
+      if constexpr (Private)   return query_private (k, query);
+      else                     return query_public (k, query);
+    }
+  };
+
+
+  struct  Deferred
+  {
+    template <bool Private>
+    future<string>  run  (K const &k,  string_view const query)
+    {
+      return  deferred (Private ? submit_private : submit_public,
+                        move (done))  (k, query);
+    }
+
+    K::Completion  done;
+  };
+
+
+  struct  Submitted
+  {
+    template <bool Private>
+    void  run  (K const &k,  string_view const query)
+    {
+      if constexpr (Private)   send_private (k, query, move (done));
+      else                     send_public (k, query, move (done));
+    }
+
+    K::Completion  done;
+  };
+
+
+  struct  Streamed
+  {
+    template <bool Private>
+    void  run  (K const &k,  string_view const query)
+    {
+      static_assert (! Private,  "only public replies are streamed");
+      stream_public (k, query, sink);
+    }
+
+    K::Sink const &  sink;
+  };
+
+
+
+  /*  The request which E describes, made in the given way; the argument
+   *  is null if the endpoint takes none.  */
+
+  template <Endpoint E,  typename Way>
+  static  auto  api_request  (K const &k,
+                              K::Options const &values,
+                              string const *const argument,
+                              Way way)
+  {
+    constexpr auto  D  =  describe (E);
+
+    auto const  arena  =  Request_Arena::Scope {};
+    auto  query  =  new_query (D.path);
+
+    auto  joiner  =  '?';
+    if constexpr (D.argument != nullptr)
+      {
+        append_argument (query, joiner, D.argument, *argument);
+        joiner  =  '&';
       }
 
-    query_add_options (*this,
-                       {LEVERAGE, OFLAGS, START_TIME, EXPIRE_TIME, USERREF,
-                        VALIDATE, CLOSE_TYPE, CLOSE_PRICE_1, CLOSE_PRICE_2},
-                       '&');
+    for (auto O  =  0;  O < K::__CEILING;  ++O)
+      if ((D.options & (uint32_t {1} << O))  &&  ! values [K::Option (O)]
+                                                          .empty ())
+        {
+          append_argument (query, joiner, OPTION_STRING [O],
+                           values [K::Option (O)]);
+          joiner  =  '&';
+        }
 
-    va_end(ap);
+    return way.template run<D.is_private> (k, query);
+  }
 
-    query_private (*this);
 
-    return query_result;
+  template <Endpoint E,  typename Way>
+  static  auto  api_function  (K const &k,
+                               K::Options const &values,
+                               Way way)
+  {
+    static_assert (! describe (E).argument,  "the endpoint needs its "
+                                             "argument");
+    return api_request<E> (k, values, nullptr, move (way));
   }
 
 
-
-  static  string  api_function  (K &k,
-                                 string const &api_function_,
-                                 vector<K::Option> const &options,
-                                 function <void (K &)> do_query)
+  template <Endpoint E,  typename Way>
+  static  auto  api_function  (K const &k,
+                               K::Options const &values,
+                               string const &argument,
+                               Way way)
   {
-    k.query_url  =  api_function_;
-    query_add_options (k, options, '?');
-    do_query (k);
-    return k.query_result;
+    static_assert (describe (E).argument,  "the endpoint takes no "
+                                           "argument");
+    return api_request<E> (k, values, &argument, move (way));
   }
 
 
 
-  static  string  api_function  (K &k,
-                                 string const &api_function_,
-                                 string const &arg,
-                                 string const &value,
-                                 vector<K::Option> const &options,
-                                 function <void (K &)> do_query)
+  template <Endpoint E>
+  string  endpoint_request  (K const &k,
+                             K::Options const &values,
+                             string const *const argument)
+  {   return api_request<E> (k, values, argument, Blocking {});   }
+
+
+  template  string  endpoint_request<Endpoint::TIME>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::ASSETS>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::ASSET_PAIRS>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::TICKER>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::OHLC>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::DEPTH>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::TRADES>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::SPREAD>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::BALANCE>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::TRADE_BALANCE>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::OPEN_ORDERS>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::CLOSED_ORDERS>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::QUERY_ORDERS>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::TRADES_HISTORY>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::QUERY_TRADES>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::OPEN_POSITIONS>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::LEDGERS>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::QUERY_LEDGERS>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::TRADE_VOLUME>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::CANCEL_ORDER>
+                         (K const &,  K::Options const &,  string const *);
+  template  string  endpoint_request<Endpoint::CANCEL_ALL>
+                         (K const &,  K::Options const &,  string const *);
+
+
+
+  template <Endpoint E>
+  void  endpoint_submit  (K const &k,
+                          K::Options const &values,
+                          string const *const argument,
+                          K::Completion done)
+  {   api_request<E> (k, values, argument, Submitted {move (done)});   }
+
+  template  void  endpoint_submit<Endpoint::TIME>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::ASSETS>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::ASSET_PAIRS>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::TICKER>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::OHLC>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::DEPTH>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::TRADES>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::SPREAD>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::BALANCE>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::TRADE_BALANCE>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::OPEN_ORDERS>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::CLOSED_ORDERS>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::QUERY_ORDERS>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::TRADES_HISTORY>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::QUERY_TRADES>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::OPEN_POSITIONS>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::LEDGERS>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::QUERY_LEDGERS>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::TRADE_VOLUME>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::CANCEL_ORDER>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+  template  void  endpoint_submit<Endpoint::CANCEL_ALL>
+                     (K const &,  K::Options const &,  string const *,
+                      K::Completion);
+
+
+
+  string  Kraken_API::cancel_order  (string const &txid)  const
+  {  return cancel_order (options_table, txid);  }
+
+  string  Kraken_API::cancel_order  (Options const &options,
+                                     string const &txid)  const
   {
-    k.query_url  =  api_function_  +  "?"  +  arg  +  "="  +  value;
-    query_add_options (k, options, '&');
-    do_query (k);
-    return k.query_result;
+    return api_function<Endpoint::CANCEL_ORDER> (*this, options, txid,
+                                                 Blocking {});
+  }
+
+  future<string>  Kraken_API::cancel_order_async  (string const &txid,
+                                                   Completion done)  const
+  {  return cancel_order_async (options_table, txid, move (done));  }
+
+  future<string>  Kraken_API::cancel_order_async  (Options const &options,
+                                                   string const &txid,
+                                                   Completion done)  const
+  {
+    return api_function<Endpoint::CANCEL_ORDER> (*this, options, txid,
+                                                 Deferred {move (done)});
   }
 
 
-
-  string  Kraken_API::cancel_order  (string const &txid)
-  {  return api_function
-                   (*this, "CancelOrder", "txid", txid, {}, query_private);  }
 
-  string  Kraken_API::account_balance  ()
-  {  return api_function (*this, "Balance", {}, query_private);  }
+  future<string>  Kraken_API::add_order_async  (Order const &order,
+                                                Completion done)  const
+  {
+    auto const  arena  =  Request_Arena::Scope {};
+    return deferred (submit_private, move (done))
+                         (*this, add_order_query (order));
+  }
 
-  string  Kraken_API::trade_balance  ()
-  {  return api_function (*this, "TradeBalance", {ASSET}, query_private);  }
 
-  string  Kraken_API::open_orders  ()
-  {  return api_function
-                 (*this, "OpenOrders", {TRADES, USERREF}, query_private);  }
 
-  string  Kraken_API::closed_orders  ()
+  string  Kraken_API::cancel_all  ()  const
   {
-    return api_function (*this, "ClosedOrders",
-                         {TRADES, USERREF, START, END, OFS, CLOSE_TIME},
-                         query_private);
+    return api_function<Endpoint::CANCEL_ALL> (*this, options_table,
+                                               Blocking {});
   }
 
-  string  Kraken_API::query_orders  (string const &txid)
+
+
+  /*  Kraken takes no more than these in one request. */
+  static  constexpr  size_t  ORDER_BATCH_LIMIT   {15};
+  static  constexpr  size_t  CANCEL_BATCH_LIMIT  {50};
+
+
+  /*  One order in the reply to AddOrder, or one element of the orders
+   *  array in the reply to AddOrderBatch.  */
+  static  void  read_order_result  (Json_Reader &R,  K::Order_Result &out)
   {
-    return api_function 
-        (*this, "QueryOrders", "txid", txid, {TRADES, USERREF}, query_private);
+    R.expect ('{');
+    for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+      {
+        auto const  key  =  R.string_value ();
+        R.expect (':');
+
+        if (key == "descr")
+          {
+            R.expect ('{');
+            for (auto m = ! R.consume ('}');  m;  m = R.more ('}'))
+              {
+                auto const  field  =  R.string_value ();
+                R.expect (':');
+                if (field == "order"  &&  R.peek () == '"')
+                  out.description  =  R.string_value ();
+                else
+                  R.skip ();
+              }
+          }
+        else if (key == "txid"  ||  key == "error")
+          {
+            auto &target  =  key == "txid"  ?  out.txid  :  out.error;
+            if (R.consume ('['))
+              for (auto m = ! R.consume (']');  m;  m = R.more (']'))
+                {
+                  if (! target.empty ())   target  +=  ", ";
+                  target  +=  R.string_value ();
+                }
+            else
+              target  =  R.string_value ();
+          }
+        else
+          R.skip ();
+      }
   }
 
-  string  Kraken_API::trades_history  ()
+
+
+  vector<K::Order_Result>  Kraken_API::add_orders
+                                       (vector<Order> const &orders)  const
   {
-    return api_function
-      (*this, "TradesHistory", {TYPE, TRADES, START, END, OFS}, query_private);
+    auto  ret  =  vector<Order_Result> (orders.size ());
+
+    /*  The orders for each pair, in the order given. */
+    auto  by_pair  =  vector<pair<string_view, vector<size_t>>> {};
+    for (auto i = size_t {0};  i < orders.size ();  ++i)
+      {
+        auto  P  =  find_if (by_pair.begin (),  by_pair.end (),
+                             [&] (auto const &B)
+                                 {  return B.first == orders [i].pair;  });
+        if (P == by_pair.end ())
+          P  =  by_pair.insert (P, {orders [i].pair, {}});
+        P->second.push_back (i);
+      }
+
+    /*  Kraken refuses a nonce lower than one it has already seen, and
+     *  requests in flight together on several connections may arrive in
+     *  any order; so each request is signed and sent only once the reply
+     *  to the one before it is in, the next query being built meanwhile.
+     *  The replies are read at the end.  */
+    auto const  arena  =  Request_Arena::Scope {};
+    auto  sent  =  vector<pair<vector<size_t>, future<string>>> {};
+    auto  send  =  deferred (submit_private, {});
+
+    for (auto const &[pair, indices]  :  by_pair)
+      for (auto b = size_t {0};  b < indices.size ();  b += ORDER_BATCH_LIMIT)
+        {
+          auto  batch  =  vector<size_t> {indices.begin () + b,
+                                          indices.begin ()
+                                            + min (b + ORDER_BATCH_LIMIT,
+                                                   indices.size ())};
+
+          auto  query  =  batch.size () == 1
+                            ?  add_order_query (orders [batch [0]])
+                            :  new_query ("AddOrderBatch", QUERY_RESERVE * 2);
+          if (batch.size () > 1)
+            {
+              append_argument (query, '?', "pair", pair);
+              for (auto j = size_t {0};  j < batch.size ();  ++j)
+                append_order (query, orders [batch [j]], int (j));
+              add_options (query, orders [batch [0]].options,
+                           {K::VALIDATE}, '&');
+            }
+
+          if (! sent.empty ())   sent.back ().second.wait ();
+
+          try
+            {
+              auto  reply  =  send (*this, query);
+              sent.emplace_back (move (batch), move (reply));
+            }
+          catch (exception const &E)
+            {
+              for (auto const i  :  batch)   ret [i].error  =  E.what ();
+            }
+        }
+
+    for (auto &[batch, reply]  :  sent)
+      try
+        {
+          auto const  json    =  reply.get ();
+          auto const  errors  =  envelope_errors (json,
+                                                  [&] (Json_Reader &R)
+            {
+              if (batch.size () == 1)
+                {
+                  read_order_result (R, ret [batch [0]]);
+                  return;
+                }
+
+              R.expect ('{');
+              for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+                {
+                  auto const  key  =  R.string_value ();
+                  R.expect (':');
+                  if (key != "orders")   {  R.skip ();  continue;  }
+
+                  R.expect ('[');
+                  auto  j  =  size_t {0};
+                  for (auto m = ! R.consume (']');  m;  m = R.more (']'))
+                    if (j < batch.size ())
+                      read_order_result (R, ret [batch [j++]]);
+                    else
+                      R.skip ();
+                }
+            });
+
+          if (! errors.empty ())
+            {
+              auto const  message  =  string {Kraken_Error {errors}.what ()};
+              for (auto const i  :  batch)   ret [i].error  =  message;
+            }
+        }
+      catch (exception const &E)
+        {
+          for (auto const i  :  batch)   ret [i].error  =  E.what ();
+        }
+
+    return ret;
   }
 
-  string  Kraken_API::trades_info  (string const  &txid)
+
+
+  size_t  Kraken_API::cancel_orders  (vector<string> const &txids)  const
   {
-    return api_function 
-                (*this, "QueryTrades", "txid", txid, {TRADES}, query_private);
+    auto const  arena  =  Request_Arena::Scope {};
+    auto  sent  =  vector<pair<size_t, future<string>>> {};
+    auto  send  =  deferred (submit_private, {});
+
+    auto  count   =  size_t {0};
+    auto  errors  =  vector<string> {};
+    auto  failed  =  vector<string> {};
+
+    /*  The batch starting at b is lost, but not the others. */
+    auto  fail  =  [&] (size_t const b,  string message)
+      {
+        errors.push_back (move (message));
+        failed.insert (failed.end (),
+                       txids.begin () + b,
+                       txids.begin () + min (b + CANCEL_BATCH_LIMIT,
+                                             txids.size ()));
+      };
+
+    for (auto b = size_t {0};  b < txids.size ();  b += CANCEL_BATCH_LIMIT)
+      {
+        auto  query  =  new_query ("CancelOrderBatch", QUERY_RESERVE * 2);
+
+        auto  joiner  =  '?';
+        auto const  end  =  min (b + CANCEL_BATCH_LIMIT,  txids.size ());
+        for (auto j = b;  j < end;  ++j)
+          {
+            append_argument (query, joiner,
+                             "orders[" + to_string (j - b) + "]", txids [j]);
+            joiner  =  '&';
+          }
+
+        /*  One at a time, as in add_orders. */
+        if (! sent.empty ())   sent.back ().second.wait ();
+
+        try
+          {
+            sent.emplace_back (b, send (*this, query));
+          }
+        catch (exception const &E)
+          {
+            fail (b, E.what ());
+          }
+      }
+
+    for (auto &[b, reply]  :  sent)
+      try
+        {
+          auto const  json  =  reply.get ();
+          auto  E  =  envelope_errors (json,  [&count] (Json_Reader &R)
+            {
+              R.expect ('{');
+              for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+                {
+                  auto const  key  =  R.string_value ();
+                  R.expect (':');
+                  if (key == "count")   count  +=  R.number<size_t> ();
+                  else                  R.skip ();
+                }
+            });
+
+          if (! E.empty ())
+            fail (b, Kraken_Error {move (E)}.what ());
+        }
+      catch (exception const &E)
+        {
+          fail (b, E.what ());
+        }
+
+    if (! errors.empty ())
+      throw Cancel_Orders_Error {move (errors), count, move (failed)};
+
+    return count;
+  }
+
+
+
+  string  Kraken_API::account_balance  ()  const
+  {  return account_balance (options_table);  }
+
+  string  Kraken_API::account_balance  (Options const &options)  const
+  {
+    return api_function<Endpoint::BALANCE> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::account_balance_async  (Completion done)  const
+  {  return account_balance_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::account_balance_async  (Options const &options,
+                                                      Completion done)  const
+  {
+    return api_function<Endpoint::BALANCE> (*this, options,
+                                            Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::trade_balance  ()  const
+  {  return trade_balance (options_table);  }
+
+  string  Kraken_API::trade_balance  (Options const &options)  const
+  {
+    return api_function<Endpoint::TRADE_BALANCE> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::trade_balance_async  (Completion done)  const
+  {  return trade_balance_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::trade_balance_async  (Options const &options,
+                                                    Completion done)  const
+  {
+    return api_function<Endpoint::TRADE_BALANCE> (*this, options,
+                                                  Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::open_orders  ()  const
+  {  return open_orders (options_table);  }
+
+  string  Kraken_API::open_orders  (Options const &options)  const
+  {
+    return api_function<Endpoint::OPEN_ORDERS> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::open_orders_async  (Completion done)  const
+  {  return open_orders_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::open_orders_async  (Options const &options,
+                                                  Completion done)  const
+  {
+    return api_function<Endpoint::OPEN_ORDERS> (*this, options,
+                                                Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::closed_orders  ()  const
+  {  return closed_orders (options_table);  }
+
+  string  Kraken_API::closed_orders  (Options const &options)  const
+  {
+    return api_function<Endpoint::CLOSED_ORDERS> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::closed_orders_async  (Completion done)  const
+  {  return closed_orders_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::closed_orders_async  (Options const &options,
+                                                    Completion done)  const
+  {
+    return api_function<Endpoint::CLOSED_ORDERS> (*this, options,
+                                                  Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::query_orders  (string const &txid)  const
+  {  return query_orders (options_table, txid);  }
+
+  string  Kraken_API::query_orders  (Options const &options,
+                                     string const &txid)  const
+  {
+    return api_function<Endpoint::QUERY_ORDERS> (*this, options, txid,
+                                                 Blocking {});
   }
 
-  string  Kraken_API::open_positions  (string const &txid)
+  future<string>  Kraken_API::query_orders_async  (string const &txid,
+                                                   Completion done)  const
+  {  return query_orders_async (options_table, txid, move (done));  }
+
+  future<string>  Kraken_API::query_orders_async  (Options const &options,
+                                                   string const &txid,
+                                                   Completion done)  const
+  {
+    return api_function<Endpoint::QUERY_ORDERS> (*this, options, txid,
+                                                 Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::trades_history  ()  const
+  {  return trades_history (options_table);  }
+
+  string  Kraken_API::trades_history  (Options const &options)  const
   {
-    return api_function 
-             (*this, "OpenPositions", "txid", txid, {DO_CALCS}, query_private);
+    return api_function<Endpoint::TRADES_HISTORY> (*this, options,
+                                                   Blocking {});
   }
 
-  string  Kraken_API::ledgers_info  ()
+  future<string>  Kraken_API::trades_history_async  (Completion done)  const
+  {  return trades_history_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::trades_history_async  (Options const &options,
+                                                     Completion done)  const
   {
-    return api_function (*this, "Ledgers",
-                         {ACLASS, ASSET, TYPE, START, END, OFS}, 
-                         query_private);
+    return api_function<Endpoint::TRADES_HISTORY> (*this, options,
+                                                   Deferred {move (done)});
   }
 
-  string  Kraken_API::query_ledgers  (string const  &id)
-  {  return api_function
-                    (*this, "QueryLedgers", "id", id, {}, query_private);  }
-  
-  string  Kraken_API::trade_volume  ()
-  {  return api_function
-                   (*this, "TradeVolume", {PAIR, FEE_INFO}, query_private);  }
 
-  string  Kraken_API::server_time  ()
-  {  return api_function (*this, "Time", {}, query_public);  }
 
-  string  Kraken_API::asset_info  ()
-  {  return api_function
-                  (*this, "Assets", {INFO, ACLASS, ASSET}, query_public);  }
+  string  Kraken_API::trades_info  (string const &txid)  const
+  {  return trades_info (options_table, txid);  }
 
-  string  Kraken_API::asset_pairs  ()
-  {  return api_function (*this, "AssetPairs", {INFO, PAIR}, query_public);  }
+  string  Kraken_API::trades_info  (Options const &options,
+                                    string const &txid)  const
+  {
+    return api_function<Endpoint::QUERY_TRADES> (*this, options, txid,
+                                                 Blocking {});
+  }
 
-  string  Kraken_API::ticker_info  (string const &pair)
-  {  return api_function (*this, "Ticker", "pair", pair, {}, query_public);  }
+  future<string>  Kraken_API::trades_info_async  (string const &txid,
+                                                  Completion done)  const
+  {  return trades_info_async (options_table, txid, move (done));  }
+
+  future<string>  Kraken_API::trades_info_async  (Options const &options,
+                                                  string const &txid,
+                                                  Completion done)  const
+  {
+    return api_function<Endpoint::QUERY_TRADES> (*this, options, txid,
+                                                 Deferred {move (done)});
+  }
 
-  string  Kraken_API::ohlc_data  (string const &pair)
-  {  return api_function
-           (*this, "OHLC", "pair", pair, {INTERVAL, SINCE}, query_public); }
 
-  string  Kraken_API::order_book  (string const &pair)
-  {  return api_function
-                    (*this, "Depth", "pair", pair, {COUNT}, query_public);  }
 
-  string  Kraken_API::recent_trades  (string const &pair)
-  {  return api_function 
-                    (*this, "Trades", "pair", pair, {SINCE}, query_public);  }
+  string  Kraken_API::open_positions  (string const &txid)  const
+  {  return open_positions (options_table, txid);  }
 
-  string  Kraken_API::spread_data  (string const &pair)
-  {  return api_function
-                  (*this, "Spread", "pair", pair, {SINCE}, query_public);  }
+  string  Kraken_API::open_positions  (Options const &options,
+                                       string const &txid)  const
+  {
+    return api_function<Endpoint::OPEN_POSITIONS> (*this, options, txid,
+                                                   Blocking {});
+  }
+
+  future<string>  Kraken_API::open_positions_async  (string const &txid,
+                                                     Completion done)  const
+  {  return open_positions_async (options_table, txid, move (done));  }
+
+  future<string>  Kraken_API::open_positions_async  (Options const &options,
+                                                     string const &txid,
+                                                     Completion done)  const
+  {
+    return api_function<Endpoint::OPEN_POSITIONS> (*this, options, txid,
+                                                   Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::ledgers_info  ()  const
+  {  return ledgers_info (options_table);  }
+
+  string  Kraken_API::ledgers_info  (Options const &options)  const
+  {
+    return api_function<Endpoint::LEDGERS> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::ledgers_info_async  (Completion done)  const
+  {  return ledgers_info_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::ledgers_info_async  (Options const &options,
+                                                   Completion done)  const
+  {
+    return api_function<Endpoint::LEDGERS> (*this, options,
+                                            Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::query_ledgers  (string const &id)  const
+  {  return query_ledgers (options_table, id);  }
+
+  string  Kraken_API::query_ledgers  (Options const &options,
+                                      string const &id)  const
+  {
+    return api_function<Endpoint::QUERY_LEDGERS> (*this, options, id,
+                                                  Blocking {});
+  }
+
+  future<string>  Kraken_API::query_ledgers_async  (string const &id,
+                                                    Completion done)  const
+  {  return query_ledgers_async (options_table, id, move (done));  }
+
+  future<string>  Kraken_API::query_ledgers_async  (Options const &options,
+                                                    string const &id,
+                                                    Completion done)  const
+  {
+    return api_function<Endpoint::QUERY_LEDGERS> (*this, options, id,
+                                                  Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::trade_volume  ()  const
+  {  return trade_volume (options_table);  }
+
+  string  Kraken_API::trade_volume  (Options const &options)  const
+  {
+    return api_function<Endpoint::TRADE_VOLUME> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::trade_volume_async  (Completion done)  const
+  {  return trade_volume_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::trade_volume_async  (Options const &options,
+                                                   Completion done)  const
+  {
+    return api_function<Endpoint::TRADE_VOLUME> (*this, options,
+                                                 Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::server_time  ()  const
+  {  return server_time (options_table);  }
+
+  string  Kraken_API::server_time  (Options const &options)  const
+  {
+    return api_function<Endpoint::TIME> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::server_time_async  (Completion done)  const
+  {  return server_time_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::server_time_async  (Options const &options,
+                                                  Completion done)  const
+  {
+    return api_function<Endpoint::TIME> (*this, options,
+                                         Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::asset_info  ()  const
+  {  return asset_info (options_table);  }
+
+  string  Kraken_API::asset_info  (Options const &options)  const
+  {
+    return api_function<Endpoint::ASSETS> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::asset_info_async  (Completion done)  const
+  {  return asset_info_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::asset_info_async  (Options const &options,
+                                                 Completion done)  const
+  {
+    return api_function<Endpoint::ASSETS> (*this, options,
+                                           Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::asset_pairs  ()  const
+  {  return asset_pairs (options_table);  }
+
+  string  Kraken_API::asset_pairs  (Options const &options)  const
+  {
+    return api_function<Endpoint::ASSET_PAIRS> (*this, options, Blocking {});
+  }
+
+  future<string>  Kraken_API::asset_pairs_async  (Completion done)  const
+  {  return asset_pairs_async (options_table, move (done));  }
+
+  future<string>  Kraken_API::asset_pairs_async  (Options const &options,
+                                                  Completion done)  const
+  {
+    return api_function<Endpoint::ASSET_PAIRS> (*this, options,
+                                                Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::ticker_info  (string const &pair)  const
+  {  return ticker_info (options_table, pair);  }
+
+  string  Kraken_API::ticker_info  (Options const &options,
+                                    string const &pair)  const
+  {
+    return api_function<Endpoint::TICKER> (*this, options, pair, Blocking {});
+  }
+
+  future<string>  Kraken_API::ticker_info_async  (string const &pair,
+                                                  Completion done)  const
+  {  return ticker_info_async (options_table, pair, move (done));  }
+
+  future<string>  Kraken_API::ticker_info_async  (Options const &options,
+                                                  string const &pair,
+                                                  Completion done)  const
+  {
+    return api_function<Endpoint::TICKER> (*this, options, pair,
+                                           Deferred {move (done)});
+  }
+
+
+
+  string  Kraken_API::ohlc_data  (string const &pair)  const
+  {  return ohlc_data (options_table, pair);  }
+
+  string  Kraken_API::ohlc_data  (Options const &options,
+                                  string const &pair)  const
+  {
+    return api_function<Endpoint::OHLC> (*this, options, pair, Blocking {});
+  }
+
+  future<string>  Kraken_API::ohlc_data_async  (string const &pair,
+                                                Completion done)  const
+  {  return ohlc_data_async (options_table, pair, move (done));  }
+
+  future<string>  Kraken_API::ohlc_data_async  (Options const &options,
+                                                string const &pair,
+                                                Completion done)  const
+  {
+    return api_function<Endpoint::OHLC> (*this, options, pair,
+                                         Deferred {move (done)});
+  }
+
+
+  void  Kraken_API::ohlc_data  (Options const &options,
+                                string const &pair,
+                                Sink const &sink)  const
+  {
+    api_function<Endpoint::OHLC> (*this, options, pair, Streamed {sink});
+  }
+
+
+
+  string  Kraken_API::order_book  (string const &pair)  const
+  {  return order_book (options_table, pair);  }
+
+  string  Kraken_API::order_book  (Options const &options,
+                                   string const &pair)  const
+  {
+    return api_function<Endpoint::DEPTH> (*this, options, pair, Blocking {});
+  }
+
+  future<string>  Kraken_API::order_book_async  (string const &pair,
+                                                 Completion done)  const
+  {  return order_book_async (options_table, pair, move (done));  }
+
+  future<string>  Kraken_API::order_book_async  (Options const &options,
+                                                 string const &pair,
+                                                 Completion done)  const
+  {
+    return api_function<Endpoint::DEPTH> (*this, options, pair,
+                                          Deferred {move (done)});
+  }
+
+
+  void  Kraken_API::order_book  (Options const &options,
+                                 string const &pair,
+                                 Sink const &sink)  const
+  {
+    api_function<Endpoint::DEPTH> (*this, options, pair, Streamed {sink});
+  }
+
+
+
+  string  Kraken_API::recent_trades  (string const &pair)  const
+  {  return recent_trades (options_table, pair);  }
+
+  string  Kraken_API::recent_trades  (Options const &options,
+                                      string const &pair)  const
+  {
+    return api_function<Endpoint::TRADES> (*this, options, pair, Blocking {});
+  }
+
+  future<string>  Kraken_API::recent_trades_async  (string const &pair,
+                                                    Completion done)  const
+  {  return recent_trades_async (options_table, pair, move (done));  }
+
+  future<string>  Kraken_API::recent_trades_async  (Options const &options,
+                                                    string const &pair,
+                                                    Completion done)  const
+  {
+    return api_function<Endpoint::TRADES> (*this, options, pair,
+                                           Deferred {move (done)});
+  }
+
+
+  void  Kraken_API::recent_trades  (Options const &options,
+                                    string const &pair,
+                                    Sink const &sink)  const
+  {
+    api_function<Endpoint::TRADES> (*this, options, pair, Streamed {sink});
+  }
+
+
+
+  string  Kraken_API::spread_data  (string const &pair)  const
+  {  return spread_data (options_table, pair);  }
+
+  string  Kraken_API::spread_data  (Options const &options,
+                                    string const &pair)  const
+  {
+    return api_function<Endpoint::SPREAD> (*this, options, pair, Blocking {});
+  }
+
+  future<string>  Kraken_API::spread_data_async  (string const &pair,
+                                                  Completion done)  const
+  {  return spread_data_async (options_table, pair, move (done));  }
+
+  future<string>  Kraken_API::spread_data_async  (Options const &options,
+                                                  string const &pair,
+                                                  Completion done)  const
+  {
+    return api_function<Endpoint::SPREAD> (*this, options, pair,
+                                           Deferred {move (done)});
+  }
+
+
+  void  Kraken_API::spread_data  (Options const &options,
+                                  string const &pair,
+                                  Sink const &sink)  const
+  {
+    api_function<Endpoint::SPREAD> (*this, options, pair, Streamed {sink});
+  }
 
 
 
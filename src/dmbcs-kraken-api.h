@@ -23,17 +23,603 @@
 #define DMBCS_KRAKEN_API__H
 
 
+#include <dmbcs-kraken-decimal.h>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <functional>
+#include <future>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 #include <curlpp/cURLpp.hpp>
 
 
+namespace  curlpp  {  class Easy;  }
+
+
 namespace  DMBCS  {
 
   
   using namespace std;
 
 
+
+  /*  A cache of libcurl easy handles, all attached to a single share
+   *  object so that DNS look-ups, TLS sessions and live (keep-alive or
+   *  HTTP/2) connections to the exchange outlive the individual requests
+   *  which made them.  A Kraken_API object holds a pointer to one of
+   *  these; many objects may hold the same one.  */
+
+  class  Connection_Pool
+  {
+  public:
+
+    struct  Statistics
+    {
+      uint64_t  requests            {0};
+      uint64_t  connections_opened  {0};
+      uint64_t  connections_reused  {0};
+      uint64_t  handles_created     {0};
+    };
+
+
+    /*  An easy handle on loan from the pool, returned to it when this
+     *  object goes out of scope.  */
+
+    class  Lease
+    {
+    public:
+      Lease  (Connection_Pool &P,  curlpp::Easy *E)  :  pool {&P},  easy {E}
+      {}
+
+      Lease  (Lease &&L)  :  pool {L.pool},  easy {L.easy}
+      {   L.easy  =  nullptr;   }
+
+      Lease  (Lease const &)  =  delete;
+      Lease &  operator=  (Lease const &)  =  delete;
+      Lease &  operator=  (Lease &&)  =  delete;
+
+      ~Lease  ()   {   if (easy)  pool->release (easy);   }
+
+      curlpp::Easy &  operator*   ()  const  {  return *easy;  }
+      curlpp::Easy *  operator->  ()  const  {  return  easy;  }
+
+    private:
+      Connection_Pool  *pool;
+      curlpp::Easy     *easy;
+    };
+
+
+    Connection_Pool  ();
+    ~Connection_Pool  ();
+
+    Connection_Pool  (Connection_Pool const &)  =  delete;
+    Connection_Pool &  operator=  (Connection_Pool const &)  =  delete;
+
+
+    /*  Get a handle which has been reset to default options, apart from
+     *  those which bind it to the pool's shared caches.  */
+    Lease  lease  ();
+
+    Statistics  statistics  ()  const;
+
+
+  private:
+
+    void  release  (curlpp::Easy *);
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Connection_Pool.  */
+
+
+
+  /*  The secret key with which private requests are signed, decoded and
+   *  loaded into an HMAC-SHA512 context once and for all.  Each thread
+   *  which signs with it keeps its own copy of that context, so signing
+   *  needs neither locks nor heap allocations.  */
+
+  class  Request_Signer
+  {
+  public:
+
+    /*  Base64 text of a 64-byte signature, plus a terminating NUL. */
+    using  Signature  =  array<char, 89>;
+
+
+    /*  Throws runtime_error if the secret is not the base64 encoding of a
+     *  64-byte key.  */
+    explicit  Request_Signer  (string const &secret);
+
+    ~Request_Signer  ();
+
+    Request_Signer  (Request_Signer const &)  =  delete;
+    Request_Signer &  operator=  (Request_Signer const &)  =  delete;
+
+
+    /*  Null, rather than an exception, if the secret is not valid. */
+    static  shared_ptr<Request_Signer const>  make  (string const &secret);
+
+
+    /*  The API-Sign value: base64 of the HMAC of the path followed by the
+     *  SHA-256 digest of the nonce followed by the post data.  */
+    void  sign  (string_view path,
+                 string_view nonce,
+                 string_view post_data,
+                 Signature &out)  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Request_Signer.  */
+
+
+
+  /*  Scratch memory for the text of a request (its query, URL and signed
+   *  path), so that making one need not go to the heap for it.  Each
+   *  thread has a block of its own from which the text is carved as the
+   *  request is made, and which is all given back at once when it is
+   *  done.  A request needing more than the block holds gets the rest
+   *  from the heap; statistics counts how often, which in the steady
+   *  state should be never.  */
+
+  class  Request_Arena
+  {
+  public:
+
+    static constexpr size_t  BLOCK_SIZE  =  16 * 1024;
+
+    using  String  =  pmr::string;
+
+    struct  Statistics
+    {
+      uint64_t  requests          {0};
+      uint64_t  heap_allocations  {0};
+
+      /*  The most of the block any request has used. */
+      size_t    high_water        {0};
+    };
+
+
+    /*  The calling threadʼs arena, and what it has seen. */
+    static  pmr::memory_resource  &resource  ();
+    static  Statistics  statistics  ();
+
+
+    /*  The making of one request on this thread: the arena is reset when
+     *  the outermost scope ends, after which nothing taken from it may be
+     *  used.  */
+    class  Scope
+    {
+    public:
+      Scope  ();
+      ~Scope  ();
+
+      Scope  (Scope const &)  =  delete;
+      Scope &  operator=  (Scope const &)  =  delete;
+    };
+
+  };  /*  End of class Request_Arena.  */
+
+
+
+  /*  An event loop, running in a thread of its own, which drives any
+   *  number of requests concurrently through a single libcurl multi
+   *  handle, multiplexing them over a few connections from a pool.  */
+
+  class  Request_Engine
+  {
+  public:
+
+    /*  Called on the engine's thread when a request finishes, with
+     *  either the body of the response or the reason for failure.
+     *  Anything it throws is dropped.  */
+    using  Completion  =  function<void (string const &, exception_ptr)>;
+
+
+    explicit Request_Engine  (shared_ptr<Connection_Pool> P,
+                              long max_host_connections  =  4);
+
+    /*  Stops the loop; requests still in flight complete with an
+     *  error.  */
+    ~Request_Engine  ();
+
+    Request_Engine  (Request_Engine const &)  =  delete;
+    Request_Engine &  operator=  (Request_Engine const &)  =  delete;
+
+
+    /*  Called on the engine's thread when a transfer has ended, before
+     *  the completion, while the handle can still be asked about it; as
+     *  with the completion, anything it throws is dropped.  */
+    using  Inspection  =  function<void (curlpp::Easy &)>;
+
+
+    /*  Take over a handle which has been fully set up apart from its
+     *  write function, and perform it on the engine's thread.  */
+    void  submit  (Connection_Pool::Lease &&request,
+                   Completion done,
+                   Inspection inspect  =  {});
+
+    /*  Call f on the engine's thread, between transfers; anything it
+     *  throws is dropped.  Whatever is still waiting when the engine is
+     *  destroyed is called by the destructor.  */
+    void  post  (function<void ()> f);
+
+    size_t  in_flight  ()  const;
+
+    Connection_Pool  &pool  ()  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Request_Engine.  */
+
+
+
+  /*  A model, on this side of the connection, of the counters Kraken keeps
+   *  against an account and an address.  Each private call adds its cost
+   *  to a counter which decays at a rate depending on the accountʼs
+   *  verification tier; a call which would take it over the limit is
+   *  held back until enough has decayed, or refused outright if that
+   *  would take longer than max_wait.
+
+   *  Trading calls (AddOrder, CancelOrder, ...) are not counted, so are
+   *  never held up, and the history queries, which cost two, may not use
+   *  the last HISTORY_RESERVE of the counter, leaving it for calls which
+   *  trading depends on.  Public calls are counted separately.
+
+   *  The counters are single atomic words: taking from them is a short
+   *  compare-and-swap loop, without locks.  */
+
+  class  Rate_Limiter
+  {
+  public:
+
+    enum  Tier  {  STARTER, INTERMEDIATE, PRO  };
+
+    enum  Priority  {  TRADING, NORMAL, HISTORY  };
+
+
+    /*  Thrown instead of making a call which could not be made within
+     *  max_wait.  */
+    struct  Exceeded  :  runtime_error
+    {
+      using  runtime_error::runtime_error;
+    };
+
+
+    static constexpr double  HISTORY_RESERVE  =  2.0;
+
+
+    explicit  Rate_Limiter  (Tier  =  STARTER,
+                             chrono::milliseconds max_wait
+                                      =  chrono::seconds {30});
+
+    Rate_Limiter  (double limit,
+                   double decay_per_second,
+                   chrono::milliseconds max_wait,
+                   double public_limit  =  15.0,
+                   double public_decay_per_second  =  1.0);
+
+    ~Rate_Limiter  ();
+
+    Rate_Limiter  (Rate_Limiter const &)  =  delete;
+    Rate_Limiter &  operator=  (Rate_Limiter const &)  =  delete;
+
+
+    /*  By the name of the API function, e.g. "Ledgers". */
+    static  Priority  priority  (string_view function);
+    static  double    cost      (string_view function);
+
+
+    /*  Block until the private function may be called; throws Exceeded. */
+    void  acquire  (string_view function);
+
+    /*  Take the cost if it is available now, else do nothing. */
+    bool  try_acquire  (string_view function);
+
+    void  acquire_public  ();
+
+    /*  For callers which must not block: take the cost and return zero if
+     *  it is available now, else take nothing and return how long to wait
+     *  before asking again.  Throws Exceeded if that wait, added to the
+     *  time already waited, would pass max_wait.  */
+    chrono::nanoseconds  retry_after  (string_view function,
+                                       chrono::nanoseconds waited  =  {});
+    chrono::nanoseconds  retry_after_public
+                                      (chrono::nanoseconds waited  =  {});
+
+
+    /*  How much more the counters could take right now. */
+    double  headroom  ()  const;
+    double  public_headroom  ()  const;
+
+
+    /*  Kraken has said the limit is exceeded: assume the counter is full.
+     */
+    void  saturate  ();
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Rate_Limiter.  */
+
+
+
+  /*  Every private request made with a key must carry a larger nonce than
+   *  the one before it.  Nonces are microseconds since the epoch, taken
+   *  from the system clock once and then advanced by the monotonic clock
+   *  (so that setting the system clock back does no harm), and in any
+   *  case one more than the last given out.
+
+   *  By default the last nonce is kept in memory, and shared by all the
+   *  objects in the process.  Given the name of a file, it is kept in
+   *  that file, mapped into memory, so that any number of processes on
+   *  the host may share a key (and its nonces survive restarts); they
+   *  should then all name the same file for it.  */
+
+  class  Nonce_Source
+  {
+  public:
+
+    /*  Big enough for the decimal text of any nonce, and a NUL. */
+    using  Text  =  array<char, 24>;
+
+
+    Nonce_Source  ();
+
+    /*  Throws runtime_error if the file cannot be created or mapped. */
+    explicit  Nonce_Source  (string const &path);
+
+    ~Nonce_Source  ();
+
+    Nonce_Source  (Nonce_Source const &)  =  delete;
+    Nonce_Source &  operator=  (Nonce_Source const &)  =  delete;
+
+
+    /*  The one every Kraken_API object uses unless told otherwise. */
+    static  shared_ptr<Nonce_Source>  process_wide  ();
+
+
+    uint64_t  next  ();
+
+    /*  The same, written as decimal text into the buffer. */
+    string_view  next  (Text &);
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Nonce_Source.  */
+
+
+
+  /*  Answers to public requests which change rarely (the asset and pair
+   *  tables above all), kept for a time set per API function and keyed by
+   *  the whole query, so function and options.  Concurrent requests for
+   *  the same thing wait for one fetch between them.  Where the server
+   *  gave an ETag or Last-Modified header, a stale answer is revalidated
+   *  rather than fetched again.  The contents may be saved to a file and
+   *  loaded from it when a program starts.  */
+
+  class  Response_Cache
+  {
+  public:
+
+    struct  Validators
+    {
+      string  etag;
+      string  last_modified;
+    };
+
+    struct  Fetched
+    {
+      string      body;
+      Validators  validators;
+
+      /*  The server said the body last fetched is still good. */
+      bool        not_modified  {false};
+    };
+
+    /*  Get the answer afresh, sending the validators, if any. */
+    using  Fetch  =  function<Fetched (Validators const &)>;
+
+
+    struct  Statistics
+    {
+      uint64_t  hits         {0};
+      uint64_t  misses       {0};
+      uint64_t  revalidated  {0};
+
+      /*  Requests which waited for another to fetch the same thing. */
+      uint64_t  coalesced    {0};
+    };
+
+
+    /*  An hour for Assets and AssetPairs; nothing else is kept until
+     *  given a time with set_ttl.  */
+    Response_Cache  ();
+
+    ~Response_Cache  ();
+
+    Response_Cache  (Response_Cache const &)  =  delete;
+    Response_Cache &  operator=  (Response_Cache const &)  =  delete;
+
+
+    /*  By name of API function, e.g. "Time"; zero stops caching it. */
+    void  set_ttl  (string const &function,  chrono::milliseconds);
+
+    /*  The answer to query, "function?arguments", fetching it if need
+     *  be.  Answers holding errors are passed on but not kept.  */
+    string  get  (string const &query,  Fetch const &);
+
+    void  clear  ();
+
+    Statistics  statistics  ()  const;
+
+
+    /*  Entries keep the time they were fetched, so that those loaded are
+     *  only fresh for what remains of their TTL; older ones are still
+     *  used for revalidation.  Both throw runtime_error on failure.  */
+    void  save  (string const &path)  const;
+    void  load  (string const &path);
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Response_Cache.  */
+
+
+
+  /*  Counts and timings of the requests made through the Kraken_API
+   *  objects which hold one of these, by API function: histograms of the
+   *  phases of each transfer as libcurl measured them and of the time
+   *  taken signing requests and parsing replies, the bytes sent and
+   *  received, retries, transport failures and the error codes Kraken
+   *  returned.  Every figure is a relaxed atomic counter in a table
+   *  allocated up front, so recording takes no locks; an object without
+   *  one (the default) pays only for the test of a null pointer.  */
+
+  class  Request_Metrics
+  {
+  public:
+
+    enum  Phase
+      {
+        NAME_LOOKUP, CONNECT, TLS, FIRST_BYTE, TOTAL, SIGNING, PARSING,
+        __PHASES
+      };
+
+
+    /*  One finished transfer.  The look-up, connect and TLS times only
+     *  count where a new connection was made for it.  */
+    struct  Transfer
+    {
+      chrono::nanoseconds  name_lookup  {0};
+      chrono::nanoseconds  connect      {0};
+      chrono::nanoseconds  tls          {0};
+      chrono::nanoseconds  first_byte   {0};
+      chrono::nanoseconds  total        {0};
+      uint64_t             sent         {0};
+      uint64_t             received     {0};
+      bool                 new_connection  {false};
+    };
+
+
+    /*  Upper bounds of the histogram buckets, in microseconds; there is
+     *  a last, unbounded, one after these.  */
+    static constexpr array<uint32_t, 17>  BUCKETS
+      {{50, 100, 250, 500, 1'000, 2'500, 5'000, 10'000, 25'000, 50'000,
+        100'000, 250'000, 500'000, 1'000'000, 2'500'000, 5'000'000,
+        10'000'000}};
+
+
+    struct  Histogram
+    {
+      array<uint64_t, BUCKETS.size () + 1>  counts  {};
+      uint64_t                             count   {0};
+      chrono::nanoseconds                  sum     {0};
+    };
+
+
+    Request_Metrics  ();
+    ~Request_Metrics  ();
+
+    Request_Metrics  (Request_Metrics const &)  =  delete;
+    Request_Metrics &  operator=  (Request_Metrics const &)  =  delete;
+
+
+    /*  The function is the name of the API function, e.g. "Ticker"; any
+     *  the library does not know are counted together as "other".  */
+
+    void  record  (string_view function,  Transfer const &);
+    void  record  (string_view function,  Phase,  chrono::nanoseconds);
+    void  record_retry    (string_view function);
+    void  record_failure  (string_view function);
+
+    /*  Count the codes in the error array of a reply, if it has any. */
+    void  record_errors   (string_view function,  string_view reply);
+
+
+    Histogram  histogram  (string_view function,  Phase)  const;
+    uint64_t   errors     (string_view function,  string_view code)  const;
+
+
+    /*  Everything recorded so far, in the Prometheus text exposition
+     *  format; functions never called are left out.  */
+    string  prometheus  ()  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Request_Metrics.  */
+
+
+
+  /*  How long requests may take, and what is done when they fail.
+
+   *  A request may take connect_timeout to make a connection, and
+   *  timeout in all, retries included.  A public request which fails in
+   *  transport, or gets a server error or one of the transient_errors
+   *  from Kraken, is made again, up to attempts times in all, after a
+   *  random delay of up to backoff, doubling with each retry up to
+   *  max_backoff.  A private request is only made again if it failed
+   *  before any of it was sent, so that nothing is ever done twice;
+   *  whatever Kraken answers to one is passed back as it is.
+
+   *  For the public functions named in hedged (e.g. "Ticker"), if the
+   *  answer has not come within the 95th percentile of that functionʼs
+   *  times in the objectʼs metrics (or within hedge_after, until there
+   *  are enough of those), the same request is sent on another
+   *  connection and the first answer to arrive is taken.  The second
+   *  request is only sent if the rate limiter has room for it.  */
+
+  struct  Request_Policy
+  {
+    chrono::milliseconds  connect_timeout   {chrono::seconds {5}};
+    chrono::milliseconds  timeout           {chrono::seconds {30}};
+
+    unsigned              attempts          {3};
+    chrono::milliseconds  backoff           {200};
+    chrono::milliseconds  max_backoff       {chrono::seconds {5}};
+
+    vector<string>        transient_errors  {"EService:Unavailable",
+                                             "EService:Busy",
+                                             "EGeneral:Temporary lockout",
+                                             "EGeneral:Too many requests"};
+
+    vector<string>        hedged            {};
+    chrono::milliseconds  hedge_after       {250};
+  };
+
+
+
   struct Kraken_API
   {
     enum  Option
@@ -60,13 +646,78 @@ namespace  DMBCS  {
       };
 
 
-    Kraken_API  (string const &K,  string const &S)  :  key {K},  secret {S}
+    /*  The option values which go with a single call.  An object of this
+     *  type may be passed as the first argument to any of the functions
+     *  below; otherwise the objectʼs own options_table, as set with
+     *  set_opt, is used.  */
+
+    struct  Options
+    {
+      template <typename T>
+      Options &  set  (Option const &opt, T const &val);
+
+      Options &  clear  (Option const &opt);
+
+      string const &  operator[]  (Option const &opt)  const
+      {   return table [opt];   }
+
+      array<string, Option::__CEILING>  table;
+    };
+
+
+
+    /*  An order, for add_order and add_orders.  The prices are exact
+     *  decimal text (as Decimal::str makes), and are needed or not
+     *  according to the order type, as with the variadic add_order.  Of
+     *  the options, those which add_order takes apply to this order
+     *  alone.  */
+
+    struct  Order
+    {
+      Instruction  instruction;
+      Order_Type   order_type;
+      string       pair;
+      string       volume;
+      string       price   {};
+      string       price2  {};
+      Options      options {};
+    };
+
+
+    /*  What became of one order of a batch: either the transaction ID
+     *  and Krakenʼs description of the order, or the error.  */
+
+    struct  Order_Result
+    {
+      string  txid;
+      string  description;
+      string  error;
+    };
+
+
+    /*  A null rate limiter lets every call straight through. */
+    Kraken_API  (string const &K,  string const &S,
+                 shared_ptr<Connection_Pool> P
+                          =  make_shared<Connection_Pool> (),
+                 shared_ptr<Rate_Limiter> L
+                          =  make_shared<Rate_Limiter> ())
+      :  key {K},  secret {S},  signer {Request_Signer::make (S)},
+         connection_pool {move (P)},  rate_limiter {move (L)}
     {}
 
     Kraken_API  (Kraken_API const &K)  =  delete;
     
     Kraken_API  (Kraken_API &&K) : key {move (K.key)},
                                    secret {move (K.secret)},
+                                   signer {move (K.signer)},
+                                   url_base {move (K.url_base)},
+                                   nonce_source {move (K.nonce_source)},
+                                   connection_pool {move (K.connection_pool)},
+                                   rate_limiter {move (K.rate_limiter)},
+                                   response_cache {move (K.response_cache)},
+                                   metrics {move (K.metrics)},
+                                   policy {move (K.policy)},
+                                   request_engine {move (K.request_engine)},
                                    options_table {move (K.options_table)}
     {}
 
@@ -83,42 +734,271 @@ namespace  DMBCS  {
     void  clear_opt  (Option const  &opt);
 
 
+    /*  Point the object at another server, e.g. a local stand-in for
+     *  testing.  The URL must include the version path, as in
+     *  default_url_base.  */
+    void  set_url_base  (string U)   {   url_base  =  move (U);   }
+
+    /*  Use, for instance, a file-backed source shared with other processes
+     *  using the same key.  */
+    void  set_nonce_source  (shared_ptr<Nonce_Source> N)
+    {   nonce_source  =  move (N);   }
+
+    /*  Null, the default, for no caching of public requests. */
+    void  set_response_cache  (shared_ptr<Response_Cache> C)
+    {   response_cache  =  move (C);   }
+
+    /*  Null, the default, for no measurements. */
+    void  set_metrics  (shared_ptr<Request_Metrics> M)
+    {   metrics  =  move (M);   }
+
+    void  set_policy  (Request_Policy P)   {   policy  =  move (P);   }
+
+
+    /* All the functions below may be called concurrently from any number
+       of threads, provided that those which take no Options argument are
+       not called while set_opt, clear_opt or one of the set_ functions
+       is. */
+
+
     /* Trading functions. */
 
     string add_order   (Instruction const &instruction,
                         Order_Type const &order,
                         string const &asset,
                         string const &volume,
-                        ...);
+                        ...)  const;
     
-    string cancel_order    (string const &txid);
+    string add_order   (Options const &options,
+                        Instruction const &instruction,
+                        Order_Type const &order,
+                        string const &asset,
+                        string const &volume,
+                        ...)  const;
+
+    /*  These are chosen over the above whenever prices are given. */
+    string add_order   (Instruction const &instruction,
+                        Order_Type const &order,
+                        string const &asset,
+                        string const &volume,
+                        string const &price,
+                        string const &price2  =  {})  const;
+
+    string add_order   (Options const &options,
+                        Instruction const &instruction,
+                        Order_Type const &order,
+                        string const &asset,
+                        string const &volume,
+                        string const &price,
+                        string const &price2  =  {})  const;
+
+    /*  The same, with the volume and prices as exact decimals, which are
+     *  best at the pairʼs scales (see Asset_Pairs).  */
+    string add_order   (Instruction const &instruction,
+                        Order_Type const &order,
+                        string const &asset,
+                        Decimal const &volume,
+                        optional<Decimal> const &price   =  {},
+                        optional<Decimal> const &price2  =  {})  const;
+
+    string add_order   (Options const &options,
+                        Instruction const &instruction,
+                        Order_Type const &order,
+                        string const &asset,
+                        Decimal const &volume,
+                        optional<Decimal> const &price   =  {},
+                        optional<Decimal> const &price2  =  {})  const;
+
+    string add_order   (Order const &)  const;
+    
+    string cancel_order    (string const &txid)  const;
+    string cancel_order    (Options const &,  string const &txid)  const;
+
+    string cancel_all      ()  const;
+
+
+    /*  Place many orders at once, returning what became of each, in the
+     *  same order.  Orders for the same pair go fifteen at a time in
+     *  AddOrderBatch requests; each request is signed and sent as soon as
+     *  the reply to the one before it is in, so that their nonces reach
+     *  Kraken in order.  */
+    vector<Order_Result>  add_orders  (vector<Order> const &)  const;
+
+    /*  Cancel many orders, fifty at a time with CancelOrderBatch, in the
+     *  same way; returns the number cancelled.  A failed request does
+     *  not stop the others: once all are done this throws
+     *  Cancel_Orders_Error (dmbcs-kraken-market.h), with the count and
+     *  the txids of the failed requests, if any failed.  */
+    size_t  cancel_orders  (vector<string> const &txids)  const;
 
 
     /* User account inquiry functions.  */
 
-    string account_balance      (                  );
-    string trade_balance        (                  );
-    string open_orders          (                  );
-    string closed_orders        (                  );
-    string query_orders         (string const &txid);
-    string trades_history       (                  );
-    string trades_info          (string const &txid);
-    string open_positions       (string const &txid);
-    string ledgers_info         (                  );
-    string query_ledgers        (string const &txid);
-    string trade_volume         (                  );
+    string account_balance      (                  )  const;
+    string trade_balance        (                  )  const;
+    string open_orders          (                  )  const;
+    string closed_orders        (                  )  const;
+    string query_orders         (string const &txid)  const;
+    string trades_history       (                  )  const;
+    string trades_info          (string const &txid)  const;
+    string open_positions       (string const &txid)  const;
+    string ledgers_info         (                  )  const;
+    string query_ledgers        (string const &txid)  const;
+    string trade_volume         (                  )  const;
+
+    string account_balance      (Options const &                    )  const;
+    string trade_balance        (Options const &                    )  const;
+    string open_orders          (Options const &                    )  const;
+    string closed_orders        (Options const &                    )  const;
+    string query_orders         (Options const &, string const &txid)  const;
+    string trades_history       (Options const &                    )  const;
+    string trades_info          (Options const &, string const &txid)  const;
+    string open_positions       (Options const &, string const &txid)  const;
+    string ledgers_info         (Options const &                    )  const;
+    string query_ledgers        (Options const &, string const &txid)  const;
+    string trade_volume         (Options const &                    )  const;
 
 
     /* Exchange inquiry functions. */
 
-    string server_time          (                  );
-    string asset_info           (                  );
-    string asset_pairs          (                  );
-    string ticker_info          (string const &pair);
-    string ohlc_data            (string const &pair);
-    string order_book           (string const &pair);
-    string recent_trades        (string const &pair);
-    string spread_data          (string const &pair);
+    string server_time          (                  )  const;
+    string asset_info           (                  )  const;
+    string asset_pairs          (                  )  const;
+    string ticker_info          (string const &pair)  const;
+    string ohlc_data            (string const &pair)  const;
+    string order_book           (string const &pair)  const;
+    string recent_trades        (string const &pair)  const;
+    string spread_data          (string const &pair)  const;
+
+    string server_time          (Options const &                    )  const;
+    string asset_info           (Options const &                    )  const;
+    string asset_pairs          (Options const &                    )  const;
+    string ticker_info          (Options const &, string const &pair)  const;
+    string ohlc_data            (Options const &, string const &pair)  const;
+    string order_book           (Options const &, string const &pair)  const;
+    string recent_trades        (Options const &, string const &pair)  const;
+    string spread_data          (Options const &, string const &pair)  const;
+
+
+    /* Streaming forms of the biggest of the above: the reply is handed to
+       the sink a piece at a time as it arrives, rather than collected
+       into a string, so that memory use does not grow with it.  They do
+       not use the response cache, and are only tried again if nothing
+       has yet reached the sink.  */
+
+    using  Sink  =  function<void (string_view)>;
+
+    void   ohlc_data            (Options const &, string const &pair,
+                                 Sink const &)  const;
+    void   order_book           (Options const &, string const &pair,
+                                 Sink const &)  const;
+    void   recent_trades        (Options const &, string const &pair,
+                                 Sink const &)  const;
+    void   spread_data          (Options const &, string const &pair,
+                                 Sink const &)  const;
+
+
+    /* Asynchronous counterparts of the above.  These return as soon as
+       the request is handed to the request engine; the result is
+       delivered through the future and, if given, to the completion
+       function on the engine's thread.  Options are read at the time of
+       the call.  */
+
+    using  Completion  =  Request_Engine::Completion;
+
+    future<string>  cancel_order_async    (string const &txid,
+                                           Completion = {})  const;
+    future<string>  add_order_async       (Order const &,
+                                           Completion = {})  const;
+
+    future<string>  account_balance_async (Completion = {})  const;
+    future<string>  trade_balance_async   (Completion = {})  const;
+    future<string>  open_orders_async     (Completion = {})  const;
+    future<string>  closed_orders_async   (Completion = {})  const;
+    future<string>  query_orders_async    (string const &txid,
+                                           Completion = {})  const;
+    future<string>  trades_history_async  (Completion = {})  const;
+    future<string>  trades_info_async     (string const &txid,
+                                           Completion = {})  const;
+    future<string>  open_positions_async  (string const &txid,
+                                           Completion = {})  const;
+    future<string>  ledgers_info_async    (Completion = {})  const;
+    future<string>  query_ledgers_async   (string const &id,
+                                           Completion = {})  const;
+    future<string>  trade_volume_async    (Completion = {})  const;
+
+    future<string>  server_time_async     (Completion = {})  const;
+    future<string>  asset_info_async      (Completion = {})  const;
+    future<string>  asset_pairs_async     (Completion = {})  const;
+    future<string>  ticker_info_async     (string const &pair,
+                                           Completion = {})  const;
+    future<string>  ohlc_data_async       (string const &pair,
+                                           Completion = {})  const;
+    future<string>  order_book_async      (string const &pair,
+                                           Completion = {})  const;
+    future<string>  recent_trades_async   (string const &pair,
+                                           Completion = {})  const;
+    future<string>  spread_data_async     (string const &pair,
+                                           Completion = {})  const;
+
+    future<string>  cancel_order_async    (Options const &,
+                                           string const &txid,
+                                           Completion = {})  const;
+
+    future<string>  account_balance_async (Options const &,
+                                           Completion = {})  const;
+    future<string>  trade_balance_async   (Options const &,
+                                           Completion = {})  const;
+    future<string>  open_orders_async     (Options const &,
+                                           Completion = {})  const;
+    future<string>  closed_orders_async   (Options const &,
+                                           Completion = {})  const;
+    future<string>  query_orders_async    (Options const &,
+                                           string const &txid,
+                                           Completion = {})  const;
+    future<string>  trades_history_async  (Options const &,
+                                           Completion = {})  const;
+    future<string>  trades_info_async     (Options const &,
+                                           string const &txid,
+                                           Completion = {})  const;
+    future<string>  open_positions_async  (Options const &,
+                                           string const &txid,
+                                           Completion = {})  const;
+    future<string>  ledgers_info_async    (Options const &,
+                                           Completion = {})  const;
+    future<string>  query_ledgers_async   (Options const &,
+                                           string const &id,
+                                           Completion = {})  const;
+    future<string>  trade_volume_async    (Options const &,
+                                           Completion = {})  const;
+
+    future<string>  server_time_async     (Options const &,
+                                           Completion = {})  const;
+    future<string>  asset_info_async      (Options const &,
+                                           Completion = {})  const;
+    future<string>  asset_pairs_async     (Options const &,
+                                           Completion = {})  const;
+    future<string>  ticker_info_async     (Options const &,
+                                           string const &pair,
+                                           Completion = {})  const;
+    future<string>  ohlc_data_async       (Options const &,
+                                           string const &pair,
+                                           Completion = {})  const;
+    future<string>  order_book_async      (Options const &,
+                                           string const &pair,
+                                           Completion = {})  const;
+    future<string>  recent_trades_async   (Options const &,
+                                           string const &pair,
+                                           Completion = {})  const;
+    future<string>  spread_data_async     (Options const &,
+                                           string const &pair,
+                                           Completion = {})  const;
+
+
+    /* Transport introspection. */
+
+    Connection_Pool::Statistics  connection_statistics  ()  const
+    {   return connection_pool->statistics ();   }
 
 
     /******* Private stuff below here. ******************/
@@ -127,38 +1007,99 @@ namespace  DMBCS  {
 
     string const key;
     string const secret;
-    static constexpr char const *const  url_base  {"https://api.kraken.com/0/"};
 
-    string query_url;
-    string query_result;
+    /*  Null if the secret is not a valid key, in which case any private
+     *  call will fail.  */
+    shared_ptr<Request_Signer const>  signer;
+
+    static constexpr char const *const  default_url_base
+                                            {"https://api.kraken.com/0/"};
+
+    string  url_base  {default_url_base};
+
+    shared_ptr<Nonce_Source>  nonce_source  {Nonce_Source::process_wide ()};
+
+    shared_ptr<Connection_Pool>  connection_pool;
+
+    /*  May be shared by several objects using the same key. */
+    shared_ptr<Rate_Limiter>  rate_limiter;
+
+    /*  Consulted by the synchronous public calls. */
+    shared_ptr<Response_Cache>  response_cache;
+
+    /*  May be shared by several objects, to see them all together. */
+    shared_ptr<Request_Metrics>  metrics;
+
+    Request_Policy  policy;
 
-    array<string, Option::__CEILING>  options_table;
+    /*  Created on first asynchronous call; may be set beforehand to share
+     *  one event loop between several objects.  */
+    mutable shared_ptr<Request_Engine>  request_engine;
+
+    Options  options_table;
 
 
   };  /*  End of class Kraken_API. */
 
 
 
-  template <>
-  inline  void  Kraken_API::set_opt  (Kraken_API::Option const &opt, 
-                                      string const &val)
-  {   options_table [opt]  =  val;   }
+  /*  Strings are taken as they are, numbers are formatted with to_chars
+   *  (so independently of locale, and floating-point values with as many
+   *  digits as they need to be read back exactly), Decimals with all
+   *  their places, and anything else is given to an ostream.  */
+
+  template <typename T>
+  inline  Kraken_API::Options &
+  Kraken_API::Options::set  (Kraken_API::Option const &opt,  T const &val)
+  {
+    if constexpr (is_convertible_v<T const &, string_view>)
+      table [opt]  =  val;
+
+    else if constexpr (is_same_v<T, bool>)
+      table [opt]  =  val ? "1" : "0";
+
+    else if constexpr (is_arithmetic_v<T>  &&  sizeof (T) > 1)
+      {
+        auto  buffer  =  array<char, 64> {};
+        auto const  end  =  to_chars (buffer.data (),
+                                      buffer.data () + buffer.size (),
+                                      val).ptr;
+        table [opt].assign (buffer.data (), end);
+      }
+
+    else if constexpr (is_same_v<T, Decimal>)
+      {
+        auto  buffer  =  Decimal::Text {};
+        table [opt]  =  val.write (buffer);
+      }
+
+    else
+      {
+        auto  O  =  ostringstream {};
+        O  <<  val;
+        table [opt]  =  O.str ();
+      }
+
+    return *this;
+  }
+
+
+
+  inline  Kraken_API::Options &
+  Kraken_API::Options::clear  (Option const  &opt)
+  {   table [opt].clear ();   return *this;   }
 
 
 
   template <typename T>
   inline  void  Kraken_API::set_opt  (Kraken_API::Option const &opt,
                                       T const &val)
-  {
-    auto  O  =  ostringstream {};
-    O  <<  val;
-    set_opt  (opt,  O.str ());
-  }
+  {   options_table.set  (opt,  val);   }
 
 
 
   inline  void  Kraken_API::clear_opt  (Option const  &opt)
-  {   set_opt  (opt,  string {});   }
+  {   options_table.clear  (opt);   }
 
     
 }  /* End of namespace DMBCS. */
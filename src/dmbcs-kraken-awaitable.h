@@ -0,0 +1,294 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_AWAITABLE__H
+#define DMBCS_KRAKEN_AWAITABLE__H
+
+
+/*  A C++20 face on the request engine: each API function as something a
+ *  coroutine can co_await, with cancellation and timeouts.  This header,
+ *  and the library it comes with, are only built on request; the rest
+ *  of the library stays C++17.  */
+
+
+#if __cplusplus < 202002L
+#error "dmbcs-kraken-awaitable.h needs C++20"
+#endif
+
+
+#include <dmbcs-kraken-endpoints.h>
+#include <chrono>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <stop_token>
+#include <string>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  /*  What an awaited request throws when its stop token is triggered, or
+   *  when its time runs out, before the reply comes.  */
+
+  class  Request_Cancelled  :  public runtime_error
+  {
+  public:
+    Request_Cancelled  ()  :  runtime_error {"request cancelled"}  {}
+  };
+
+  class  Request_Timed_Out  :  public runtime_error
+  {
+  public:
+    Request_Timed_Out  ()  :  runtime_error {"request timed out"}  {}
+  };
+
+
+
+  /*  Given the handle of a suspended coroutine, arrange for it to be
+   *  resumed, e.g. by posting it to a thread pool or an event loop.  */
+  using  Executor  =  function<void (coroutine_handle<>)>;
+
+
+
+  /*  The part of an awaited request which does not depend on the type
+   *  of its result.  The request is not sent until it is awaited, and
+   *  it finishes at most once: with the reply, the reason for failure,
+   *  cancellation or the timeout, whichever comes first.  */
+
+  class  Pending_Request
+  {
+  public:
+
+    using  Start  =  function<void (Kraken_API::Completion)>;
+
+    /*  What the request takes from the rate limiter, if there is one,
+     *  before it is started.  When there is no room the request waits on
+     *  a timer, not on the awaiting thread.  */
+    struct  Limit
+    {
+      shared_ptr<Rate_Limiter>  limiter;
+      char const               *function    {nullptr};
+      bool                      is_private  {false};
+    };
+
+    /*  K gives the thread the coroutine is resumed on when there is no
+     *  executor. */
+    Pending_Request  (Kraken_API const &K,
+                      Start,
+                      Limit,
+                      Executor const &,
+                      chrono::milliseconds timeout,
+                      stop_token);
+
+    bool    suspend  (coroutine_handle<>);
+    string  result   ();
+
+
+  private:
+
+    struct  State;
+
+    struct  Stopper
+    {
+      shared_ptr<State>  state;
+      void  operator()  ()  const  noexcept;
+    };
+
+    shared_ptr<State>                     state;
+    stop_token                            stop;
+    unique_ptr<stop_callback<Stopper>>    on_stop;
+
+  };  /*  End of class Pending_Request.  */
+
+
+
+  /*  The thing co_awaited: the reply to one request, as text or parsed
+   *  into T.  */
+
+  template <typename T>
+  class  Reply
+  {
+  public:
+
+    using  Parse  =  T (*) (string const &);
+
+    Reply  (Pending_Request P,  Parse p)
+      :  pending {move (P)},  parse {p}
+    {}
+
+    bool  await_ready  ()  const  noexcept   {   return false;   }
+
+    bool  await_suspend  (coroutine_handle<> h)
+    {   return pending.suspend (h);   }
+
+    T  await_resume  ()   {   return parse (pending.result ());   }
+
+
+  private:
+
+    Pending_Request  pending;
+    Parse            parse;
+
+  };  /*  End of class Reply.  */
+
+
+
+  /*  The functions of a Kraken_API object, which must outlive this and
+   *  anything it has in flight, as awaitables.  The requests go through
+   *  the objectʼs request engine, rate limiter and metrics just as the
+   *  _async functions do, with the objectʼs own options.
+
+   *  The awaiting coroutine is resumed by the executor if there is one,
+   *  otherwise on the request engineʼs thread, where it must not block;
+   *  a timeout or stop request, which fire on other threads, hand it
+   *  over to the engine then too.  A request which fails before the
+   *  coroutine has been suspended lets it carry straight on.
+   *  A non-zero timeout, or the stop token, finishes the wait early with
+   *  Request_Timed_Out or Request_Cancelled; the request itself then runs
+   *  on (within the objectʼs policy timeout) and its reply is dropped.  */
+
+  class  Awaitable_API
+  {
+  public:
+
+    explicit  Awaitable_API  (Kraken_API const &K,
+                              Executor E  =  {},
+                              chrono::milliseconds timeout
+                                    =  chrono::milliseconds {0})
+      :  api {&K},  executor {move (E)},  timeout {timeout}
+    {}
+
+    /*  The same, with a different timeout. */
+    Awaitable_API  with_timeout  (chrono::milliseconds T)  const
+    {   return  Awaitable_API {*api, executor, T};   }
+
+
+    Reply<string>  server_time     (stop_token = {})  const;
+    Reply<string>  asset_info      (stop_token = {})  const;
+    Reply<string>  asset_pairs     (stop_token = {})  const;
+    Reply<string>  ticker_info     (string const &pair,
+                                    stop_token = {})  const;
+    Reply<string>  ohlc_data       (string const &pair,
+                                    stop_token = {})  const;
+    Reply<string>  order_book      (string const &pair,
+                                    stop_token = {})  const;
+    Reply<string>  recent_trades   (string const &pair,
+                                    stop_token = {})  const;
+    Reply<string>  spread_data     (string const &pair,
+                                    stop_token = {})  const;
+
+    Reply<string>  account_balance (stop_token = {})  const;
+    Reply<string>  trade_balance   (stop_token = {})  const;
+    Reply<string>  open_orders     (stop_token = {})  const;
+    Reply<string>  closed_orders   (stop_token = {})  const;
+    Reply<string>  query_orders    (string const &txid,
+                                    stop_token = {})  const;
+    Reply<string>  trades_history  (stop_token = {})  const;
+    Reply<string>  trades_info     (string const &txid,
+                                    stop_token = {})  const;
+    Reply<string>  open_positions  (string const &txid,
+                                    stop_token = {})  const;
+    Reply<string>  ledgers_info    (stop_token = {})  const;
+    Reply<string>  query_ledgers   (string const &id,
+                                    stop_token = {})  const;
+    Reply<string>  trade_volume    (stop_token = {})  const;
+
+    Reply<string>  add_order       (Kraken_API::Order const &,
+                                    stop_token = {})  const;
+    Reply<string>  cancel_order    (string const &txid,
+                                    stop_token = {})  const;
+    Reply<string>  cancel_all      (stop_token = {})  const;
+
+
+    /*  Any endpoint with options of its own, its reply parsed as the
+     *  Endpoint_Result (see dmbcs-kraken-endpoints.h).  */
+
+    template <Endpoint E>
+    Reply<typename Endpoint_Result<E>::type>
+    fetch  (Endpoint_Options<E> const &O  =  {},
+            stop_token S  =  {})  const
+    {
+      static_assert (! describe (E).argument,
+                     "the endpoint needs its argument");
+      return  reply<E> ([&K = *api,  values = O.values ()]
+                            (Kraken_API::Completion done)
+                            {  endpoint_submit<E> (K, values, nullptr,
+                                                   move (done));  },
+                        move (S));
+    }
+
+    template <Endpoint E>
+    Reply<typename Endpoint_Result<E>::type>
+    fetch  (Endpoint_Options<E> const &O,
+            string const &argument,
+            stop_token S  =  {})  const
+    {
+      static_assert (describe (E).argument,
+                     "the endpoint takes no argument");
+      return  reply<E> ([&K = *api,  values = O.values (),  argument]
+                            (Kraken_API::Completion done)
+                            {  endpoint_submit<E> (K, values, &argument,
+                                                   move (done));  },
+                        move (S));
+    }
+
+
+  private:
+
+    template <Endpoint E>
+    Reply<typename Endpoint_Result<E>::type>
+    reply  (Pending_Request::Start start,  stop_token S)  const
+    {
+      return  {Pending_Request {*api, move (start), limit<E> (),
+                                executor, timeout, move (S)},
+               [] (string const &json)
+                  {  return Endpoint_Result<E>::parse (json);  }};
+    }
+
+    template <Endpoint E>
+    Pending_Request::Limit  limit  ()  const
+    {
+      return  {api->rate_limiter,  describe (E).path,
+               describe (E).is_private};
+    }
+
+    Reply<string>  text  (Pending_Request::Start,
+                          Pending_Request::Limit,
+                          stop_token)  const;
+
+    template <Endpoint E>
+    Reply<string>  text  (string const *argument,  stop_token)  const;
+
+    Kraken_API const     *api;
+    Executor              executor;
+    chrono::milliseconds  timeout;
+
+  };  /*  End of class Awaitable_API.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_AWAITABLE__H.  */
@@ -0,0 +1,129 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_BOOK__H
+#define DMBCS_KRAKEN_BOOK__H
+
+
+/*  A local copy of the top of an order book, kept up to date from the
+ *  book channel of the WebSocket feed and checked against Krakenʼs
+ *  checksum after every update.  */
+
+
+#include <dmbcs-kraken-api.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  /*  Prices and volumes are held as integers, being the decimal values
+   *  Kraken sends with the point removed; the number of decimal places,
+   *  which is fixed for each pair, is learnt from the first snapshot.
+
+   *  Each side is a sorted array, best price first, of at most the
+   *  subscribed depth, allocated once when the object is made.  Any number
+   *  of threads may read the book while one writes to it: readers never
+   *  wait for the writer, but repeat their reading if it changed
+   *  underneath them.  */
+
+  class  Local_Order_Book
+  {
+  public:
+
+    enum  Side  {  BID, ASK  };
+
+
+    struct  Level
+    {
+      int64_t  price   {0};
+      int64_t  volume  {0};
+    };
+
+
+    /*  The pair is named as the REST interface names it (e.g.
+     *  "XXBTZUSD"), as it is used to fetch a snapshot, as
+     *  Kraken_API::order_book does, whenever the book fails its
+     *  checksum.  The
+     *  depth must be that subscribed to on the feed.  */
+    Local_Order_Book  (Kraken_API const &K,
+                       string rest_pair,
+                       size_t depth);
+
+    ~Local_Order_Book  ();
+
+    Local_Order_Book  (Local_Order_Book const &)  =  delete;
+    Local_Order_Book &  operator=  (Local_Order_Book const &)  =  delete;
+
+
+    /*  Give this every message from the feedʼs book channel for the pair,
+     *  snapshot or update.  */
+    void  apply  (string_view message);
+
+    /*  Replace the whole book with the result of Kraken_API::order_book;
+     *  done automatically when the checksum fails.  */
+    void  load_depth  (string_view json);
+
+
+    /*  False until the first snapshot, and while re-synchronizing. */
+    bool  synchronized  ()  const;
+
+    /*  Both false if the book is empty. */
+    bool  best  (Level &bid,  Level &ask)  const;
+
+    /*  Copy up to n of the best levels on one side, returning how many. */
+    size_t  levels  (Side,  Level *out,  size_t n)  const;
+
+    /*  Zero if there is no level at the price. */
+    int64_t  volume_at  (Side,  int64_t price)  const;
+
+
+    int  price_decimals   ()  const;
+    int  volume_decimals  ()  const;
+
+    double  to_price   (int64_t p)  const;
+    double  to_volume  (int64_t v)  const;
+
+
+    /*  Changes each time the book does. */
+    uint64_t  version  ()  const;
+
+    uint64_t  checksum_failures  ()  const;
+
+
+  private:
+
+    struct  Implementation;
+    shared_ptr<Implementation>  implementation;
+
+  };  /*  End of class Local_Order_Book.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_BOOK__H.  */
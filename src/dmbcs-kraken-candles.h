@@ -0,0 +1,130 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_CANDLES__H
+#define DMBCS_KRAKEN_CANDLES__H
+
+
+/*  OHLC candles for many pairs and several intervals, kept up to date by
+ *  fetching only the bars each pair has not yet had.  */
+
+
+#include <dmbcs-kraken-market.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  /*  Only the finest interval is fetched from Kraken: the bars of the
+   *  others, which must be multiples of it, are built from those as they
+   *  arrive, each covering a multiple of its interval since the Unix
+   *  epoch.  The last bar of every interval is the one still forming, and
+   *  is replaced until a later one starts.
+
+   *  Each pairʼs bars live in one block of memory allocated when the store
+   *  is made, divided into a ring per interval holding the newest
+   *  capacity bars.  */
+
+  class  Candle_Store
+  {
+  public:
+
+    /*  The bars of one pair at one interval, oldest first, as they lie in
+     *  the ring: the first part, then the wrapped-around second.  */
+    struct  Bars
+    {
+      OHLC_Bar const *  first         {nullptr};
+      size_t            first_size    {0};
+      OHLC_Bar const *  second        {nullptr};
+      size_t            second_size   {0};
+
+      size_t  size  ()  const   {   return first_size + second_size;   }
+      bool    empty  ()  const  {   return size () == 0;   }
+
+      OHLC_Bar const &  operator[]  (size_t const i)  const
+      {   return  i < first_size  ?  first [i]  :  second [i - first_size]; }
+
+      OHLC_Bar const &  back  ()  const   {   return (*this) [size () - 1]; }
+    };
+
+
+    /*  The pairs are named as they are to be requested; the intervals are
+     *  in minutes, the first being one Kraken offers.  Throws
+     *  invalid_argument if the intervals are unusable.  */
+    Candle_Store  (Kraken_API const &K,
+                   vector<string> pairs,
+                   vector<int> intervals  =  {1, 5, 60},
+                   size_t capacity  =  720);
+
+    ~Candle_Store  ();
+
+    Candle_Store  (Candle_Store const &)  =  delete;
+    Candle_Store &  operator=  (Candle_Store const &)  =  delete;
+
+
+    /*  Fetch what is new for every pair, with up to concurrency requests in
+     *  flight at once (subject to the rate limiter of K), and bring all
+     *  the intervals up to date; returns the number of base bars added or
+     *  replaced.  The pairs are fetched with the given options, SINCE and
+     *  INTERVAL being set for each.  Pairs which fail are left as they
+     *  were and tried again next time, and the first failure is then
+     *  thrown.  */
+    size_t  update  (Kraken_API::Options const &  =  {},
+                     size_t concurrency  =  16);
+
+
+    /*  Call f with the bars, which update will not change until f
+     *  returns.  Throws out_of_range for an unknown pair or interval.  */
+    void  read  (string_view pair,  int interval,
+                 function<void (Bars const &)> const &f)  const;
+
+    /*  The same without a lock, for use only when update is not running
+     *  at the same time; the bars are valid until the next update.  */
+    Bars  bars  (string_view pair,  int interval)  const;
+
+
+    vector<string> const &  pairs      ()  const;
+    vector<int> const &     intervals  ()  const;
+
+    /*  The SINCE value of the next request for the pair. */
+    int64_t  since  (string_view pair)  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Candle_Store.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_CANDLES__H.  */
@@ -0,0 +1,128 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_DECIMAL__H
+#define DMBCS_KRAKEN_DECIMAL__H
+
+
+/*  Exact decimal numbers for prices and volumes, so that these can be
+ *  carried from market data to orders in integer arithmetic.  Kraken
+ *  quotes each pairʼs prices and volumes to a fixed number of decimal
+ *  places (see Asset_Pairs), and these numbers are kept at such a scale.
+ */
+
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  /*  The value is units divided by ten to the power scale, so that 30500.1
+   *  at scale 2 is 3050010 units.  Reading and writing the text of one
+   *  needs no memory from the heap, and nor does arithmetic.  */
+
+  struct  Decimal
+  {
+    static constexpr int  MAX_SCALE  =  18;
+
+    /*  Big enough for the text of any value, and a NUL. */
+    using  Text  =  array<char, 24>;
+
+    enum  Rounding  {  NEAREST,  DOWN,  UP  };
+
+
+    int64_t  units  {0};
+    int      scale  {0};
+
+
+    /*  Text such as "30500.10" or "-0.5", at the scale it is written in
+     *  (up to MAX_SCALE), or else rounded to the given one.  Throws
+     *  invalid_argument if the text is not a number or does not fit.  */
+    static  Decimal  parse  (string_view text,  int scale  =  -1);
+
+    /*  The same, as std::from_chars. */
+    static  from_chars_result  from_chars  (char const *first,
+                                            char const *last,
+                                            Decimal &value,
+                                            int scale  =  -1);
+
+    /*  Rounded to the nearest unit at the given scale. */
+    static  Decimal  from_double  (double value,  int scale);
+
+    double  to_double  ()  const;
+
+
+    /*  The same value at another scale, rounded (NEAREST being half away
+     *  from zero, DOWN and UP towards minus and plus infinity) if the
+     *  scale is lower.  Throws overflow_error if it does not fit.  */
+    Decimal  rescale  (int scale,  Rounding  =  NEAREST)  const;
+
+
+    /*  Written with exactly scale decimal places and no exponent. */
+    to_chars_result  to_chars  (char *first,  char *last)  const;
+
+    /*  The same, into the buffer, as for Nonce_Source. */
+    string_view  write  (Text &)  const;
+
+    string  str  ()  const;
+  };
+
+
+
+  /*  Less than, equal to or greater than zero as a is less than, equal to
+   *  or greater than b, whatever their scales.  */
+  int  compare  (Decimal a,  Decimal b);
+
+  inline bool  operator==  (Decimal a, Decimal b)
+                                      {  return ! compare (a, b);  }
+  inline bool  operator!=  (Decimal a, Decimal b)
+                                      {  return compare (a, b) != 0;  }
+  inline bool  operator<   (Decimal a, Decimal b)
+                                      {  return compare (a, b) < 0;  }
+  inline bool  operator>   (Decimal a, Decimal b)
+                                      {  return compare (a, b) > 0;  }
+  inline bool  operator<=  (Decimal a, Decimal b)
+                                      {  return compare (a, b) <= 0;  }
+  inline bool  operator>=  (Decimal a, Decimal b)
+                                      {  return compare (a, b) >= 0;  }
+
+
+  /*  At the greater of the two scales; these throw overflow_error if the
+   *  result does not fit.  */
+  Decimal  operator+  (Decimal a,  Decimal b);
+  Decimal  operator-  (Decimal a,  Decimal b);
+  Decimal  operator-  (Decimal a);
+  Decimal  operator*  (Decimal a,  int64_t n);
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_DECIMAL__H.  */
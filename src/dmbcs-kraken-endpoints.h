@@ -0,0 +1,284 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_ENDPOINTS__H
+#define DMBCS_KRAKEN_ENDPOINTS__H
+
+
+/*  A description of each function of Krakenʼs REST interface which takes
+ *  a fixed set of options, from which the library makes its requests, and
+ *  with which options can be checked against the function when the
+ *  program is compiled.  */
+
+
+#include <dmbcs-kraken-market.h>
+#include <array>
+#include <cstdint>
+#include <string>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  enum  class  Endpoint
+    {
+      TIME, ASSETS, ASSET_PAIRS, TICKER, OHLC, DEPTH, TRADES, SPREAD,
+      BALANCE, TRADE_BALANCE, OPEN_ORDERS, CLOSED_ORDERS, QUERY_ORDERS,
+      TRADES_HISTORY, QUERY_TRADES, OPEN_POSITIONS, LEDGERS, QUERY_LEDGERS,
+      TRADE_VOLUME, CANCEL_ORDER, CANCEL_ALL, __ENDPOINTS
+    };
+
+
+  struct  Endpoint_Description
+  {
+    /*  The last part of the URL, e.g. "OHLC". */
+    char const *  path;
+
+    bool          is_private;
+
+    /*  The name of the one argument the function always takes (as
+     *  "pair" or "txid"), or null if it takes none.  */
+    char const *  argument;
+
+    /*  Bit O is set if the function takes option O. */
+    uint32_t      options;
+  };
+
+
+  static_assert (Kraken_API::__CEILING <= 32,
+                 "an option set must have a bit for every option");
+
+
+  template <typename... Option>
+  constexpr  uint32_t  option_set  (Option const... O)
+  {   return  (uint32_t {0}  |  ...  |  (uint32_t {1} << O));   }
+
+
+  /*  Indexed by Endpoint. */
+  inline constexpr  array<Endpoint_Description,
+                          size_t (Endpoint::__ENDPOINTS)>  ENDPOINTS
+  {{
+    {"Time",           false,  nullptr,  option_set ()},
+    {"Assets",         false,  nullptr,  option_set (Kraken_API::INFO,
+                                                     Kraken_API::ACLASS,
+                                                     Kraken_API::ASSET)},
+    {"AssetPairs",     false,  nullptr,  option_set (Kraken_API::INFO,
+                                                     Kraken_API::PAIR)},
+    {"Ticker",         false,  "pair",   option_set ()},
+    {"OHLC",           false,  "pair",   option_set (Kraken_API::INTERVAL,
+                                                     Kraken_API::SINCE)},
+    {"Depth",          false,  "pair",   option_set (Kraken_API::COUNT)},
+    {"Trades",         false,  "pair",   option_set (Kraken_API::SINCE)},
+    {"Spread",         false,  "pair",   option_set (Kraken_API::SINCE)},
+    {"Balance",        true,   nullptr,  option_set ()},
+    {"TradeBalance",   true,   nullptr,  option_set (Kraken_API::ASSET)},
+    {"OpenOrders",     true,   nullptr,  option_set (Kraken_API::TRADES,
+                                                     Kraken_API::USERREF)},
+    {"ClosedOrders",   true,   nullptr,  option_set (Kraken_API::TRADES,
+                                                     Kraken_API::USERREF,
+                                                     Kraken_API::START,
+                                                     Kraken_API::END,
+                                                     Kraken_API::OFS,
+                                                     Kraken_API::CLOSE_TIME)},
+    {"QueryOrders",    true,   "txid",   option_set (Kraken_API::TRADES,
+                                                     Kraken_API::USERREF)},
+    {"TradesHistory",  true,   nullptr,  option_set (Kraken_API::TYPE,
+                                                     Kraken_API::TRADES,
+                                                     Kraken_API::START,
+                                                     Kraken_API::END,
+                                                     Kraken_API::OFS)},
+    {"QueryTrades",    true,   "txid",   option_set (Kraken_API::TRADES)},
+    {"OpenPositions",  true,   "txid",   option_set (Kraken_API::DO_CALCS)},
+    {"Ledgers",        true,   nullptr,  option_set (Kraken_API::ACLASS,
+                                                     Kraken_API::ASSET,
+                                                     Kraken_API::TYPE,
+                                                     Kraken_API::START,
+                                                     Kraken_API::END,
+                                                     Kraken_API::OFS)},
+    {"QueryLedgers",   true,   "id",     option_set ()},
+    {"TradeVolume",    true,   nullptr,  option_set (Kraken_API::PAIR,
+                                                     Kraken_API::FEE_INFO)},
+    {"CancelOrder",    true,   "txid",   option_set ()},
+    {"CancelAll",      true,   nullptr,  option_set ()}
+  }};
+
+
+  constexpr  Endpoint_Description  describe  (Endpoint const E)
+  {   return ENDPOINTS [size_t (E)];   }
+
+
+  constexpr  bool  accepts  (Endpoint const E,  Kraken_API::Option const O)
+  {   return  describe (E).options  &  (uint32_t {1} << O);   }
+
+
+
+  /*  What fetch gives for each endpoint: the typed market data where
+   *  there is such a type, else the JSON text as Kraken sent it.  */
+
+  template <Endpoint E>
+  struct  Endpoint_Result
+  {
+    using  type  =  string;
+    static  string  parse  (string json)   {   return json;   }
+  };
+
+  template <>
+  struct  Endpoint_Result<Endpoint::ASSET_PAIRS>
+  {
+    using  type  =  vector<Asset_Pair>;
+    static  type  parse  (string const &json)
+    {   return parse_asset_pairs (json);   }
+  };
+
+  template <>
+  struct  Endpoint_Result<Endpoint::OHLC>
+  {
+    using  type  =  OHLC_Series;
+    static  type  parse  (string const &json)
+    {   return parse_ohlc_data (json);   }
+  };
+
+  template <>
+  struct  Endpoint_Result<Endpoint::DEPTH>
+  {
+    using  type  =  Order_Book;
+    static  type  parse  (string const &json)
+    {   return parse_order_book (json);   }
+  };
+
+  template <>
+  struct  Endpoint_Result<Endpoint::TRADES>
+  {
+    using  type  =  Recent_Trades;
+    static  type  parse  (string const &json)
+    {   return parse_recent_trades (json);   }
+  };
+
+  template <>
+  struct  Endpoint_Result<Endpoint::SPREAD>
+  {
+    using  type  =  Spread_Series;
+    static  type  parse  (string const &json)
+    {   return parse_spread_data (json);   }
+  };
+
+
+
+  /*  Options for one endpoint, which will not compile if set to an
+   *  option the endpoint does not take:
+
+   *       auto  O  =  Endpoint_Options<Endpoint::OHLC> {};
+   *       O.set<Kraken_API::INTERVAL> (60);      //  Fine.
+   *       O.set<Kraken_API::COUNT> (10);         //  Error.
+   */
+
+  template <Endpoint E>
+  class  Endpoint_Options
+  {
+  public:
+
+    template <Kraken_API::Option O,  typename T>
+    Endpoint_Options &  set  (T const &value)
+    {
+      static_assert (accepts (E, O),  "the endpoint does not take this "
+                                      "option");
+      table.set (O, value);
+      return *this;
+    }
+
+    template <Kraken_API::Option O>
+    Endpoint_Options &  clear  ()
+    {
+      static_assert (accepts (E, O),  "the endpoint does not take this "
+                                      "option");
+      table.clear (O);
+      return *this;
+    }
+
+    Kraken_API::Options const &  values  ()  const   {   return table;   }
+
+  private:
+
+    Kraken_API::Options  table;
+  };
+
+
+
+  /*  Defined, for every endpoint, in dmbcs-kraken-api.cc; the argument
+   *  is null if the endpoint takes none.  */
+  template <Endpoint E>
+  string  endpoint_request  (Kraken_API const &,
+                             Kraken_API::Options const &,
+                             string const *argument);
+
+  /*  The same, handed to the request engine: done is called on its
+   *  thread with the reply or the reason for failure.  The rate limiter
+   *  is not consulted; the caller must have let the request through it
+   *  already (see Rate_Limiter::retry_after).  */
+  template <Endpoint E>
+  void  endpoint_submit  (Kraken_API const &,
+                          Kraken_API::Options const &,
+                          string const *argument,
+                          Kraken_API::Completion done);
+
+
+  /*  The reply to the request which E describes, as text; the argument
+   *  is needed if and only if the description names one.  */
+
+  template <Endpoint E>
+  string  fetch_text  (Kraken_API const &K,  Endpoint_Options<E> const &O)
+  {
+    static_assert (! describe (E).argument,
+                   "the endpoint needs its argument");
+    return endpoint_request<E> (K, O.values (), nullptr);
+  }
+
+  template <Endpoint E>
+  string  fetch_text  (Kraken_API const &K,  Endpoint_Options<E> const &O,
+                       string const &argument)
+  {
+    static_assert (describe (E).argument,
+                   "the endpoint takes no argument");
+    return endpoint_request<E> (K, O.values (), &argument);
+  }
+
+
+  /*  The same, parsed as the Endpoint_Result. */
+
+  template <Endpoint E>
+  typename Endpoint_Result<E>::type
+  fetch  (Kraken_API const &K,  Endpoint_Options<E> const &O  =  {})
+  {   return Endpoint_Result<E>::parse (fetch_text (K, O));   }
+
+  template <Endpoint E>
+  typename Endpoint_Result<E>::type
+  fetch  (Kraken_API const &K,  Endpoint_Options<E> const &O,
+          string const &argument)
+  {   return Endpoint_Result<E>::parse (fetch_text (K, O, argument));   }
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_ENDPOINTS__H.  */
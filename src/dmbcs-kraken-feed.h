@@ -0,0 +1,119 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_FEED__H
+#define DMBCS_KRAKEN_FEED__H
+
+
+/*  A client for Krakenʼs public WebSocket market-data feed, as an
+ *  alternative to polling the REST functions in dmbcs-kraken-api.h.  */
+
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  /*  The connection is made, and kept up, by a thread of the objectʼs own;
+   *  all the handlers are called on that thread, and must not block it
+   *  for long.  Should the connection drop, it is re-made and all the
+   *  current subscriptions renewed (which, for the book channel, means
+   *  a fresh snapshot will follow).  */
+
+  class  Kraken_Feed
+  {
+  public:
+
+    enum  Channel
+      {
+        BOOK, TRADE, TICKER, SPREAD, OHLC
+      };
+
+
+    /*  Given the whole of each data message, exactly as Kraken sent it,
+     *  for example
+     *     [0,[["5541.3","0.5","1534614057.3","s","l",""]],"trade","XBT/USD"]
+     */
+    using  Handler  =  function<void (Channel, string_view pair,
+                                      string_view message)>;
+
+    /*  Given Krakenʼs event messages (systemStatus, subscriptionStatus,
+     *  ...) apart from heartbeats, and also messages of the same form
+     *  about the state of the connection: {"event":"feedConnected"} and
+     *  {"event":"feedDisconnected","reason":"..."}.  */
+    using  Status_Handler  =  function<void (string_view message)>;
+
+
+    static  constexpr  char const *const  default_url
+                                             {"wss://ws.kraken.com/"};
+
+
+    /*  The url may be ws:// or wss://; anything else which speaks the
+     *  protocol (a local stand-in for testing, say) will do.  */
+    explicit  Kraken_Feed  (string url  =  default_url,
+                            Status_Handler status  =  {});
+
+    /*  Closes the connection and stops the thread. */
+    ~Kraken_Feed  ();
+
+    Kraken_Feed  (Kraken_Feed const &)  =  delete;
+    Kraken_Feed &  operator=  (Kraken_Feed const &)  =  delete;
+
+
+    /*  The parameter is the depth for the book channel (10, 25, 100, 500
+     *  or 1000) and the interval in minutes for the ohlc channel, and
+     *  is otherwise ignored; zero means Krakenʼs default.  Subscribing
+     *  again to a pair on a channel replaces the previous handler.  */
+    void  subscribe  (Channel,
+                      vector<string> const &pairs,
+                      Handler,
+                      int parameter  =  0);
+
+    void  unsubscribe  (Channel,  vector<string> const &pairs);
+
+
+    bool      connected          ()  const;
+    uint64_t  messages_received  ()  const;
+    uint64_t  reconnections      ()  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Kraken_Feed.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_FEED__H.  */
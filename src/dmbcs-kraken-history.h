@@ -0,0 +1,101 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_HISTORY__H
+#define DMBCS_KRAKEN_HISTORY__H
+
+
+/*  Reading the whole of an accountʼs trade, order or ledger history,
+ *  which Kraken will only give fifty entries at a time.  */
+
+
+#include <dmbcs-kraken-market.h>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  class  History_Reader
+  {
+  public:
+
+    enum  Kind  {  TRADES, CLOSED_ORDERS, LEDGERS  };
+
+
+    /*  Kraken gives this many entries per call. */
+    static constexpr size_t  PAGE_SIZE  =  50;
+
+
+    /*  The entries in the range set by the START and END options (all of
+     *  them if those are not set), newest first.  If END is not set it is
+     *  taken as now, so that entries made while reading do not shift the
+     *  pages.  Up to prefetch pages are requested ahead of the one being
+     *  read, asynchronously and subject to the objectʼs rate limiter.  */
+    History_Reader  (Kraken_API const &K,
+                     Kind,
+                     Kraken_API::Options options  =  {},
+                     size_t prefetch  =  2);
+
+    ~History_Reader  ();
+
+    History_Reader  (History_Reader const &)  =  delete;
+    History_Reader &  operator=  (History_Reader const &)  =  delete;
+
+
+    /*  False once there are no more; entries which appear on two pages
+     *  are only given once.  Throws Kraken_Error if Kraken refuses a
+     *  request, or whatever else stopped a page coming; calling again
+     *  asks for that page again.  */
+    bool  next  (History_Entry &);
+
+    /*  As reported by Kraken with the first page; zero before that. */
+    size_t  count  ()  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class History_Reader.  */
+
+
+
+  /*  All the entries from after start up to end (Unix times), newest
+   *  first and without duplicates.  The range is cut into windows, which
+   *  are read by up to concurrency threads at a time, all sharing the rate
+   *  limiter of K.  */
+  vector<History_Entry>  backfill_history  (Kraken_API const &K,
+                                            History_Reader::Kind,
+                                            Kraken_API::Options const &,
+                                            int64_t start,
+                                            int64_t end,
+                                            size_t windows  =  8,
+                                            size_t concurrency  =  4);
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_HISTORY__H.  */
@@ -0,0 +1,311 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_MARKET__H
+#define DMBCS_KRAKEN_MARKET__H
+
+
+/*  Typed forms of the returns from the exchange inquiry functions, read
+ *  directly out of the JSON text Kraken sends without building any
+ *  intermediate document.  */
+
+
+#include <dmbcs-kraken-api.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  /*  Thrown when the error array of a response holds any errors (as
+   *  opposed to warnings).  */
+
+  class  Kraken_Error  :  public runtime_error
+  {
+  public:
+
+    explicit  Kraken_Error  (vector<string> M);
+
+    /*  As Kraken sent them, e.g. "EGeneral:Invalid arguments". */
+    vector<string> const  messages;
+  };
+
+
+  /*  Thrown by Kraken_API::cancel_orders when any of its requests
+   *  failed, whether refused by Kraken or lost on the way; the messages
+   *  are then Krakenʼs errors and the reasons for the losses.  */
+
+  class  Cancel_Orders_Error  :  public Kraken_Error
+  {
+  public:
+
+    Cancel_Orders_Error  (vector<string> M,
+                          size_t count,
+                          vector<string> failed);
+
+    /*  The number Kraken cancelled in the requests which did succeed. */
+    size_t const  count;
+
+    /*  The txids sent in the requests which did not. */
+    vector<string> const  failed;
+  };
+
+
+  /*  Throw a Kraken_Error if the response carries one.  */
+  void  check_errors  (string_view json);
+
+
+
+  /*  The prices and volumes below are held as Number, either double or,
+   *  to keep them exactly as Kraken sent them, Decimal; the plain names
+   *  are the double forms, and the Exact_ ones the Decimal.  */
+
+  template <typename Number>
+  struct  Basic_Order_Book_Level
+  {
+    Number  price;
+    Number  volume;
+    double  time;
+  };
+
+
+  template <typename Number>
+  struct  Basic_Order_Book
+  {
+    string                                  pair;
+
+    /*  Best first: asks ascending and bids descending in price. */
+    vector<Basic_Order_Book_Level<Number>>  asks;
+    vector<Basic_Order_Book_Level<Number>>  bids;
+  };
+
+
+
+  /*  Structure of arrays: element i of each vector belongs to trade i.  */
+
+  template <typename Number>
+  struct  Basic_Recent_Trades
+  {
+    string          pair;
+
+    vector<Number>  price;
+    vector<Number>  volume;
+    vector<double>  time;
+    vector<char>    side;         /*  'b' or 's'.  */
+    vector<char>    order_type;   /*  'm' or 'l'.  */
+
+    /*  To give as the SINCE option to get the trades after these. */
+    int64_t         last  {0};
+
+    size_t  size  ()  const   {   return price.size ();   }
+  };
+
+
+
+  template <typename Number>
+  struct  Basic_OHLC_Bar
+  {
+    int64_t  time;
+    Number   open;
+    Number   high;
+    Number   low;
+    Number   close;
+    Number   vwap;
+    Number   volume;
+    int64_t  count;
+  };
+
+
+  template <typename Number>
+  struct  Basic_OHLC_Series
+  {
+    string                          pair;
+    vector<Basic_OHLC_Bar<Number>>  bars;
+
+    /*  To give as the SINCE option to get the bars after these. */
+    int64_t                         last  {0};
+  };
+
+
+
+  template <typename Number>
+  struct  Basic_Spread_Entry
+  {
+    int64_t  time;
+    Number   bid;
+    Number   ask;
+  };
+
+
+  template <typename Number>
+  struct  Basic_Spread_Series
+  {
+    string                              pair;
+    vector<Basic_Spread_Entry<Number>>  entries;
+    int64_t                             last  {0};
+  };
+
+
+  using  Order_Book_Level        =  Basic_Order_Book_Level<double>;
+  using  Order_Book              =  Basic_Order_Book<double>;
+  using  Recent_Trades           =  Basic_Recent_Trades<double>;
+  using  OHLC_Bar                =  Basic_OHLC_Bar<double>;
+  using  OHLC_Series             =  Basic_OHLC_Series<double>;
+  using  Spread_Entry            =  Basic_Spread_Entry<double>;
+  using  Spread_Series           =  Basic_Spread_Series<double>;
+
+  using  Exact_Order_Book_Level  =  Basic_Order_Book_Level<Decimal>;
+  using  Exact_Order_Book        =  Basic_Order_Book<Decimal>;
+  using  Exact_Recent_Trades     =  Basic_Recent_Trades<Decimal>;
+  using  Exact_OHLC_Bar          =  Basic_OHLC_Bar<Decimal>;
+  using  Exact_OHLC_Series       =  Basic_OHLC_Series<Decimal>;
+  using  Exact_Spread_Entry      =  Basic_Spread_Entry<Decimal>;
+  using  Exact_Spread_Series     =  Basic_Spread_Series<Decimal>;
+
+
+
+  /*  One of the tradable pairs, from AssetPairs.  Kraken takes and gives
+   *  the pairʼs prices with pair_decimals places, and its volumes with
+   *  lot_decimals.  */
+  struct  Asset_Pair
+  {
+    string   name;            /*  As Kraken keys it, e.g. "XXBTZUSD".  */
+    string   altname;         /*  e.g. "XBTUSD".  */
+    string   wsname;          /*  e.g. "XBT/USD".  */
+    int      pair_decimals  {0};
+    int      lot_decimals   {0};
+    Decimal  ordermin       {};
+  };
+
+
+  /*  The pairs by any of their names, for turning prices and volumes
+   *  into Decimals at the scales Kraken will accept.  */
+  class  Asset_Pairs
+  {
+  public:
+
+    Asset_Pairs  ()  =  default;
+
+    explicit  Asset_Pairs  (vector<Asset_Pair> P);
+
+    /*  Throws out_of_range if the pair is not known. */
+    Asset_Pair const &  operator[]  (string_view pair)  const;
+
+    bool  contains  (string_view pair)  const;
+
+    /*  The value at the pairʼs price or volume scale. */
+    Decimal  price   (string_view pair,  Decimal value,
+                      Decimal::Rounding  =  Decimal::NEAREST)  const;
+    Decimal  price   (string_view pair,  double value)  const;
+    Decimal  volume  (string_view pair,  Decimal value,
+                      Decimal::Rounding  =  Decimal::NEAREST)  const;
+    Decimal  volume  (string_view pair,  double value)  const;
+
+    vector<Asset_Pair> const &  pairs  ()  const   {   return all;   }
+
+  private:
+
+    vector<Asset_Pair>  all;
+
+    /*  Names, altnames and wsnames, each with its index in all, sorted
+     *  for binary search. */
+    vector<pair<string, size_t>>  index;
+  };
+
+
+
+  /*  An entry of TradesHistory, ClosedOrders or Ledgers, with its
+   *  details left as the JSON object Kraken sent.  The time is that of
+   *  the trade, the ledger entry or the closing of the order.  */
+  struct  History_Entry
+  {
+    string  id;
+    double  time  {0.0};
+    string  json;
+  };
+
+
+  struct  History_Page
+  {
+    vector<History_Entry>  entries;
+
+    /*  The number of entries in the whole of the range asked for. */
+    size_t                 count  {0};
+  };
+
+
+
+  /*  These throw Kraken_Error if Kraken reported an error, and
+   *  runtime_error if the text is not what Kraken would send.  The
+   *  Number may be double or Decimal, as above.  */
+
+  template <typename Number  =  double>
+  Basic_Order_Book<Number>     parse_order_book     (string_view json);
+  template <typename Number  =  double>
+  Basic_Recent_Trades<Number>  parse_recent_trades  (string_view json);
+  template <typename Number  =  double>
+  Basic_OHLC_Series<Number>    parse_ohlc_data      (string_view json);
+  template <typename Number  =  double>
+  Basic_Spread_Series<Number>  parse_spread_data    (string_view json);
+
+  History_Page                 parse_history_page   (string_view json);
+  vector<Asset_Pair>           parse_asset_pairs    (string_view json);
+
+
+
+  /*  Make the request and parse the result in one go. */
+
+  template <typename Number  =  double>
+  Basic_Order_Book<Number>
+  fetch_order_book     (Kraken_API const &,  Kraken_API::Options const &,
+                        string const &pair);
+
+  template <typename Number  =  double>
+  Basic_Recent_Trades<Number>
+  fetch_recent_trades  (Kraken_API const &,  Kraken_API::Options const &,
+                        string const &pair);
+
+  template <typename Number  =  double>
+  Basic_OHLC_Series<Number>
+  fetch_ohlc_data      (Kraken_API const &,  Kraken_API::Options const &,
+                        string const &pair);
+
+  template <typename Number  =  double>
+  Basic_Spread_Series<Number>
+  fetch_spread_data    (Kraken_API const &,  Kraken_API::Options const &,
+                        string const &pair);
+
+  /*  All the pairs, or those listed in the PAIR option. */
+  vector<Asset_Pair>
+  fetch_asset_pairs    (Kraken_API const &,  Kraken_API::Options const &);
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_MARKET__H.  */
@@ -0,0 +1,135 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_RECORDING__H
+#define DMBCS_KRAKEN_RECORDING__H
+
+
+/*  Keeping market data in a compact binary file, and reading it back
+ *  with no parsing and no network, e.g. for back-testing.
+ *
+ *  A file is a sequence of records, one per recorded object, each laid
+ *  out as columns: prices and volumes as 64-bit fixed-point numbers with
+ *  eight decimal places, times as 32-bit differences from the previous
+ *  time.  Records are only ever appended, and a file which ends in the
+ *  middle of a record (because the writer died) is read up to the last
+ *  whole one.  */
+
+
+#include <dmbcs-kraken-market.h>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  class  Market_Recorder
+  {
+  public:
+
+    /*  Opens the file for appending, creating it if need be.  Throws
+     *  runtime_error if that cannot be done.  */
+    explicit  Market_Recorder  (string const &path);
+
+    ~Market_Recorder  ();
+
+    Market_Recorder  (Market_Recorder const &)  =  delete;
+    Market_Recorder &  operator=  (Market_Recorder const &)  =  delete;
+
+
+    /*  Each of these appends one record with a single write, so that
+     *  several recorders (even in different processes) can share a file.
+     *  Prices and volumes are rounded to eight decimal places, and times
+     *  to the nearest microsecond, or coarser where the gaps between
+     *  them are more than half an hour.  Throws runtime_error if the
+     *  write fails.  */
+    void  record  (Order_Book const &);
+    void  record  (Recent_Trades const &);
+    void  record  (OHLC_Series const &);
+    void  record  (Spread_Series const &);
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Market_Recorder.  */
+
+
+
+  class  Market_Replay
+  {
+  public:
+
+    enum  Kind  {  END,  ORDER_BOOK,  RECENT_TRADES,  OHLC,  SPREAD  };
+
+
+    /*  Maps the file into memory; throws runtime_error if it cannot be
+     *  read or is not a recording.  */
+    explicit  Market_Replay  (string const &path);
+
+    ~Market_Replay  ();
+
+    Market_Replay  (Market_Replay const &)  =  delete;
+    Market_Replay &  operator=  (Market_Replay const &)  =  delete;
+
+
+    /*  Move on to the next record (the first one on the first call), and
+     *  say what it holds.  END means there are no more.  */
+    Kind  next  ();
+
+    /*  Back to before the first record. */
+    void  rewind  ();
+
+
+    /*  The pair of the current record, without decoding anything else. */
+    string_view  pair  ()  const;
+
+
+    /*  Decode the current record, which must be of the corresponding
+     *  kind or else logic_error is thrown.  The results are the same as
+     *  would have come from the fetch_ functions, up to the rounding
+     *  described above.  The out-parameter forms re-use the memory of
+     *  the vectors they are given.  */
+    void  read  (Order_Book &)  const;
+    void  read  (Recent_Trades &)  const;
+    void  read  (OHLC_Series &)  const;
+    void  read  (Spread_Series &)  const;
+
+    template <typename T>  T  read  ()  const
+    {  T  ret;   read (ret);   return ret;  }
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Market_Replay.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_RECORDING__H.  */
@@ -0,0 +1,126 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_RISK__H
+#define DMBCS_KRAKEN_RISK__H
+
+
+/*  The last line of defence: cancelling every open order at once, and
+ *  Krakenʼs dead-man switch, which cancels them all if the program stops
+ *  saying otherwise.  */
+
+
+#include <dmbcs-kraken-api.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  /*  The requests go over two connections of the guardʼs own, one for
+   *  cancelling and one for the heartbeat, which are opened when the
+   *  guard is made and kept open by a thread of its own; they do not
+   *  share the connection pool, request engine or rate limiter of the
+   *  Kraken_API object, so they are not held up by whatever else that is
+   *  doing.  The URL of each request and its API-Key header are made
+   *  once, leaving only the nonce and signature for each call.  */
+
+  class  Risk_Guard
+  {
+  public:
+
+    struct  Statistics
+    {
+      uint64_t             cancels             {0};
+      chrono::nanoseconds  last_cancel         {0};
+      chrono::nanoseconds  worst_cancel        {0};
+
+      uint64_t             heartbeats          {0};
+      uint64_t             heartbeat_failures  {0};
+      chrono::nanoseconds  last_heartbeat      {0};
+
+      /*  When Kraken will cancel everything unless a heartbeat gets
+       *  there first; zero when the switch is not armed.  */
+      chrono::system_clock::time_point  trigger_time  {};
+    };
+
+
+    /*  The key, secret, nonce source, URL and metrics are taken from K,
+     *  which need not outlive the guard.  Each request must be answered
+     *  within deadline.  */
+    explicit  Risk_Guard  (Kraken_API const &K,
+                           chrono::milliseconds deadline
+                                  =  chrono::milliseconds {2000});
+
+    /*  Stops the heartbeat but leaves the switch armed, so that Kraken
+     *  cancels the orders when it runs out; call disarm first to avoid
+     *  that.  */
+    ~Risk_Guard  ();
+
+    Risk_Guard  (Risk_Guard const &)  =  delete;
+    Risk_Guard &  operator=  (Risk_Guard const &)  =  delete;
+
+
+    /*  CancelAll: cancel every open order, returning Krakenʼs reply.
+     *  Throws Kraken_Error if Kraken refuses, and as libcurl does if
+     *  there is no answer within the deadline.  */
+    string  cancel_all  ();
+
+    /*  CancelAllOrdersAfter: have Kraken cancel every open order when the
+     *  timeout runs out, unless this is called again first; a zero
+     *  timeout disarms the switch.  */
+    string  cancel_all_after  (chrono::seconds timeout);
+
+
+    /*  Arm the switch with the timeout, and re-arm it every interval
+     *  (which must be shorter) from the guardʼs thread until disarm is
+     *  called.  A heartbeat which fails is counted, handed to on_failure
+     *  if given (on the guardʼs thread), and tried again after a tenth of
+     *  the interval.  */
+    void  arm  (chrono::seconds timeout,
+                chrono::seconds interval,
+                function<void (exception_ptr)> on_failure  =  {});
+
+    /*  Stop the heartbeat and disarm the switch. */
+    void  disarm  ();
+
+
+    Statistics  statistics  ()  const;
+
+
+  private:
+
+    struct  Implementation;
+    unique_ptr<Implementation>  implementation;
+
+  };  /*  End of class Risk_Guard.  */
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_RISK__H.  */
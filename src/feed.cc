@@ -0,0 +1,745 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-feed.h>
+#include <curl/curl.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Kraken_Feed  F;
+
+  using  Clock  =  chrono::steady_clock;
+
+
+  static  constexpr  array<char const *, 5>  CHANNEL_NAME
+                        {  "book", "trade", "ticker", "spread", "ohlc"  };
+
+
+  /*  If nothing at all, not even a heartbeat, arrives for this long, the
+   *  connection is presumed dead.  */
+  static  constexpr  auto  QUIET_LIMIT  =  chrono::seconds {30};
+
+  static  constexpr  auto  HANDSHAKE_LIMIT  =  chrono::seconds {10};
+
+  static  constexpr  auto  LONGEST_BACKOFF  =  chrono::seconds {30};
+
+  /*  No message from Kraken comes anywhere near this; anything bigger is
+   *  refused (close code 1009) before it is buffered.  */
+  static  constexpr  auto  LARGEST_MESSAGE  =  uint64_t {16 << 20};
+
+
+
+  static  string  base64  (uint8_t const *data,  size_t const length)
+  {
+    auto  ret  =  string (4 * ((length + 2) / 3),  '\0');
+    EVP_EncodeBlock (reinterpret_cast<unsigned char*> (ret.data ()),
+                     data,  length);
+    return ret;
+  }
+
+
+
+  /*  Strip the last string from the end of text, which must end with the
+   *  string or with the close of an array after it. */
+  static  bool  take_last_string  (string_view &text,  string_view &out)
+  {
+    auto const  end  =  text.find_last_of ('"');
+    if (end == text.npos  ||  end == 0)   return false;
+
+    auto const  start  =  text.find_last_of ('"', end - 1);
+    if (start == text.npos)   return false;
+
+    out   =  text.substr (start + 1,  end - start - 1);
+    text  =  text.substr (0, start);
+    return true;
+  }
+
+
+
+  static  string  lower_case  (string s)
+  {
+    for (auto &c  :  s)
+      if (c >= 'A'  &&  c <= 'Z')   c  +=  'a' - 'A';
+    return s;
+  }
+
+
+
+  struct  Kraken_Feed::Implementation
+  {
+    struct  Subscription
+    {
+      int      parameter;
+      Handler  handler;
+    };
+
+
+    string          url;
+    Status_Handler  status;
+
+    mutable mutex                            lock;
+    map<pair<Channel, string>, Subscription>  subscriptions;
+    vector<string>                           outgoing;
+
+    /*  Written to by other threads to get the I/O threadʼs attention. */
+    int  wake [2]  {-1, -1};
+
+    atomic<bool>      stopping      {false};
+    atomic<bool>      is_connected  {false};
+    atomic<uint64_t>  received      {0};
+    atomic<uint64_t>  reconnected   {0};
+
+    /*  Everything below is only touched by the I/O thread. */
+
+    CURL           *curl    {nullptr};
+    curl_socket_t   socket  {CURL_SOCKET_BAD};
+
+    string  inbox;
+    string  fragments;
+
+    thread  io;
+
+
+    Implementation  (string U,  Status_Handler S)
+      :  url {move (U)},  status {move (S)}
+    {
+      if (pipe (wake))
+        throw runtime_error {"cannot make pipe for the feed thread"};
+
+      io  =  thread {[this] { run (); }};
+    }
+
+
+    ~Implementation  ()
+    {
+      stopping  =  true;
+      poke ();
+      io.join ();
+      close (wake [0]);
+      close (wake [1]);
+    }
+
+
+    void  poke  ()
+    {
+      auto const  c  =  char {0};
+      [[maybe_unused]]  auto  n  =  write (wake [1], &c, 1);
+    }
+
+
+    void  report  (string const &message)
+    {
+      if (status)   status (message);
+    }
+
+
+    /*  The message asking for (or cancelling) a subscription to one
+     *  channel for a list of pairs. */
+    static  string  request  (char const *const event,
+                              Channel const C,
+                              vector<string> const &pairs,
+                              int const parameter)
+    {
+      auto  ret  =  string {"{\"event\":\""};
+      ret  +=  event;
+      ret  +=  "\",\"pair\":[";
+
+      for (auto const &P  :  pairs)
+        {
+          if (&P != &pairs.front ())   ret  +=  ',';
+          ret  +=  '"';   ret  +=  P;   ret  +=  '"';
+        }
+
+      ret  +=  "],\"subscription\":{\"name\":\"";
+      ret  +=  CHANNEL_NAME [C];
+      ret  +=  '"';
+
+      if (parameter  &&  (C == BOOK  ||  C == OHLC))
+        {
+          ret  +=  C == BOOK  ?  ",\"depth\":"  :  ",\"interval\":";
+          ret  +=  to_string (parameter);
+        }
+
+      ret  +=  "}}";
+      return ret;
+    }
+
+
+    /*  Must be called with the lock held. */
+    void  queue_resubscription  ()
+    {
+      auto  groups  =  map<pair<Channel, int>, vector<string>> {};
+      for (auto const &S  :  subscriptions)
+        groups [{S.first.first, S.second.parameter}]
+                                            .push_back (S.first.second);
+
+      outgoing.clear ();
+      for (auto const &G  :  groups)
+        outgoing.push_back (request ("subscribe", G.first.first, G.second,
+                                     G.first.second));
+    }
+
+
+
+    /*  Low-level transport. */
+
+    void  wait_for  (short const events,  Clock::time_point const deadline)
+    {
+      auto  P  =  pollfd {socket, events, 0};
+      auto const  left  =  chrono::duration_cast<chrono::milliseconds>
+                                               (deadline - Clock::now ());
+      if (left.count () <= 0
+              ||  poll (&P, 1, static_cast<int> (left.count ())) <= 0)
+        throw runtime_error {"timed out"};
+    }
+
+
+    void  send_all  (string_view data)
+    {
+      auto const  deadline  =  Clock::now ()  +  HANDSHAKE_LIMIT;
+
+      while (! data.empty ())
+        {
+          auto  sent  =  size_t {0};
+          auto const  code  =  curl_easy_send (curl, data.data (),
+                                               data.length (), &sent);
+          if (code == CURLE_AGAIN)
+            wait_for (POLLOUT, deadline);
+          else if (code != CURLE_OK)
+            throw runtime_error {curl_easy_strerror (code)};
+          else
+            data.remove_prefix (sent);
+        }
+    }
+
+
+    /*  Returns false if there is nothing more to read just now. */
+    bool  receive_some  ()
+    {
+      auto  buffer  =  array<char, 16384> {};
+      auto  got     =  size_t {0};
+
+      auto const  code  =  curl_easy_recv (curl, buffer.data (),
+                                           buffer.size (), &got);
+      if (code == CURLE_AGAIN)
+        return false;
+      if (code != CURLE_OK)
+        throw runtime_error {curl_easy_strerror (code)};
+      if (got == 0)
+        throw runtime_error {"connection closed"};
+
+      inbox.append (buffer.data (), got);
+      return true;
+    }
+
+
+    void  send_frame  (uint8_t const opcode,  string_view payload)
+    {
+      auto  frame  =  string {};
+      frame.reserve (payload.length () + 14);
+
+      frame  +=  static_cast<char> (0x80 | opcode);
+
+      auto const  length  =  payload.length ();
+      if (length < 126)
+        frame  +=  static_cast<char> (0x80 | length);
+      else if (length < 65536)
+        {
+          frame  +=  static_cast<char> (0x80 | 126);
+          for (auto shift = 8;  shift >= 0;  shift -= 8)
+            frame  +=  static_cast<char> (length >> shift);
+        }
+      else
+        {
+          frame  +=  static_cast<char> (0x80 | 127);
+          for (auto shift = 56;  shift >= 0;  shift -= 8)
+            frame  +=  static_cast<char> (uint64_t {length} >> shift);
+        }
+
+      /*  Clients must mask everything they send. */
+      auto  mask  =  array<uint8_t, 4> {};
+      RAND_bytes (mask.data (), mask.size ());
+      frame.append (reinterpret_cast<char*> (mask.data ()), mask.size ());
+
+      for (auto i = size_t {0};  i < length;  ++i)
+        frame  +=  static_cast<char> (payload [i] ^ mask [i % 4]);
+
+      send_all (frame);
+    }
+
+
+
+    /*  Connection set-up and tear-down. */
+
+    void  connect  ()
+    {
+      auto  address  =  url;
+      if      (address.compare (0, 5, "ws://")  == 0)
+        address.replace (0, 2, "http");
+      else if (address.compare (0, 6, "wss://") == 0)
+        address.replace (0, 3, "https");
+
+      curl  =  curl_easy_init ();
+      if (! curl)   throw runtime_error {"cannot make libcurl handle"};
+
+      curl_easy_setopt (curl, CURLOPT_URL,            address.c_str ());
+      curl_easy_setopt (curl, CURLOPT_CONNECT_ONLY,   1L);
+      curl_easy_setopt (curl, CURLOPT_NOSIGNAL,       1L);
+      curl_easy_setopt (curl, CURLOPT_TCP_NODELAY,    1L);
+      /*  The upgrade in handshake () is HTTP/1.1, so TLS must not
+       *  negotiate h2. */
+      curl_easy_setopt (curl, CURLOPT_HTTP_VERSION,
+                        static_cast<long> (CURL_HTTP_VERSION_1_1));
+      curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT,
+                        static_cast<long> (HANDSHAKE_LIMIT.count ()));
+
+      auto const  code  =  curl_easy_perform (curl);
+      if (code != CURLE_OK)
+        throw runtime_error {curl_easy_strerror (code)};
+
+      curl_easy_getinfo (curl, CURLINFO_ACTIVESOCKET, &socket);
+
+      handshake (address);
+
+      is_connected  =  true;
+      report ("{\"event\":\"feedConnected\"}");
+    }
+
+
+    void  handshake  (string const &address)
+    {
+      auto  *const  U  =  curl_url ();
+      curl_url_set (U, CURLUPART_URL, address.c_str (), 0);
+
+      auto  part  =  [U] (CURLUPart const P)
+        {
+          char  *value  =  nullptr;
+          auto  ret  =  string {};
+          if (curl_url_get (U, P, &value, 0) == CURLUE_OK)
+            {
+              ret  =  value;
+              curl_free (value);
+            }
+          return ret;
+        };
+
+      auto  host  =  part (CURLUPART_HOST);
+      auto const  port  =  part (CURLUPART_PORT);
+      if (! port.empty ())   host  +=  ':'  +  port;
+
+      auto  path  =  part (CURLUPART_PATH);
+      auto const  query  =  part (CURLUPART_QUERY);
+      if (path.empty ())      path  =  "/";
+      if (! query.empty ())   path  +=  '?'  +  query;
+
+      curl_url_cleanup (U);
+
+      auto  nonce  =  array<uint8_t, 16> {};
+      RAND_bytes (nonce.data (), nonce.size ());
+      auto const  key  =  base64 (nonce.data (), nonce.size ());
+
+      send_all ("GET " + path + " HTTP/1.1\r\n"
+                "Host: " + host + "\r\n"
+                "Upgrade: websocket\r\n"
+                "Connection: Upgrade\r\n"
+                "Sec-WebSocket-Key: " + key + "\r\n"
+                "Sec-WebSocket-Version: 13\r\n"
+                "\r\n");
+
+      auto const  deadline  =  Clock::now ()  +  HANDSHAKE_LIMIT;
+      auto  end  =  string::npos;
+      while ((end = inbox.find ("\r\n\r\n"))  ==  string::npos)
+        if (! receive_some ())
+          wait_for (POLLIN, deadline);
+
+      auto  head  =  inbox.substr (0, end);
+      inbox.erase (0, end + 4);
+
+      if (head.compare (0, 12, "HTTP/1.1 101"))
+        throw runtime_error {"WebSocket upgrade refused: "
+                             +  head.substr (0, head.find ('\r'))};
+
+      auto  accept  =  key  +  "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+      auto  digest  =  array<uint8_t, SHA_DIGEST_LENGTH> {};
+      SHA1 (reinterpret_cast<unsigned char const*> (accept.data ()),
+            accept.length (), digest.data ());
+      accept  =  base64 (digest.data (), digest.size ());
+
+      /*  The header name is case-insensitive, but its value is not. */
+      auto const  at  =  lower_case (head).find ("\r\nsec-websocket-accept:");
+      auto const  value  =  at == string::npos
+                               ?  string::npos
+                               :  head.find_first_not_of (' ', at + 23);
+
+      if (value == string::npos
+              ||  head.compare (value, accept.length (), accept))
+        throw runtime_error {"WebSocket upgrade not acknowledged"};
+    }
+
+
+
+    void  disconnect  (string const &reason)
+    {
+      if (curl)
+        {
+          curl_easy_cleanup (curl);
+          curl  =  nullptr;
+        }
+
+      socket  =  CURL_SOCKET_BAD;
+      inbox.clear ();
+      fragments.clear ();
+
+      if (is_connected)
+        {
+          is_connected  =  false;
+
+          auto  message  =  string {"{\"event\":\"feedDisconnected\","
+                                    "\"reason\":\""};
+          for (auto const c  :  reason)
+            if (c != '"'  &&  c != '\\')   message  +=  c;
+          message  +=  "\"}";
+          report (message);
+        }
+    }
+
+
+
+    /*  Incoming traffic. */
+
+    void  dispatch  (string_view const message)
+    {
+      ++received;
+
+      if (message.empty ())   return;
+
+      if (message [0] == '{')
+        {
+          if (message.find ("\"heartbeat\"")  ==  message.npos)
+            report (string {message});
+          return;
+        }
+
+      /*  Data messages end with the channel name and then the pair. */
+      auto  tail  =  message;
+      auto  pair_name     =  string_view {};
+      auto  channel_name  =  string_view {};
+      if (! take_last_string (tail, pair_name)
+              ||  ! take_last_string (tail, channel_name))
+        return;
+
+      channel_name  =  channel_name.substr (0, channel_name.find ('-'));
+
+      auto const  C  =  find (begin (CHANNEL_NAME), end (CHANNEL_NAME),
+                              channel_name);
+      if (C == end (CHANNEL_NAME))   return;
+
+      auto const  channel  =  static_cast<Channel> (C - begin (CHANNEL_NAME));
+
+      auto  handler  =  Handler {};
+      {
+        auto  guard  =  lock_guard<mutex> {lock};
+        auto const  S  =  subscriptions.find ({channel, string {pair_name}});
+        if (S != subscriptions.end ())   handler  =  S->second.handler;
+      }
+
+      if (handler)   handler (channel, pair_name, message);
+    }
+
+
+    void  on_frame  (bool const fin,  uint8_t const opcode,
+                     string_view const payload)
+    {
+      switch (opcode)
+        {
+        case 0x0:                           /*  Continuation. */
+          if (fragments.length () + payload.length ()  >  LARGEST_MESSAGE)
+            refuse_message ();
+          fragments.append (payload);
+          if (fin)
+            {
+              dispatch (fragments);
+              fragments.clear ();
+            }
+          break;
+
+        case 0x1:                           /*  Text. */
+        case 0x2:                           /*  Binary. */
+          if (fin)
+            dispatch (payload);
+          else
+            fragments.assign (payload);
+          break;
+
+        case 0x8:                           /*  Close. */
+          send_frame (0x8, payload.substr (0, 2));
+          throw runtime_error {"connection closed by server"};
+
+        case 0x9:                           /*  Ping. */
+          send_frame (0xa, payload);
+          break;
+
+        default:                            /*  Pong, and unknowns. */
+          break;
+        }
+    }
+
+
+    [[noreturn]]  void  refuse_message  ()
+    {
+      send_frame (0x8, string_view {"\x03\xf1", 2});
+      throw runtime_error {"message too big"};
+    }
+
+
+    void  read_frames  ()
+    {
+      auto  at  =  size_t {0};
+
+      for (;;)
+        {
+          auto const  available  =  inbox.length ()  -  at;
+          if (available < 2)   break;
+
+          auto const  *const  B  =  reinterpret_cast<uint8_t const*>
+                                                          (inbox.data () + at);
+          auto const  fin     =  (B [0] & 0x80)  !=  0;
+          auto const  opcode  =  static_cast<uint8_t> (B [0] & 0x0f);
+          auto const  masked  =  (B [1] & 0x80)  !=  0;
+
+          auto  length  =  uint64_t {B [1] & 0x7fu};
+          auto  header  =  size_t {2};
+
+          if (length == 126)
+            {
+              if (available < 4)   break;
+              length  =  (uint64_t {B [2]} << 8)  |  B [3];
+              header  =  4;
+            }
+          else if (length == 127)
+            {
+              if (available < 10)   break;
+              length  =  0;
+              for (auto i = 2;  i < 10;  ++i)
+                length  =  (length << 8)  |  B [i];
+              header  =  10;
+            }
+
+          if (length > LARGEST_MESSAGE)   refuse_message ();
+
+          auto const  mask_at  =  header;
+          if (masked)   header  +=  4;
+
+          if (available  <  header + length)   break;
+
+          auto  *const  payload  =  inbox.data ()  +  at  +  header;
+          if (masked)
+            for (auto i = uint64_t {0};  i < length;  ++i)
+              payload [i]  ^=  B [mask_at + i % 4];
+
+          at  +=  header + length;
+
+          on_frame (fin, opcode, string_view {payload, length});
+        }
+
+      inbox.erase (0, at);
+    }
+
+
+
+    /*  The I/O threadʼs life. */
+
+    void  flush_outgoing  ()
+    {
+      auto  messages  =  vector<string> {};
+      {
+        auto  guard  =  lock_guard<mutex> {lock};
+        messages.swap (outgoing);
+      }
+
+      for (auto const &M  :  messages)   send_frame (0x1, M);
+    }
+
+
+    void  pump  ()
+    {
+      auto  last_heard  =  Clock::now ();
+
+      while (! stopping)
+        {
+          flush_outgoing ();
+
+          /*  Whatever arrived with the handshake. */
+          read_frames ();
+
+          auto  P  =  array<pollfd, 2> {pollfd {socket,   POLLIN, 0},
+                                        pollfd {wake [0], POLLIN, 0}};
+          poll (P.data (), P.size (), 1000);
+
+          if (P [1].revents)
+            {
+              auto  junk  =  array<char, 64> {};
+              [[maybe_unused]]  auto  n  =  read (wake [0], junk.data (),
+                                                  junk.size ());
+            }
+
+          if (P [0].revents)
+            {
+              /*  Take frames off as they come, so the inbox never holds
+               *  much more than one message. */
+              while (receive_some ())   read_frames ();
+              last_heard  =  Clock::now ();
+            }
+          else if (Clock::now ()  -  last_heard  >  QUIET_LIMIT)
+            throw runtime_error {"feed went quiet"};
+        }
+
+      send_frame (0x8, string_view {"\x03\xe8", 2});
+    }
+
+
+    void  run  ()
+    {
+      auto  backoff  =  chrono::seconds {1};
+
+      while (! stopping)
+        {
+          auto  reason  =  string {"closed"};
+
+          try
+            {
+              connect ();
+              backoff  =  chrono::seconds {1};
+
+              {
+                auto  guard  =  lock_guard<mutex> {lock};
+                queue_resubscription ();
+              }
+
+              pump ();
+            }
+          catch (exception const &E)
+            {
+              reason  =  E.what ();
+            }
+
+          disconnect (reason);
+
+          if (stopping)   break;
+
+          ++reconnected;
+
+          auto  P  =  pollfd {wake [0], POLLIN, 0};
+          poll (&P, 1, static_cast<int> (backoff.count () * 1000));
+          backoff  =  min (backoff * 2,  chrono::seconds {LONGEST_BACKOFF});
+        }
+    }
+  };
+
+
+
+  Kraken_Feed::Kraken_Feed  (string url,  Status_Handler status)
+    :  implementation {make_unique<Implementation> (move (url),
+                                                    move (status))}
+  {}
+
+
+  Kraken_Feed::~Kraken_Feed  ()  =  default;
+
+
+
+  void  Kraken_Feed::subscribe  (Channel const C,
+                                 vector<string> const &pairs,
+                                 Handler handler,
+                                 int const parameter)
+  {
+    auto  &I  =  *implementation;
+
+    {
+      auto  guard  =  lock_guard<mutex> {I.lock};
+
+      for (auto const &P  :  pairs)
+        I.subscriptions [{C, P}]  =  Implementation::Subscription
+                                                    {parameter, handler};
+
+      if (I.is_connected)
+        I.outgoing.push_back (Implementation::request ("subscribe", C, pairs,
+                                                       parameter));
+    }
+
+    I.poke ();
+  }
+
+
+
+  void  Kraken_Feed::unsubscribe  (Channel const C,
+                                   vector<string> const &pairs)
+  {
+    auto  &I  =  *implementation;
+
+    {
+      auto  guard  =  lock_guard<mutex> {I.lock};
+
+      auto  parameter  =  0;
+      for (auto const &P  :  pairs)
+        {
+          auto const  S  =  I.subscriptions.find ({C, P});
+          if (S == I.subscriptions.end ())   continue;
+          parameter  =  S->second.parameter;
+          I.subscriptions.erase (S);
+        }
+
+      if (I.is_connected)
+        I.outgoing.push_back (Implementation::request ("unsubscribe", C,
+                                                       pairs, parameter));
+    }
+
+    I.poke ();
+  }
+
+
+
+  bool  Kraken_Feed::connected  ()  const
+  {   return implementation->is_connected;   }
+
+  uint64_t  Kraken_Feed::messages_received  ()  const
+  {   return implementation->received;   }
+
+  uint64_t  Kraken_Feed::reconnections  ()  const
+  {   return implementation->reconnected;   }
+
+
+}  /* End of namespace DMBCS. */
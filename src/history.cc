@@ -0,0 +1,244 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-history.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <deque>
+#include <thread>
+#include <unordered_set>
+
+
+namespace  DMBCS  {
+
+
+  typedef  History_Reader  H;
+
+
+
+  static  future<string>  request  (Kraken_API const &K,
+                                    H::Kind const kind,
+                                    Kraken_API::Options const &options)
+  {
+    switch (kind)
+      {
+      case H::TRADES:          return K.trades_history_async (options);
+      case H::CLOSED_ORDERS:   return K.closed_orders_async (options);
+      case H::LEDGERS:         break;
+      }
+    return K.ledgers_info_async (options);
+  }
+
+
+
+  struct  H::Implementation
+  {
+    Implementation  (Kraken_API const &K_,  Kind const k,
+                     Kraken_API::Options O,  size_t const P)
+      :  K {K_},  kind {k},  options {move (O)},
+         prefetch {max (P, size_t {1})}
+    {
+      if (options [Kraken_API::END].empty ())
+        options.set (Kraken_API::END,  int64_t (time (nullptr)));
+    }
+
+
+    /*  Request pages ahead, as far as is known to be worthwhile (only the
+     *  first until it says how many there are), but beyond the page
+     *  needed next only if the rate limiter would let it through without
+     *  waiting.  */
+    void  top_up  ()
+    {
+      static  constexpr  array<char const *, 3>  FUNCTION
+                            {  "TradesHistory", "ClosedOrders", "Ledgers"  };
+
+      while (! finished
+               &&  pending.size () < prefetch
+               &&  (known  ?  offset < total  :  pending.empty ()))
+        {
+          auto const &L  =  K.rate_limiter;
+          if (! pending.empty ()  &&  L
+                &&  L->headroom () < Rate_Limiter::cost (FUNCTION [kind])
+                                        + Rate_Limiter::HISTORY_RESERVE)
+            break;
+
+          options.set (Kraken_API::OFS,  offset);
+          pending.push_back (request (K, kind, options));
+          offset  +=  PAGE_SIZE;
+        }
+    }
+
+
+    bool  next  (History_Entry &out)
+    {
+      while (ready.empty ())
+        {
+          top_up ();
+          if (pending.empty ())   return false;
+
+          auto  reply      =  move (pending.front ());
+          auto const  at   =  offset  -  pending.size () * PAGE_SIZE;
+          pending.pop_front ();
+
+          auto  page  =  History_Page {};
+          try
+            {
+              page  =  parse_history_page (reply.get ());
+            }
+          catch (...)
+            {
+              /*  Start again from this page on the next call; the ones
+               *  after it, already asked for, will be asked for again. */
+              offset  =  at;
+              pending.clear ();
+              throw;
+            }
+
+          if (! known)
+            {
+              known  =  true;
+              total  =  page.count;
+            }
+
+          /*  A short page is the last, whatever the count said. */
+          if (page.entries.size () < PAGE_SIZE)
+            {
+              finished  =  true;
+              pending.clear ();
+            }
+
+          for (auto &E  :  page.entries)
+            if (seen.insert (E.id).second)
+              ready.push_back (move (E));
+        }
+
+      out  =  move (ready.front ());
+      ready.pop_front ();
+      return true;
+    }
+
+
+    Kraken_API const &     K;
+    Kind const             kind;
+    Kraken_API::Options    options;
+    size_t const           prefetch;
+
+    deque<future<string>>   pending;
+    deque<History_Entry>    ready;
+    unordered_set<string>   seen;
+    size_t                  offset  {0};
+    size_t                  total   {0};
+    bool                    known     {false};
+    bool                    finished  {false};
+  };
+
+
+
+  H::History_Reader  (Kraken_API const &K,
+                      Kind const kind,
+                      Kraken_API::Options options,
+                      size_t const prefetch)
+    :  implementation {make_unique<Implementation> (K, kind, move (options),
+                                                    prefetch)}
+  {}
+
+
+  H::~History_Reader  ()  =  default;
+
+
+  bool  H::next  (History_Entry &out)
+  {   return implementation->next (out);   }
+
+
+  size_t  H::count  ()  const
+  {   return implementation->total;   }
+
+
+
+  vector<History_Entry>  backfill_history  (Kraken_API const &K,
+                                            H::Kind const kind,
+                                            Kraken_API::Options const &O,
+                                            int64_t const start,
+                                            int64_t const end,
+                                            size_t windows,
+                                            size_t const concurrency)
+  {
+    windows  =  max (size_t {1},  min (windows,  size_t (max (end - start,
+                                                              int64_t {1}))));
+
+    auto  results  =  vector<vector<History_Entry>> (windows);
+    auto  failure  =  exception_ptr {};
+    auto  next     =  atomic<size_t> {0};
+    auto  lock     =  mutex {};
+
+    /*  Kraken takes the start as exclusive and the end as inclusive, so
+     *  the windows meet without overlapping.  */
+    auto  edge  =  [=] (size_t const i)
+      {
+        return  i == windows  ?  end
+                              :  start + (end - start) * int64_t (i)
+                                                       / int64_t (windows);
+      };
+
+    auto  work  =  [&] ()
+      {
+        for (auto i = next++;  i < windows;  i = next++)
+          try
+            {
+              auto  options  =  O;
+              options.set (Kraken_API::START, edge (i))
+                     .set (Kraken_API::END,   edge (i + 1));
+
+              auto  R  =  History_Reader {K, kind, move (options), 1};
+              auto  E  =  History_Entry {};
+              while (R.next (E))   results [i].push_back (move (E));
+            }
+          catch (...)
+            {
+              auto  guard  =  lock_guard<mutex> {lock};
+              if (! failure)   failure  =  current_exception ();
+              next  =  windows;
+            }
+      };
+
+    auto  threads  =  vector<thread> {};
+    for (auto t = size_t {1};  t < min (concurrency, windows);  ++t)
+      threads.emplace_back (work);
+    work ();
+    for (auto &T  :  threads)   T.join ();
+
+    if (failure)   rethrow_exception (failure);
+
+    auto  ret   =  vector<History_Entry> {};
+    auto  seen  =  unordered_set<string> {};
+    for (auto w = windows;  w-- > 0;  )
+      for (auto &E  :  results [w])
+        if (seen.insert (E.id).second)
+          ret.push_back (move (E));
+
+    return ret;
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,263 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DMBCS_KRAKEN_API__JSON_READER__H
+#define DMBCS_KRAKEN_API__JSON_READER__H
+
+
+/*  Not installed: used inside the library to pull values straight out of
+ *  the text of Krakenʼs responses, without building any intermediate
+ *  representation of them.  */
+
+
+#include <dmbcs-kraken-decimal.h>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  using namespace std;
+
+
+  class  Json_Reader
+  {
+  public:
+
+    explicit  Json_Reader  (string_view  T)  :  text {T}
+    {}
+
+
+    /*  The next significant character, or NUL at the end of the text. */
+    char  peek  ()
+    {
+      skip_space ();
+      return  at < text.length ()  ?  text [at]  :  '\0';
+    }
+
+
+    bool  consume  (char const c)
+    {
+      if (peek ()  !=  c)   return false;
+      ++at;
+      return true;
+    }
+
+
+    void  expect  (char const c)
+    {
+      if (! consume (c))
+        fail (string {"expected '"} + c + "'");
+    }
+
+
+    /*  For iterating over the members of an object or array which has
+     *  been opened, in the form
+
+     *       for (auto more = ! R.consume (']');  more;  more = R.more (']'))
+
+     */
+    bool  more  (char const close)
+    {
+      if (consume (','))   return true;
+      expect (close);
+      return false;
+    }
+
+
+    /*  The raw text between the quotes, with any escapes left in. */
+    string_view  string_value  ()
+    {
+      expect ('"');
+
+      auto const  start  =  at;
+      while (at < text.length ()  &&  text [at] != '"')
+        at  +=  text [at] == '\\'  ?  2  :  1;
+
+      if (at >= text.length ())   fail ("unterminated string");
+
+      return  text.substr (start, at++ - start);
+    }
+
+
+    /*  Kraken sends most numbers as strings, to preserve their precision;
+     *  this takes them either way, into arithmetic types or Decimal.  */
+    template <typename T>
+    T  number  ()
+    {
+      auto const  quoted  =  consume ('"');
+
+      skip_space ();
+
+      auto  ret  =  T {};
+      auto const  [end, error]  =  parse_number (text.data () + at,
+                                                 text.data () + text.length (),
+                                                 ret);
+      if (error != errc {})   fail ("expected a number");
+
+      at  =  end - text.data ();
+
+      if constexpr (is_integral_v<T>)
+        /*  Whole seconds, sometimes written as decimals. */
+        if (at < text.length ()  &&  text [at] == '.')
+          for (++at;  at < text.length () && isdigit_ (text [at]);  ++at);
+
+      if (quoted)   expect ('"');
+
+      return  ret;
+    }
+
+
+    /*  Step over any value at all. */
+    void  skip  ()
+    {
+      switch (peek ())
+        {
+        case '"':
+          string_value ();
+          break;
+
+        case '{':
+          ++at;
+          for (auto more = ! consume ('}');  more;  more = this->more ('}'))
+            {
+              string_value ();
+              expect (':');
+              skip ();
+            }
+          break;
+
+        case '[':
+          ++at;
+          for (auto more = ! consume (']');  more;  more = this->more (']'))
+            skip ();
+          break;
+
+        default:
+          {
+            auto const  start  =  at;
+            while (at < text.length ()  &&  text [at] != ','
+                       &&  text [at] != '}'  &&  text [at] != ']'
+                       &&  ! isspace_ (text [at]))
+              ++at;
+            if (at == start)   fail ("expected a value");
+          }
+          break;
+        }
+    }
+
+
+    /*  The text of the next value, whatever it is, stepping over it. */
+    string_view  raw  ()
+    {
+      skip_space ();
+      auto const  start  =  at;
+      skip ();
+      return  text.substr (start, at - start);
+    }
+
+
+    [[noreturn]]  void  fail  (string const &why)  const
+    {
+      throw runtime_error {"malformed response from Kraken at offset "
+                           +  to_string (at)  +  ": "  +  why};
+    }
+
+
+  private:
+
+    static  bool  isspace_  (char const c)
+    {   return  c == ' '  ||  c == '\n'  ||  c == '\r'  ||  c == '\t';   }
+
+    static  bool  isdigit_  (char const c)
+    {   return  c >= '0'  &&  c <= '9';   }
+
+    /*  Decimals are kept at the scale they are written in. */
+    template <typename T>
+    static  from_chars_result  parse_number  (char const *const first,
+                                              char const *const last,
+                                              T &value)
+    {
+      if constexpr (is_same_v<T, Decimal>)
+        return  Decimal::from_chars (first, last, value);
+      else
+        return  from_chars (first, last, value);
+    }
+
+    void  skip_space  ()
+    {
+      while (at < text.length ()  &&  isspace_ (text [at]))   ++at;
+    }
+
+
+    string_view  text;
+    size_t       at  {0};
+
+  };  /*  End of class Json_Reader.  */
+
+
+  /*  Read the {"error": [...], "result": ...} wrapper around every
+   *  response, handing the reader to on_result when it is positioned at
+   *  the start of the result (unless there are errors before it), and
+   *  returning the errors.  Entries in the error array which start with
+   *  ‘W’ are only warnings, and are left out.  */
+
+  template <typename F>
+  vector<string>  envelope_errors  (string_view json,  F on_result)
+  {
+    auto  R       =  Json_Reader {json};
+    auto  errors  =  vector<string> {};
+
+    R.expect ('{');
+    for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+      {
+        auto const  key  =  R.string_value ();
+        R.expect (':');
+
+        if (key == "error")
+          {
+            R.expect ('[');
+            for (auto m = ! R.consume (']');  m;  m = R.more (']'))
+              {
+                auto const  E  =  R.string_value ();
+                if (! E.empty ()  &&  E [0] != 'W')
+                  errors.emplace_back (E);
+              }
+          }
+        else if (key == "result"  &&  errors.empty ())
+          on_result (R);
+        else
+          R.skip ();
+      }
+
+    return errors;
+  }
+
+
+}  /* End of namespace DMBCS. */
+
+
+#endif   /* Undefined  DMBCS_KRAKEN_API__JSON_READER__H.  */
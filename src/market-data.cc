@@ -0,0 +1,519 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-market.h>
+#include <json-reader.h>
+#include <algorithm>
+
+
+namespace  DMBCS  {
+
+
+  static  string  join  (vector<string> const &messages)
+  {
+    auto  ret  =  string {};
+    for (auto const &M  :  messages)
+      {
+        if (! ret.empty ())   ret  +=  "; ";
+        ret  +=  M;
+      }
+    return ret;
+  }
+
+
+  Kraken_Error::Kraken_Error  (vector<string> M)
+    :  runtime_error {join (M)},  messages {move (M)}
+  {}
+
+
+  Cancel_Orders_Error::Cancel_Orders_Error  (vector<string> M,
+                                             size_t const count,
+                                             vector<string> failed)
+    :  Kraken_Error {move (M)},  count {count},  failed {move (failed)}
+  {}
+
+
+
+  /*  Read the {"error": [...], "result": ...} wrapper around every
+   *  response, handing the reader to on_result when it is positioned at
+   *  the start of the result.  */
+
+  template <typename F>
+  static  void  read_envelope  (string_view json,  F on_result)
+  {
+    auto  errors  =  envelope_errors (json, on_result);
+
+    if (! errors.empty ())
+      throw Kraken_Error {move (errors)};
+  }
+
+
+
+  void  check_errors  (string_view json)
+  {   read_envelope (json, [] (Json_Reader &R) { R.skip (); });   }
+
+
+
+  /*  Most market results are an object with one member named after the
+   *  pair, and perhaps one called "last".  */
+
+  template <typename F>
+  static  int64_t  read_pair_result  (Json_Reader &R,
+                                      string &pair,
+                                      F on_pair)
+  {
+    auto  last  =  int64_t {0};
+
+    R.expect ('{');
+    for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+      {
+        auto const  key  =  R.string_value ();
+        R.expect (':');
+
+        if (key == "last")
+          last  =  R.number<int64_t> ();
+        else if (pair.empty ())
+          {
+            pair  =  key;
+            on_pair (R);
+          }
+        else
+          R.skip ();
+      }
+
+    return last;
+  }
+
+
+
+  /*  Anything after the fields we know about, up to the close of the
+   *  array. */
+  static  void  skip_rest  (Json_Reader &R)
+  {
+    while (R.more (']'))   R.skip ();
+  }
+
+
+  static  char  first_char  (Json_Reader &R)
+  {
+    auto const  S  =  R.string_value ();
+    return  S.empty ()  ?  '\0'  :  S [0];
+  }
+
+
+
+  template <typename Number>
+  static  void  read_levels  (Json_Reader &R,
+                              vector<Basic_Order_Book_Level<Number>> &levels)
+  {
+    R.expect ('[');
+    for (auto more = ! R.consume (']');  more;  more = R.more (']'))
+      {
+        auto  L  =  Basic_Order_Book_Level<Number> {};
+        R.expect ('[');
+        L.price   =  R.number<Number> ();   R.expect (',');
+        L.volume  =  R.number<Number> ();   R.expect (',');
+        L.time    =  R.number<double> ();
+        skip_rest (R);
+        levels.push_back (L);
+      }
+  }
+
+
+
+  template <typename Number>
+  Basic_Order_Book<Number>  parse_order_book  (string_view json)
+  {
+    auto  ret  =  Basic_Order_Book<Number> {};
+
+    read_envelope (json,  [&ret] (Json_Reader &R)
+      {
+        read_pair_result (R,  ret.pair,  [&ret] (Json_Reader &R)
+          {
+            R.expect ('{');
+            for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+              {
+                auto const  side  =  R.string_value ();
+                R.expect (':');
+                if      (side == "asks")   read_levels (R, ret.asks);
+                else if (side == "bids")   read_levels (R, ret.bids);
+                else                       R.skip ();
+              }
+          });
+      });
+
+    return ret;
+  }
+
+
+
+  template <typename Number>
+  Basic_Recent_Trades<Number>  parse_recent_trades  (string_view json)
+  {
+    auto  ret  =  Basic_Recent_Trades<Number> {};
+
+    read_envelope (json,  [&ret] (Json_Reader &R)
+      {
+        ret.last  =  read_pair_result (R,  ret.pair,  [&ret] (Json_Reader &R)
+          {
+            R.expect ('[');
+            for (auto more = ! R.consume (']');  more;  more = R.more (']'))
+              {
+                R.expect ('[');
+                ret.price.push_back       (R.number<Number> ());
+                R.expect (',');
+                ret.volume.push_back      (R.number<Number> ());
+                R.expect (',');
+                ret.time.push_back        (R.number<double> ());
+                R.expect (',');
+                ret.side.push_back        (first_char (R));
+                R.expect (',');
+                ret.order_type.push_back  (first_char (R));
+                skip_rest (R);
+              }
+          });
+      });
+
+    return ret;
+  }
+
+
+
+  template <typename Number>
+  Basic_OHLC_Series<Number>  parse_ohlc_data  (string_view json)
+  {
+    auto  ret  =  Basic_OHLC_Series<Number> {};
+
+    read_envelope (json,  [&ret] (Json_Reader &R)
+      {
+        ret.last  =  read_pair_result (R,  ret.pair,  [&ret] (Json_Reader &R)
+          {
+            R.expect ('[');
+            for (auto more = ! R.consume (']');  more;  more = R.more (']'))
+              {
+                auto  B  =  Basic_OHLC_Bar<Number> {};
+                R.expect ('[');
+                B.time    =  R.number<int64_t> ();   R.expect (',');
+                B.open    =  R.number<Number>  ();   R.expect (',');
+                B.high    =  R.number<Number>  ();   R.expect (',');
+                B.low     =  R.number<Number>  ();   R.expect (',');
+                B.close   =  R.number<Number>  ();   R.expect (',');
+                B.vwap    =  R.number<Number>  ();   R.expect (',');
+                B.volume  =  R.number<Number>  ();   R.expect (',');
+                B.count   =  R.number<int64_t> ();
+                skip_rest (R);
+                ret.bars.push_back (B);
+              }
+          });
+      });
+
+    return ret;
+  }
+
+
+
+  template <typename Number>
+  Basic_Spread_Series<Number>  parse_spread_data  (string_view json)
+  {
+    auto  ret  =  Basic_Spread_Series<Number> {};
+
+    read_envelope (json,  [&ret] (Json_Reader &R)
+      {
+        ret.last  =  read_pair_result (R,  ret.pair,  [&ret] (Json_Reader &R)
+          {
+            R.expect ('[');
+            for (auto more = ! R.consume (']');  more;  more = R.more (']'))
+              {
+                auto  S  =  Basic_Spread_Entry<Number> {};
+                R.expect ('[');
+                S.time  =  R.number<int64_t> ();   R.expect (',');
+                S.bid   =  R.number<Number>  ();   R.expect (',');
+                S.ask   =  R.number<Number>  ();
+                skip_rest (R);
+                ret.entries.push_back (S);
+              }
+          });
+      });
+
+    return ret;
+  }
+
+
+
+  /*  The result is an object with a "count" and one other member (named
+   *  "trades", "closed" or "ledger") holding the entries, keyed by ID. */
+  History_Page  parse_history_page  (string_view json)
+  {
+    auto  ret  =  History_Page {};
+
+    read_envelope (json,  [&ret] (Json_Reader &R)
+      {
+        R.expect ('{');
+        for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+          {
+            auto const  key  =  R.string_value ();
+            R.expect (':');
+
+            if (key == "count")
+              {
+                ret.count  =  R.number<size_t> ();
+                continue;
+              }
+
+            if (R.peek () != '{')   {  R.skip ();  continue;  }
+
+            R.expect ('{');
+            for (auto m = ! R.consume ('}');  m;  m = R.more ('}'))
+              {
+                auto  E  =  History_Entry {};
+                E.id  =  R.string_value ();
+                R.expect (':');
+                E.json  =  R.raw ();
+
+                auto  D  =  Json_Reader {E.json};
+                D.expect ('{');
+                for (auto d = ! D.consume ('}');  d;  d = D.more ('}'))
+                  {
+                    auto const  field  =  D.string_value ();
+                    D.expect (':');
+                    if ((field == "time"  ||  field == "closetm")
+                           &&  D.peek () != 'n')
+                      E.time  =  D.number<double> ();
+                    else
+                      D.skip ();
+                  }
+
+                ret.entries.push_back (move (E));
+              }
+          }
+      });
+
+    return ret;
+  }
+
+
+
+  /*  The result is an object of the pairs keyed by name. */
+  vector<Asset_Pair>  parse_asset_pairs  (string_view json)
+  {
+    auto  ret  =  vector<Asset_Pair> {};
+
+    read_envelope (json,  [&ret] (Json_Reader &R)
+      {
+        R.expect ('{');
+        for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+          {
+            auto  P  =  Asset_Pair {};
+            P.name  =  R.string_value ();
+            R.expect (':');
+
+            R.expect ('{');
+            for (auto m = ! R.consume ('}');  m;  m = R.more ('}'))
+              {
+                auto const  field  =  R.string_value ();
+                R.expect (':');
+                if      (field == "altname")   P.altname  =  R.string_value ();
+                else if (field == "wsname")    P.wsname   =  R.string_value ();
+                else if (field == "pair_decimals")
+                  P.pair_decimals  =  R.number<int> ();
+                else if (field == "lot_decimals")
+                  P.lot_decimals   =  R.number<int> ();
+                else if (field == "ordermin")
+                  P.ordermin       =  R.number<Decimal> ();
+                else
+                  R.skip ();
+              }
+
+            ret.push_back (move (P));
+          }
+      });
+
+    return ret;
+  }
+
+
+
+  Asset_Pairs::Asset_Pairs  (vector<Asset_Pair> P)  :  all {move (P)}
+  {
+    for (auto i  =  size_t {0};  i < all.size ();  ++i)
+      for (auto const *const N  :  {&all [i].name,  &all [i].altname,
+                                    &all [i].wsname})
+        if (! N->empty ())   index.emplace_back (*N, i);
+
+    sort (index.begin (),  index.end ());
+    index.erase (unique (index.begin (),  index.end ()),  index.end ());
+  }
+
+
+
+  bool  Asset_Pairs::contains  (string_view const pair)  const
+  {
+    auto const  i  =  lower_bound (index.begin (),  index.end (),  pair,
+                                   [] (auto const &E, string_view const N)
+                                     {  return E.first < N;  });
+    return  i != index.end ()  &&  i->first == pair;
+  }
+
+
+
+  Asset_Pair const &
+  Asset_Pairs::operator[]  (string_view const pair)  const
+  {
+    auto const  i  =  lower_bound (index.begin (),  index.end (),  pair,
+                                   [] (auto const &E, string_view const N)
+                                     {  return E.first < N;  });
+    if (i == index.end ()  ||  i->first != pair)
+      throw out_of_range {"unknown asset pair " + string {pair}};
+
+    return all [i->second];
+  }
+
+
+
+  Decimal  Asset_Pairs::price  (string_view const pair,
+                                Decimal const value,
+                                Decimal::Rounding const rounding)  const
+  {   return  value.rescale ((*this) [pair].pair_decimals,  rounding);   }
+
+  Decimal  Asset_Pairs::price  (string_view const pair,
+                                double const value)  const
+  {   return  Decimal::from_double (value, (*this) [pair].pair_decimals);   }
+
+  Decimal  Asset_Pairs::volume  (string_view const pair,
+                                 Decimal const value,
+                                 Decimal::Rounding const rounding)  const
+  {   return  value.rescale ((*this) [pair].lot_decimals,  rounding);   }
+
+  Decimal  Asset_Pairs::volume  (string_view const pair,
+                                 double const value)  const
+  {   return  Decimal::from_double (value, (*this) [pair].lot_decimals);   }
+
+
+
+  /*  Parse the reply, timing it if the object keeps metrics. */
+  template <typename F>
+  static  auto  parse  (Kraken_API const &K,
+                        string_view const function,
+                        F const &parser,
+                        string const &reply)
+  {
+    if (! K.metrics)   return parser (reply);
+
+    auto const  start  =  chrono::steady_clock::now ();
+    auto  ret  =  parser (reply);
+    K.metrics->record (function,  Request_Metrics::PARSING,
+                       chrono::steady_clock::now () - start);
+    return ret;
+  }
+
+
+
+  template <typename Number>
+  Basic_Order_Book<Number>
+  fetch_order_book  (Kraken_API const &K,  Kraken_API::Options const &O,
+                     string const &pair)
+  {
+    return  parse (K, "Depth", parse_order_book<Number>,
+                   K.order_book (O, pair));
+  }
+
+  template <typename Number>
+  Basic_Recent_Trades<Number>
+  fetch_recent_trades  (Kraken_API const &K,  Kraken_API::Options const &O,
+                        string const &pair)
+  {
+    return  parse (K, "Trades", parse_recent_trades<Number>,
+                   K.recent_trades (O, pair));
+  }
+
+  template <typename Number>
+  Basic_OHLC_Series<Number>
+  fetch_ohlc_data  (Kraken_API const &K,  Kraken_API::Options const &O,
+                    string const &pair)
+  {
+    return  parse (K, "OHLC", parse_ohlc_data<Number>,
+                   K.ohlc_data (O, pair));
+  }
+
+  template <typename Number>
+  Basic_Spread_Series<Number>
+  fetch_spread_data  (Kraken_API const &K,  Kraken_API::Options const &O,
+                      string const &pair)
+  {
+    return  parse (K, "Spread", parse_spread_data<Number>,
+                   K.spread_data (O, pair));
+  }
+
+  vector<Asset_Pair>
+  fetch_asset_pairs  (Kraken_API const &K,  Kraken_API::Options const &O)
+  {   return parse (K, "AssetPairs", parse_asset_pairs, K.asset_pairs (O));  }
+
+
+
+  /*  The templates above are made here for the two kinds of number. */
+
+  template  Order_Book
+  parse_order_book<double>  (string_view);
+  template  Recent_Trades
+  parse_recent_trades<double>  (string_view);
+  template  OHLC_Series
+  parse_ohlc_data<double>  (string_view);
+  template  Spread_Series
+  parse_spread_data<double>  (string_view);
+
+  template  Order_Book
+  fetch_order_book<double>  (Kraken_API const &,
+                             Kraken_API::Options const &,  string const &);
+  template  Recent_Trades
+  fetch_recent_trades<double>  (Kraken_API const &,
+                                Kraken_API::Options const &,  string const &);
+  template  OHLC_Series
+  fetch_ohlc_data<double>  (Kraken_API const &,
+                            Kraken_API::Options const &,  string const &);
+  template  Spread_Series
+  fetch_spread_data<double>  (Kraken_API const &,
+                              Kraken_API::Options const &,  string const &);
+
+  template  Exact_Order_Book
+  parse_order_book<Decimal>  (string_view);
+  template  Exact_Recent_Trades
+  parse_recent_trades<Decimal>  (string_view);
+  template  Exact_OHLC_Series
+  parse_ohlc_data<Decimal>  (string_view);
+  template  Exact_Spread_Series
+  parse_spread_data<Decimal>  (string_view);
+
+  template  Exact_Order_Book
+  fetch_order_book<Decimal>  (Kraken_API const &,
+                              Kraken_API::Options const &,  string const &);
+  template  Exact_Recent_Trades
+  fetch_recent_trades<Decimal>  (Kraken_API const &,
+                                 Kraken_API::Options const &,  string const &);
+  template  Exact_OHLC_Series
+  fetch_ohlc_data<Decimal>  (Kraken_API const &,
+                             Kraken_API::Options const &,  string const &);
+  template  Exact_Spread_Series
+  fetch_spread_data<Decimal>  (Kraken_API const &,
+                               Kraken_API::Options const &,  string const &);
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,438 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-api.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Request_Metrics  M;
+
+
+
+  /*  The API functions the library calls, each given a row of the table,
+   *  and a last row for anything else.  */
+  static constexpr array<string_view, 28>  FUNCTIONS
+    {{
+      "Time", "Assets", "AssetPairs", "Ticker", "OHLC", "Depth", "Trades",
+      "Spread",
+      "Balance", "TradeBalance", "OpenOrders", "ClosedOrders",
+      "QueryOrders", "TradesHistory", "QueryTrades", "OpenPositions",
+      "Ledgers", "QueryLedgers", "TradeVolume",
+      "AddOrder", "AddOrderBatch", "CancelOrder", "CancelOrderBatch",
+      "CancelAll", "CancelAllOrdersAfter", "EditOrder",
+      "GetWebSocketsToken",
+      "other"
+    }};
+
+
+  static constexpr array<char const*, M::__PHASES>  PHASE_NAMES
+    {{"name_lookup", "connect", "tls", "first_byte", "total", "signing",
+      "parsing"}};
+
+
+  static  size_t  row  (string_view const function)
+  {
+    return  size_t (find (FUNCTIONS.begin (),  FUNCTIONS.end () - 1,
+                          function)
+                       -  FUNCTIONS.begin ());
+  }
+
+
+
+  struct  Atomic_Histogram
+  {
+    void  add  (chrono::nanoseconds const t)
+    {
+      auto const  ns  =  uint64_t (max (t.count (),  int64_t {0}));
+      auto const  b   =  lower_bound (M::BUCKETS.begin (),
+                                      M::BUCKETS.end (),
+                                      ns,
+                                      [] (uint32_t const bound,
+                                          uint64_t const x)
+                                          {  return bound * 1000ull < x;  })
+                           -  M::BUCKETS.begin ();
+
+      counts [b].fetch_add (1, memory_order_relaxed);
+      sum.fetch_add (ns, memory_order_relaxed);
+    }
+
+
+    M::Histogram  read  ()  const
+    {
+      auto  ret  =  M::Histogram {};
+      for (auto b = size_t {0};  b < counts.size ();  ++b)
+        {
+          ret.counts [b]  =  counts [b].load (memory_order_relaxed);
+          ret.count      +=  ret.counts [b];
+        }
+      ret.sum  =  chrono::nanoseconds {sum.load (memory_order_relaxed)};
+      return ret;
+    }
+
+
+    array<atomic<uint64_t>, M::BUCKETS.size () + 1>  counts  {};
+    atomic<uint64_t>                                 sum     {0};
+  };
+
+
+
+  struct  Endpoint
+  {
+    array<Atomic_Histogram, M::__PHASES>  phases;
+
+    atomic<uint64_t>  requests  {0};
+    atomic<uint64_t>  sent      {0};
+    atomic<uint64_t>  received  {0};
+    atomic<uint64_t>  retries   {0};
+    atomic<uint64_t>  failures  {0};
+
+
+    bool  used  ()  const
+    {
+      return  requests  ||  retries  ||  failures
+                ||  any_of (phases.begin (),  phases.end (),
+                            [] (Atomic_Histogram const &H)
+                                {  return H.read ().count > 0;  });
+    }
+  };
+
+
+
+  /*  Counts of error codes, in an open-addressed table whose slots, once
+   *  claimed by a compare-and-swap on the key, are never given up.  The
+   *  claiming thread fills in the text and then marks the slot ready.  */
+
+  struct  Error_Slot
+  {
+    atomic<uint64_t>  key       {0};
+    atomic<bool>      ready     {false};
+    uint8_t           function  {0};
+    array<char, 64>   code      {};
+    atomic<uint64_t>  count     {0};
+  };
+
+
+  static  uint64_t  error_key  (size_t const function,
+                                string_view const code)
+  {
+    auto  h  =  uint64_t {14695981039346656037ull};
+    for (auto const c  :  code)
+      h  =  (h ^ uint8_t (c)) * 1099511628211ull;
+    h  =  (h ^ function) * 1099511628211ull;
+    return  h  ?  h  :  1;
+  }
+
+
+
+  /*  Hand each string in the error array at the head of a reply to f,
+   *  without parsing the rest.  */
+  template <typename F>
+  static  void  for_each_error  (string_view const reply,  F const &f)
+  {
+    auto  at  =  reply.find ("\"error\"");
+    if (at == reply.npos)   return;
+
+    at  =  reply.find_first_not_of (" \t\r\n:",  at + 7);
+    if (at == reply.npos  ||  reply [at] != '[')   return;
+
+    while (++at < reply.length ()  &&  reply [at] != ']')
+      {
+        if (reply [at] != '"')   continue;
+
+        auto  end  =  ++at;
+        while (end < reply.length ()  &&  reply [end] != '"')
+          end  +=  reply [end] == '\\'  ?  2  :  1;
+        if (end >= reply.length ())   return;
+
+        f (reply.substr (at,  end - at));
+        at  =  end;
+      }
+  }
+
+
+
+  struct  M::Implementation
+  {
+    static constexpr size_t  ERROR_SLOTS  =  256;
+
+
+    Error_Slot  *find  (size_t const function,
+                        string_view const code,
+                        bool const claim)
+    {
+      auto const  C    =  code.substr (0,  Error_Slot {}.code.size () - 1);
+      auto const  key  =  error_key (function, C);
+
+      for (auto n = size_t {0};  n < ERROR_SLOTS;  ++n)
+        {
+          auto &S  =  errors [(key + n) % ERROR_SLOTS];
+          auto  k  =  S.key.load (memory_order_acquire);
+
+          if (k == 0  &&  claim
+                &&  S.key.compare_exchange_strong (k, key,
+                                                   memory_order_acq_rel))
+            {
+              S.function  =  uint8_t (function);
+              copy (C.begin (),  C.end (),  S.code.begin ());
+              S.ready.store (true,  memory_order_release);
+              return &S;
+            }
+
+          if (k == key)   return &S;
+          if (k == 0)     return nullptr;
+        }
+
+      return nullptr;
+    }
+
+
+    array<Endpoint, FUNCTIONS.size ()>  endpoints;
+    array<Error_Slot, ERROR_SLOTS>      errors;
+
+    /*  Those for which there was no room in the table. */
+    atomic<uint64_t>                    errors_dropped  {0};
+  };
+
+
+
+  M::Request_Metrics  ()  :  implementation {make_unique<Implementation> ()}
+  {}
+
+
+  M::~Request_Metrics  ()  =  default;
+
+
+
+  void  M::record  (string_view const function,  Transfer const &T)
+  {
+    auto &E  =  implementation->endpoints [row (function)];
+
+    E.requests.fetch_add (1, memory_order_relaxed);
+    E.sent.fetch_add (T.sent, memory_order_relaxed);
+    E.received.fetch_add (T.received, memory_order_relaxed);
+
+    if (T.new_connection)
+      {
+        E.phases [NAME_LOOKUP].add (T.name_lookup);
+        E.phases [CONNECT].add (T.connect);
+        if (T.tls.count ())   E.phases [TLS].add (T.tls);
+      }
+
+    E.phases [FIRST_BYTE].add (T.first_byte);
+    E.phases [TOTAL].add (T.total);
+  }
+
+
+
+  void  M::record  (string_view const function,
+                    Phase const P,
+                    chrono::nanoseconds const t)
+  {   implementation->endpoints [row (function)].phases [P].add (t);   }
+
+
+
+  void  M::record_retry  (string_view const function)
+  {
+    implementation->endpoints [row (function)]
+                      .retries.fetch_add (1, memory_order_relaxed);
+  }
+
+
+
+  void  M::record_failure  (string_view const function)
+  {
+    implementation->endpoints [row (function)]
+                      .failures.fetch_add (1, memory_order_relaxed);
+  }
+
+
+
+  void  M::record_errors  (string_view const function,
+                           string_view const reply)
+  {
+    auto &I  =  *implementation;
+    auto const  r  =  row (function);
+
+    for_each_error (reply,  [&I, r] (string_view const code)
+      {
+        if (auto *const  S  =  I.find (r, code, true))
+          S->count.fetch_add (1, memory_order_relaxed);
+        else
+          I.errors_dropped.fetch_add (1, memory_order_relaxed);
+      });
+  }
+
+
+
+  M::Histogram  M::histogram  (string_view const function,
+                               Phase const P)  const
+  {   return implementation->endpoints [row (function)].phases [P].read ();  }
+
+
+
+  uint64_t  M::errors  (string_view const function,
+                        string_view const code)  const
+  {
+    auto *const  S  =  implementation->find (row (function), code, false);
+    return  S  ?  S->count.load (memory_order_relaxed)  :  0;
+  }
+
+
+
+  /*  Exact decimal text of a number of microseconds, as seconds. */
+  static  string  seconds  (uint64_t const us)
+  {
+    auto  ret  =  to_string (us / 1'000'000);
+    if (auto  f  =  us % 1'000'000)
+      {
+        auto  fraction  =  to_string (f + 1'000'000).substr (1);
+        fraction.erase (fraction.find_last_not_of ('0') + 1);
+        ret  +=  '.' + fraction;
+      }
+    return ret;
+  }
+
+
+  static  string  seconds  (chrono::nanoseconds const t)
+  {
+    auto const  ns  =  uint64_t (t.count ());
+    auto  ret  =  to_string (ns / 1'000'000'000);
+    auto  fraction  =  to_string (ns % 1'000'000'000 + 1'000'000'000)
+                           .substr (1);
+    fraction.erase (fraction.find_last_not_of ('0') + 1);
+    if (! fraction.empty ())   ret  +=  '.' + fraction;
+    return ret;
+  }
+
+
+  /*  A label value from the text of a JSON string. */
+  static  string  label  (string_view const json)
+  {
+    auto  ret  =  string {};
+    for (auto i = size_t {0};  i < json.length ();  ++i)
+      {
+        auto  c  =  json [i];
+        if (c == '\\'  &&  i + 1 < json.length ())
+          {
+            c  =  json [++i];
+            if (c == 'n')   {  ret  +=  "\\n";   continue;  }
+          }
+        if (c == '\\'  ||  c == '"')   ret  +=  '\\';
+        ret  +=  c;
+      }
+    return ret;
+  }
+
+
+
+  string  M::prometheus  ()  const
+  {
+    auto &I  =  *implementation;
+    auto  out  =  string {};
+
+    auto const  counter  =  [&I, &out] (char const *const name,
+                                        char const *const help,
+                                        atomic<uint64_t> Endpoint::*const C)
+      {
+        out  +=  string {"# HELP "} + name + ' ' + help + '\n';
+        out  +=  string {"# TYPE "} + name + " counter\n";
+        for (auto e = size_t {0};  e < FUNCTIONS.size ();  ++e)
+          if (I.endpoints [e].used ())
+            out  +=  string {name} + "{function=\""
+                       +  string {FUNCTIONS [e]} + "\"} "
+                       +  to_string ((I.endpoints [e].*C)
+                                       .load (memory_order_relaxed))
+                       +  '\n';
+      };
+
+    out  +=  "# HELP kraken_request_duration_seconds Time taken by each "
+             "phase of requests to the Kraken API.\n"
+             "# TYPE kraken_request_duration_seconds histogram\n";
+
+    for (auto e = size_t {0};  e < FUNCTIONS.size ();  ++e)
+      for (auto p = size_t {0};  p < __PHASES;  ++p)
+        {
+          auto const  H  =  I.endpoints [e].phases [p].read ();
+          if (! H.count)   continue;
+
+          auto const  labels  =  "{function=\"" + string {FUNCTIONS [e]}
+                                   +  "\",phase=\"" + PHASE_NAMES [p] + '"';
+          auto  cumulative  =  uint64_t {0};
+
+          for (auto b = size_t {0};  b < H.counts.size ();  ++b)
+            {
+              cumulative  +=  H.counts [b];
+              out  +=  "kraken_request_duration_seconds_bucket" + labels
+                         +  ",le=\""
+                         +  (b < BUCKETS.size ()  ?  seconds (BUCKETS [b])
+                                                  :  string {"+Inf"})
+                         +  "\"} " + to_string (cumulative) + '\n';
+            }
+
+          out  +=  "kraken_request_duration_seconds_sum" + labels + "} "
+                     +  seconds (H.sum) + '\n';
+          out  +=  "kraken_request_duration_seconds_count" + labels + "} "
+                     +  to_string (H.count) + '\n';
+        }
+
+    counter ("kraken_requests_total",
+             "Requests to the Kraken API which got a reply.",
+             &Endpoint::requests);
+    counter ("kraken_sent_bytes_total",
+             "Bytes sent in requests, headers included.",
+             &Endpoint::sent);
+    counter ("kraken_received_bytes_total",
+             "Bytes received in replies, headers included.",
+             &Endpoint::received);
+    counter ("kraken_retries_total",
+             "Requests made again after a failure.",
+             &Endpoint::retries);
+    counter ("kraken_transport_failures_total",
+             "Requests which got no reply.",
+             &Endpoint::failures);
+
+    out  +=  "# HELP kraken_errors_total Error codes in replies from "
+             "Kraken.\n"
+             "# TYPE kraken_errors_total counter\n";
+
+    for (auto const &S  :  I.errors)
+      if (S.ready.load (memory_order_acquire))
+        out  +=  "kraken_errors_total{function=\""
+                   +  string {FUNCTIONS [S.function]} + "\",code=\""
+                   +  label (S.code.data ()) + "\"} "
+                   +  to_string (S.count.load (memory_order_relaxed))
+                   +  '\n';
+
+    if (auto const  d  =  I.errors_dropped.load (memory_order_relaxed))
+      out  +=  "kraken_errors_total{function=\"other\",code=\"other\"} "
+                 +  to_string (d) + '\n';
+
+    return out;
+  }
+
+
+}  /* End of namespace DMBCS. */
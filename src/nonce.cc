@@ -0,0 +1,163 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-api.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Nonce_Source  N;
+
+  /*  The mapped counter is used by several processes at once, which is
+   *  only sound if it needs no lock.  */
+  static_assert (atomic<uint64_t>::is_always_lock_free,
+                 "nonces shared between processes need lock-free atomics");
+
+
+
+  struct  N::Implementation
+  {
+    Implementation  ()
+      :  wall_start   {chrono::duration_cast<chrono::microseconds>
+                         (chrono::system_clock::now ().time_since_epoch ())
+                             .count ()},
+         steady_start {chrono::steady_clock::now ()},
+         last         {&own}
+    {}
+
+
+    ~Implementation  ()
+    {
+      if (mapped)   munmap (mapped, sizeof (atomic<uint64_t>));
+    }
+
+
+    uint64_t  now  ()  const
+    {
+      return  uint64_t (wall_start
+                        +  chrono::duration_cast<chrono::microseconds>
+                              (chrono::steady_clock::now () - steady_start)
+                                 .count ());
+    }
+
+
+    uint64_t  next  ()
+    {
+      auto const  t     =  now ();
+      auto        prev  =  last->load (memory_order_relaxed);
+      auto        ret   =  uint64_t {};
+
+      do
+        ret  =  max (t, prev + 1);
+      while (! last->compare_exchange_weak (prev, ret,
+                                            memory_order_relaxed));
+
+      return ret;
+    }
+
+
+    int64_t const                    wall_start;
+    chrono::steady_clock::time_point const  steady_start;
+
+    atomic<uint64_t>    own     {0};
+    void *              mapped  {nullptr};
+    atomic<uint64_t> *  last;
+  };
+
+
+
+  N::Nonce_Source  ()  :  implementation {make_unique<Implementation> ()}
+  {}
+
+
+
+  N::Nonce_Source  (string const &path)  :  N {}
+  {
+    auto const  fail  =  [&path] (char const *const what)
+      {
+        throw runtime_error {"nonce file " + path + ": " + what + ": "
+                             +  strerror (errno)};
+      };
+
+    auto const  fd  =  open (path.c_str (),  O_RDWR | O_CREAT | O_CLOEXEC,
+                             0600);
+    if (fd < 0)   fail ("cannot open");
+
+    struct stat  status  {};
+    if (fstat (fd, &status)
+          ||  (size_t (status.st_size) < sizeof (atomic<uint64_t>)
+                 &&  ftruncate (fd, sizeof (atomic<uint64_t>))))
+      {
+        close (fd);
+        fail ("cannot size");
+      }
+
+    /*  A new file is all zeros, which is a valid (and the lowest) value.
+     */
+    auto const  M  =  mmap (nullptr,  sizeof (atomic<uint64_t>),
+                            PROT_READ | PROT_WRITE,  MAP_SHARED,  fd,  0);
+    close (fd);
+    if (M == MAP_FAILED)   fail ("cannot map");
+
+    implementation->mapped  =  M;
+    implementation->last    =  static_cast<atomic<uint64_t>*> (M);
+  }
+
+
+
+  N::~Nonce_Source  ()  =  default;
+
+
+
+  shared_ptr<N>  N::process_wide  ()
+  {
+    static  auto const  ret  =  make_shared<N> ();
+    return ret;
+  }
+
+
+
+  uint64_t  N::next  ()
+  {   return implementation->next ();   }
+
+
+
+  string_view  N::next  (Text &buffer)
+  {
+    auto const  end  =  to_chars (buffer.data (),
+                                  buffer.data () + buffer.size () - 1,
+                                  next ()).ptr;
+    *end  =  '\0';
+    return  string_view {buffer.data (),  size_t (end - buffer.data ())};
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,654 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-book.h>
+#include <dmbcs-kraken-endpoints.h>
+#include <json-reader.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Local_Order_Book  B;
+
+  using  Clock  =  chrono::steady_clock;
+
+
+  /*  The checksum covers this many levels of each side. */
+  static  constexpr  size_t  CHECKSUM_LEVELS  =  10;
+
+  /*  Updates which arrive while a snapshot is being fetched are kept, up to
+   *  this many, to be played over it.  */
+  static  constexpr  size_t  MAX_BUFFERED  =  4096;
+
+
+
+  /*  The standard (IEEE 802.3) CRC-32, which is what Kraken uses. */
+
+  static  constexpr  array<uint32_t, 256>  make_crc_table  ()
+  {
+    auto  ret  =  array<uint32_t, 256> {};
+    for (auto n = uint32_t {0};  n < 256;  ++n)
+      {
+        auto  c  =  n;
+        for (auto k = 0;  k < 8;  ++k)
+          c  =  c & 1  ?  0xedb88320u ^ (c >> 1)  :  c >> 1;
+        ret [n]  =  c;
+      }
+    return ret;
+  }
+
+  static  constexpr  auto  CRC_TABLE  =  make_crc_table ();
+
+
+  static  uint32_t  crc32_update  (uint32_t crc,
+                                   char const *b,
+                                   char const *const e)
+  {
+    for (;  b != e;  ++b)
+      crc  =  CRC_TABLE [(crc ^ uint8_t (*b)) & 0xff]  ^  (crc >> 8);
+    return crc;
+  }
+
+
+
+  /*  A decimal string with the point taken out and, if there are fewer
+   *  than scale digits after the point, zeros put on the end; digits
+   *  beyond scale are dropped.  A negative scale is set to the number of
+   *  digits actually present.  */
+  static  int64_t  fixed_point  (string_view const text,  int &scale)
+  {
+    auto  ret       =  int64_t {0};
+    auto  decimals  =  -1;
+
+    for (auto const c  :  text)
+      {
+        if (c == '.')   {  decimals  =  0;  continue;  }
+        if (c < '0'  ||  c > '9')
+          throw runtime_error {"bad decimal number from Kraken: "
+                               +  string {text}};
+        if (decimals >= 0)
+          {
+            if (scale >= 0  &&  decimals == scale)   continue;
+            ++decimals;
+          }
+        ret  =  ret * 10  +  (c - '0');
+      }
+
+    if (decimals < 0)   decimals  =  0;
+    if (scale < 0)      scale  =  decimals;
+    for (;  decimals < scale;  ++decimals)   ret  *=  10;
+
+    return ret;
+  }
+
+
+
+  struct  B::Implementation
+  {
+    /*  Readers may look at these while the writer changes them, so every
+     *  access is atomic, though relaxed: the sequence number is what
+     *  orders them.  */
+    struct  Atomic_Level
+    {
+      atomic<int64_t>  price   {0};
+      atomic<int64_t>  volume  {0};
+    };
+
+    struct  Book_Side
+    {
+      unique_ptr<Atomic_Level []>  level;
+      atomic<size_t>               count  {0};
+    };
+
+
+    /*  One level of an update, before it is applied. */
+    struct  Change
+    {
+      Side     side;
+      int64_t  price;
+      int64_t  volume;
+      double   time;
+    };
+
+
+    Implementation  (Kraken_API const &K,  string P,  size_t const D)
+      :  kraken {K},  rest_pair {move (P)},  depth {max (D, size_t {1})}
+    {
+      for (auto &S  :  sides)
+        S.level  =  make_unique<Atomic_Level []> (depth);
+    }
+
+
+    /*  The seqlock: the sequence is odd while the writer is at work. */
+
+    void  begin_write  ()
+    {
+      sequence.store (sequence.load (memory_order_relaxed) + 1,
+                      memory_order_relaxed);
+      atomic_thread_fence (memory_order_release);
+    }
+
+    void  end_write  ()
+    {
+      sequence.store (sequence.load (memory_order_relaxed) + 1,
+                      memory_order_release);
+    }
+
+    template <typename F>
+    auto  read  (F f)  const
+    {
+      for (;;)
+        {
+          auto const  s  =  sequence.load (memory_order_acquire);
+          if (s & 1)   continue;
+
+          auto  ret  =  f ();
+
+          atomic_thread_fence (memory_order_acquire);
+          if (sequence.load (memory_order_relaxed) == s)
+            return ret;
+        }
+    }
+
+
+    size_t  count  (Side const s)  const
+    {
+      return  min (sides [s].count.load (memory_order_relaxed),  depth);
+    }
+
+    int64_t  price  (Side const s,  size_t const i)  const
+    {   return  sides [s].level [i].price.load (memory_order_relaxed);   }
+
+    int64_t  volume  (Side const s,  size_t const i)  const
+    {   return  sides [s].level [i].volume.load (memory_order_relaxed);   }
+
+
+    /*  The index of the first level not better than price. */
+    size_t  position  (Side const s,  int64_t const p)  const
+    {
+      auto  lo  =  size_t {0};
+      auto  hi  =  count (s);
+      while (lo < hi)
+        {
+          auto const  mid  =  lo + (hi - lo) / 2;
+          auto const  q    =  price (s, mid);
+          if (s == BID  ?  q > p  :  q < p)   lo  =  mid + 1;
+          else                                hi  =  mid;
+        }
+      return lo;
+    }
+
+
+    /*  Must be called between begin_write and end_write. */
+    void  set_level  (Side const s,  int64_t const p,  int64_t const v)
+    {
+      auto &     S  =  sides [s];
+      auto const n  =  count (s);
+      auto const i  =  position (s, p);
+      auto const found  =  i < n  &&  price (s, i) == p;
+
+      auto  move_level  =  [&S] (size_t const to,  size_t const from)
+        {
+          S.level [to].price.store (S.level [from].price
+                                        .load (memory_order_relaxed),
+                                    memory_order_relaxed);
+          S.level [to].volume.store (S.level [from].volume
+                                         .load (memory_order_relaxed),
+                                     memory_order_relaxed);
+        };
+
+      if (v == 0)
+        {
+          if (! found)   return;
+          for (auto j = i;  j + 1 < n;  ++j)   move_level (j, j + 1);
+          S.count.store (n - 1,  memory_order_relaxed);
+        }
+      else if (found)
+        S.level [i].volume.store (v,  memory_order_relaxed);
+      else if (i < depth)
+        {
+          /*  A full side loses its worst level. */
+          auto const  last  =  min (n, depth - 1);
+          for (auto j = last;  j > i;  --j)   move_level (j, j - 1);
+          S.level [i].price.store (p,  memory_order_relaxed);
+          S.level [i].volume.store (v,  memory_order_relaxed);
+          S.count.store (last + 1,  memory_order_relaxed);
+        }
+    }
+
+
+    uint32_t  checksum  ()  const
+    {
+      auto  crc     =  ~uint32_t {0};
+      auto  buffer  =  array<char, 24> {};
+
+      auto  add  =  [&] (int64_t const x)
+        {
+          auto const  end  =  to_chars (buffer.data (),
+                                        buffer.data () + buffer.size (),
+                                        x).ptr;
+          crc  =  crc32_update (crc,  buffer.data (),  end);
+        };
+
+      for (auto const s  :  {ASK, BID})
+        for (auto i = size_t {0};  i < min (count (s), CHECKSUM_LEVELS);  ++i)
+          {
+            add (price (s, i));
+            add (volume (s, i));
+          }
+
+      return  ~crc;
+    }
+
+
+    /*  The levels of a WebSocket book message, and whether it was a
+     *  snapshot and what checksum, if any, it carries.  */
+    bool  parse_message  (string_view message,  bool &has_crc,  uint32_t &crc)
+    {
+      auto  R         =  Json_Reader {message};
+      auto  snapshot  =  false;
+
+      changes.clear ();
+      has_crc  =  false;
+
+      R.expect ('[');
+      for (auto more = ! R.consume (']');  more;  more = R.more (']'))
+        {
+          if (R.peek () != '{')   {  R.skip ();  continue;  }
+
+          R.expect ('{');
+          for (auto m = ! R.consume ('}');  m;  m = R.more ('}'))
+            {
+              auto const  key  =  R.string_value ();
+              R.expect (':');
+
+              if (key == "c")
+                {
+                  crc  =  R.number<uint32_t> ();
+                  has_crc  =  true;
+                }
+              else if (key == "a"  ||  key == "as"
+                         ||  key == "b"  ||  key == "bs")
+                {
+                  if (key.length () == 2)   snapshot  =  true;
+                  read_changes (R,  key [0] == 'a'  ?  ASK  :  BID);
+                }
+              else
+                R.skip ();
+            }
+        }
+
+      return snapshot;
+    }
+
+
+    void  read_changes  (Json_Reader &R,  Side const s)
+    {
+      auto  ps  =  price_scale.load (memory_order_relaxed);
+      auto  vs  =  volume_scale.load (memory_order_relaxed);
+
+      R.expect ('[');
+      for (auto more = ! R.consume (']');  more;  more = R.more (']'))
+        {
+          auto  C  =  Change {s, 0, 0, 0.0};
+          R.expect ('[');
+          C.price   =  fixed_point (R.string_value (),  ps);
+          R.expect (',');
+          C.volume  =  fixed_point (R.string_value (),  vs);
+          R.expect (',');
+          C.time    =  R.number<double> ();
+          while (R.more (']'))   R.skip ();
+          changes.push_back (C);
+        }
+
+      price_scale.store (ps,  memory_order_relaxed);
+      volume_scale.store (vs,  memory_order_relaxed);
+    }
+
+
+    void  clear  ()
+    {
+      for (auto &S  :  sides)   S.count.store (0,  memory_order_relaxed);
+    }
+
+
+    void  apply_changes  (double const after = 0.0)
+    {
+      for (auto const &C  :  changes)
+        if (C.time > after)
+          set_level (C.side,  C.price,  C.volume);
+    }
+
+
+    /*  The book has gone wrong: throw it away and fetch a new one, holding
+     *  on to updates until it arrives.  Called with the lock held, on the
+     *  feedʼs thread, so this must not wait for the rate limiter: if it
+     *  has no room the fetch is left to the first update after it has.  */
+    void  resynchronize  (weak_ptr<Implementation> self)
+    {
+      synchronized_.store (false,  memory_order_relaxed);
+      if (fetching  ||  Clock::now () < retry_at)   return;
+
+      auto  options  =  Kraken_API::Options {};
+      options.set (Kraken_API::COUNT,  depth);
+
+      try
+        {
+          if (kraken.rate_limiter)
+            {
+              auto const  wait  =  kraken.rate_limiter->retry_after_public ();
+              if (wait.count () > 0)
+                {
+                  retry_at  =  Clock::now () + wait;
+                  return;
+                }
+            }
+
+          fetching  =  true;
+          buffered.clear ();
+
+          endpoint_submit<Endpoint::DEPTH> (kraken,  options,  &rest_pair,
+                                            [self] (string const &json,
+                                                    exception_ptr const error)
+          {
+            auto const  I  =  self.lock ();
+            if (! I)   return;
+
+            if (error)
+              {
+                /*  Try again with the next update. */
+                auto  guard  =  lock_guard<mutex> {I->lock};
+                I->fetching  =  false;
+                return;
+              }
+
+            try  {  I->load_depth (json);  }
+            catch (...)
+              {
+                auto  guard  =  lock_guard<mutex> {I->lock};
+                I->fetching  =  false;
+              }
+          });
+        }
+      catch (...)
+        {
+          fetching  =  false;
+        }
+    }
+
+
+    void  apply  (string_view message,  weak_ptr<Implementation> self)
+    {
+      auto  guard  =  lock_guard<mutex> {lock};
+
+      if (! seeded  &&  message.find ("\"as\"") == message.npos
+                    &&  message.find ("\"bs\"") == message.npos)
+        return;
+
+      auto  has_crc  =  false;
+      auto  crc      =  uint32_t {0};
+      auto const  snapshot  =  parse_message (message,  has_crc,  crc);
+
+      if (snapshot)
+        {
+          begin_write ();
+          clear ();
+          apply_changes ();
+          end_write ();
+
+          seeded  =  true;
+          fetching  =  false;
+          buffered.clear ();
+          synchronized_.store (true,  memory_order_relaxed);
+          return;
+        }
+
+      if (fetching)
+        {
+          if (buffered.size () < MAX_BUFFERED)
+            buffered.emplace_back (message);
+          return;
+        }
+
+      begin_write ();
+      apply_changes ();
+      end_write ();
+
+      if (has_crc  &&  crc != checksum ())
+        {
+          /*  Not again for every update while waiting for the limiter. */
+          if (synchronized_.load (memory_order_relaxed))
+            failures.fetch_add (1,  memory_order_relaxed);
+          resynchronize (self);
+        }
+      else if (! synchronized_.load (memory_order_relaxed))
+        synchronized_.store (true,  memory_order_relaxed);
+    }
+
+
+    void  load_depth  (string_view json)
+    {
+      auto  guard   =  lock_guard<mutex> {lock};
+      auto  newest  =  0.0;
+
+      changes.clear ();
+
+      auto  R  =  Json_Reader {json};
+      R.expect ('{');
+      for (auto more = ! R.consume ('}');  more;  more = R.more ('}'))
+        {
+          auto const  key  =  R.string_value ();
+          R.expect (':');
+
+          if (key == "error")
+            {
+              R.expect ('[');
+              for (auto m = ! R.consume (']');  m;  m = R.more (']'))
+                {
+                  auto const  E  =  R.string_value ();
+                  if (! E.empty ()  &&  E [0] != 'W')
+                    throw runtime_error {"Kraken: " + string {E}};
+                }
+              continue;
+            }
+
+          if (key != "result")   {  R.skip ();  continue;  }
+
+          R.expect ('{');
+          for (auto m = ! R.consume ('}');  m;  m = R.more ('}'))
+            {
+              R.string_value ();
+              R.expect (':');
+              R.expect ('{');
+              for (auto s = ! R.consume ('}');  s;  s = R.more ('}'))
+                {
+                  auto const  side  =  R.string_value ();
+                  R.expect (':');
+                  if      (side == "asks")   read_changes (R, ASK);
+                  else if (side == "bids")   read_changes (R, BID);
+                  else                       R.skip ();
+                }
+            }
+        }
+
+      for (auto const &C  :  changes)   newest  =  max (newest, C.time);
+
+      begin_write ();
+      clear ();
+      apply_changes ();
+
+      /*  Play over it whatever came in on the feed while it was being
+       *  fetched, but only where the feed is newer than the snapshot. */
+      for (auto const &M  :  buffered)
+        {
+          auto  has_crc  =  false;
+          auto  crc      =  uint32_t {0};
+          if (! parse_message (M, has_crc, crc))   apply_changes (newest);
+        }
+      end_write ();
+
+      buffered.clear ();
+      seeded  =  true;
+      fetching  =  false;
+      synchronized_.store (true,  memory_order_relaxed);
+    }
+
+
+    Kraken_API const &  kraken;
+    string const        rest_pair;
+    size_t const        depth;
+
+    atomic<uint64_t>     sequence       {0};
+    array<Book_Side, 2>  sides;
+    atomic<bool>         synchronized_  {false};
+    atomic<uint64_t>     failures       {0};
+    atomic<int>          price_scale    {-1};
+    atomic<int>          volume_scale   {-1};
+
+    /*  Only touched by the writer. */
+    mutex           lock;
+    vector<Change>  changes;
+    vector<string>  buffered;
+    bool            seeded        {false};
+    bool            fetching      {false};
+    Clock::time_point  retry_at   {};
+
+  };  /*  End of struct Local_Order_Book::Implementation.  */
+
+
+
+  B::Local_Order_Book  (Kraken_API const &K,
+                        string rest_pair,
+                        size_t const depth)
+    :  implementation {make_shared<Implementation> (K,
+                                                    move (rest_pair),
+                                                    depth)}
+  {}
+
+
+  B::~Local_Order_Book  ()  =  default;
+
+
+
+  void  B::apply  (string_view const message)
+  {   implementation->apply (message,  implementation);   }
+
+
+  void  B::load_depth  (string_view const json)
+  {   implementation->load_depth (json);   }
+
+
+  bool  B::synchronized  ()  const
+  {   return  implementation->synchronized_.load (memory_order_relaxed);   }
+
+
+
+  bool  B::best  (Level &bid,  Level &ask)  const
+  {
+    auto const &I  =  *implementation;
+
+    auto const  [b, a]  =  I.read ([&I] ()
+      {
+        auto  top  =  [&I] (Side const s)
+          {
+            return  I.count (s) == 0
+                      ?  Level {}
+                      :  Level {I.price (s, 0),  I.volume (s, 0)};
+          };
+        return  pair<Level, Level> {top (BID),  top (ASK)};
+      });
+
+    bid  =  b;
+    ask  =  a;
+
+    return  b.volume != 0  ||  a.volume != 0;
+  }
+
+
+
+  size_t  B::levels  (Side const s,  Level *const out,  size_t const n)  const
+  {
+    auto const &I  =  *implementation;
+
+    return  I.read ([&I, s, out, n] ()
+      {
+        auto const  m  =  min (n, I.count (s));
+        for (auto i = size_t {0};  i < m;  ++i)
+          out [i]  =  Level {I.price (s, i),  I.volume (s, i)};
+        return m;
+      });
+  }
+
+
+
+  int64_t  B::volume_at  (Side const s,  int64_t const price)  const
+  {
+    auto const &I  =  *implementation;
+
+    return  I.read ([&I, s, price] ()
+      {
+        auto const  i  =  I.position (s, price);
+        return  i < I.count (s)  &&  I.price (s, i) == price
+                  ?  I.volume (s, i)
+                  :  int64_t {0};
+      });
+  }
+
+
+
+  int  B::price_decimals   ()  const
+  {   return  implementation->price_scale.load (memory_order_relaxed);   }
+
+  int  B::volume_decimals  ()  const
+  {   return  implementation->volume_scale.load (memory_order_relaxed);   }
+
+
+  static  double  scaled  (int64_t const x,  int const scale)
+  {
+    auto  ret  =  double (x);
+    for (auto i = 0;  i < scale;  ++i)   ret  /=  10.0;
+    return ret;
+  }
+
+  double  B::to_price   (int64_t const p)  const
+  {   return  scaled (p, price_decimals ());   }
+
+  double  B::to_volume  (int64_t const v)  const
+  {   return  scaled (v, volume_decimals ());   }
+
+
+  uint64_t  B::version  ()  const
+  {   return  implementation->sequence.load (memory_order_acquire) / 2;   }
+
+
+  uint64_t  B::checksum_failures  ()  const
+  {   return  implementation->failures.load (memory_order_relaxed);   }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,275 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-api.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Rate_Limiter  L;
+
+  using  Clock  =  chrono::steady_clock;
+
+
+  /*  The counter limits and decay rates Kraken publishes for each
+   *  verification tier.  */
+  static  constexpr  array<array<double, 2>, 3>  TIER
+                        {{  {15.0, 0.33},  {20.0, 0.5},  {20.0, 1.0}  }};
+
+
+  static  int64_t  now  ()
+  {
+    return  chrono::duration_cast<chrono::nanoseconds>
+                   (Clock::now ().time_since_epoch ()).count ();
+  }
+
+
+
+  /*  Rather than the counter itself, which would need updating as time
+   *  passes, this holds the moment at which it will have decayed to zero,
+   *  from which its value at any time follows.  */
+
+  struct  Bucket
+  {
+    Bucket  (double const L,  double const per_second)
+      :  limit {L},  ns_per_unit {1.0e9 / per_second}
+    {}
+
+
+    /*  Add cost to the counter if that leaves it no higher than ceiling,
+     *  returning zero; else return how many nanoseconds to wait before
+     *  it would.  */
+    int64_t  take  (double const cost,  double const ceiling)
+    {
+      auto const  t      =  now ();
+      auto const  delta  =  int64_t (cost * ns_per_unit);
+      auto const  room   =  int64_t (ceiling * ns_per_unit);
+      auto        e      =  empty_at.load (memory_order_relaxed);
+
+      for (;;)
+        {
+          auto const  next    =  max (e, t) + delta;
+          auto const  excess  =  next - t - room;
+          if (excess > 0)   return excess;
+          if (empty_at.compare_exchange_weak (e, next,
+                                              memory_order_relaxed))
+            return 0;
+        }
+    }
+
+
+    double  level  ()  const
+    {
+      auto const  e  =  empty_at.load (memory_order_relaxed);
+      return  max (int64_t {0},  e - now ())  /  ns_per_unit;
+    }
+
+
+    void  fill  ()
+    {
+      auto const  full  =  now () + int64_t (limit * ns_per_unit);
+      auto        e     =  empty_at.load (memory_order_relaxed);
+      while (e < full  &&  ! empty_at.compare_exchange_weak
+                                           (e, full, memory_order_relaxed));
+    }
+
+
+    double const       limit;
+    double const       ns_per_unit;
+    atomic<int64_t>    empty_at  {0};
+  };
+
+
+
+  struct  L::Implementation
+  {
+    Implementation  (double const limit,  double const decay,
+                     chrono::milliseconds const W,
+                     double const public_limit,  double const public_decay)
+      :  account {limit, decay},  address {public_limit, public_decay},
+         max_wait {chrono::duration_cast<chrono::nanoseconds> (W).count ()}
+    {}
+
+
+    /*  Zero if the bucket took cost, else how long to wait before trying
+     *  again; throws if the whole wait would be longer than max_wait.  */
+    int64_t  attempt  (Bucket &B,  double const cost,  double const ceiling,
+                       string_view const what,  int64_t const waited)
+    {
+      auto const  wait  =  B.take (cost, ceiling);
+
+      if (wait != 0  &&  waited + wait > max_wait)
+        throw Exceeded {"API rate limit would be exceeded by "
+                        +  string {what}};
+
+      return wait;
+    }
+
+
+    /*  Wait for the bucket to take cost, but not for longer than
+     *  max_wait.  */
+    void  acquire  (Bucket &B,  double const cost,  double const ceiling,
+                    string_view const what)
+    {
+      auto  waited  =  int64_t {0};
+
+      while (auto const  wait  =  attempt (B, cost, ceiling, what, waited))
+        {
+          this_thread::sleep_for (chrono::nanoseconds {wait});
+          waited  +=  wait;
+        }
+    }
+
+
+    Bucket         account;
+    Bucket         address;
+    int64_t const  max_wait;
+  };
+
+
+
+  L::Rate_Limiter  (Tier const T,  chrono::milliseconds const max_wait)
+    :  Rate_Limiter {TIER [T][0],  TIER [T][1],  max_wait}
+  {}
+
+
+  L::Rate_Limiter  (double const limit,
+                    double const decay_per_second,
+                    chrono::milliseconds const max_wait,
+                    double const public_limit,
+                    double const public_decay_per_second)
+    :  implementation {make_unique<Implementation>
+                           (limit, decay_per_second, max_wait,
+                            public_limit, public_decay_per_second)}
+  {}
+
+
+  L::~Rate_Limiter  ()  =  default;
+
+
+
+  L::Priority  L::priority  (string_view const function)
+  {
+    static  constexpr  array<string_view, 7>  trading
+      {  "AddOrder", "AddOrderBatch", "CancelOrder", "CancelOrderBatch",
+         "CancelAll", "CancelAllOrdersAfter", "EditOrder"  };
+
+    static  constexpr  array<string_view, 3>  history
+      {  "Ledgers", "QueryLedgers", "TradesHistory"  };
+
+    if (find (trading.begin (), trading.end (), function) != trading.end ())
+      return TRADING;
+
+    if (find (history.begin (), history.end (), function) != history.end ())
+      return HISTORY;
+
+    return NORMAL;
+  }
+
+
+  double  L::cost  (string_view const function)
+  {   return  double (priority (function));   }
+
+
+
+  void  L::acquire  (string_view const function)
+  {
+    auto const  p  =  priority (function);
+    if (p == TRADING)   return;
+
+    auto &I  =  *implementation;
+    I.acquire (I.account,  cost (function),
+               I.account.limit  -  (p == HISTORY  ?  HISTORY_RESERVE  :  0.0),
+               function);
+  }
+
+
+  bool  L::try_acquire  (string_view const function)
+  {
+    auto const  p  =  priority (function);
+    if (p == TRADING)   return true;
+
+    auto &I  =  *implementation;
+    return  I.account.take (cost (function),
+                            I.account.limit
+                              -  (p == HISTORY  ?  HISTORY_RESERVE  :  0.0))
+              ==  0;
+  }
+
+
+  void  L::acquire_public  ()
+  {
+    auto &I  =  *implementation;
+    I.acquire (I.address,  1.0,  I.address.limit,  "public call");
+  }
+
+
+
+  chrono::nanoseconds  L::retry_after  (string_view const function,
+                                       chrono::nanoseconds const waited)
+  {
+    auto const  p  =  priority (function);
+    if (p == TRADING)   return {};
+
+    auto &I  =  *implementation;
+    return  chrono::nanoseconds
+              {I.attempt (I.account,  cost (function),
+                          I.account.limit
+                            -  (p == HISTORY  ?  HISTORY_RESERVE  :  0.0),
+                          function,  waited.count ())};
+  }
+
+
+  chrono::nanoseconds  L::retry_after_public
+                                   (chrono::nanoseconds const waited)
+  {
+    auto &I  =  *implementation;
+    return  chrono::nanoseconds
+              {I.attempt (I.address,  1.0,  I.address.limit,  "public call",
+                          waited.count ())};
+  }
+
+
+
+  double  L::headroom  ()  const
+  {
+    auto const &A  =  implementation->account;
+    return  max (0.0,  A.limit - A.level ());
+  }
+
+
+  double  L::public_headroom  ()  const
+  {
+    auto const &A  =  implementation->address;
+    return  max (0.0,  A.limit - A.level ());
+  }
+
+
+  void  L::saturate  ()
+  {   implementation->account.fill ();   }
+
+
+}  /* End of namespace DMBCS. */
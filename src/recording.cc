@@ -0,0 +1,643 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-recording.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Market_Recorder  R;
+  typedef  Market_Replay    P;
+
+
+
+  /*  Prices and volumes are held as multiples of 1/FIXED_SCALE.  Eight
+   *  decimal places are as fine as Kraken quotes anything, and leave
+   *  room for volumes up to some ninety billion.  */
+  static constexpr double  FIXED_SCALE  =  1e8;
+
+
+  /*  Every record starts with one of these, followed by the name of the
+   *  pair and then the columns, each padded to a multiple of eight bytes.
+   *  The layout is that of the machine doing the writing; recordings are
+   *  not meant to move between little- and big-endian machines.  */
+  struct  Record_Header
+  {
+    array<char, 4>  magic;
+    uint8_t         kind;
+
+    /*  Times are stored as multiples of ten to this power, in seconds. */
+    int8_t          time_exponent;
+
+    uint16_t        pair_length;
+
+    /*  Of rows; an order book has count asks and count_2 bids. */
+    uint32_t        count;
+    uint32_t        count_2;
+
+    /*  Of the whole record including this header. */
+    uint32_t        size;
+    uint32_t        reserved;
+
+    /*  The first time; the time column holds differences from the one
+     *  before.  */
+    int64_t         time_base;
+
+    /*  The ‘last’ member of the recorded object. */
+    int64_t         last;
+  };
+
+  static_assert (sizeof (Record_Header) == 40,
+                 "recording header must have no hidden padding");
+
+  static constexpr array<char, 4>  MAGIC  {{'D', 'K', 'R', '1'}};
+
+
+
+  static size_t  padded  (size_t const n)  {   return (n + 7) & ~size_t {7};  }
+
+
+  static double  power_of_ten  (int const e)
+  {
+    auto  ret  =  1.0;
+    for (auto i = 0;  i < abs (e);  ++i)   ret  *=  10.0;
+    return  e < 0  ?  1.0 / ret  :  ret;
+  }
+
+
+  /*  The same time in the given units, computed the same way when
+   *  writing and reading so that the round trip is exact.  */
+  static int64_t  time_units  (double const t,  int const e)
+  {
+    return  e < 0  ?  llround (t * power_of_ten (-e))
+                   :  llround (t / power_of_ten (e));
+  }
+
+  static double  time_seconds  (int64_t const t,  int const e)
+  {
+    return  e < 0  ?  double (t) / power_of_ten (-e)
+                   :  double (t) * power_of_ten (e);
+  }
+
+
+
+  /*  Builds one record in a buffer which is re-used from one record to
+   *  the next.  */
+  class  Record_Writer
+  {
+  public:
+
+    explicit  Record_Writer  (vector<char> &B)  :  buffer {B}
+    {   buffer.resize (sizeof (Record_Header));   }
+
+
+    Record_Header  header  {};
+
+
+    void  pair  (string const &P)
+    {
+      header.pair_length  =  uint16_t (P.size ());
+      append (P.data (),  P.size ());
+    }
+
+
+    template <typename T,  typename F>
+    void  column  (size_t const n,  F const &f)
+    {
+      auto const  at  =  buffer.size ();
+      buffer.resize (padded (at + n * sizeof (T)));
+      for (auto i = size_t {0};  i < n;  ++i)
+        {
+          auto const  x  =  T (f (i));
+          memcpy (buffer.data () + at + i * sizeof (T),  &x,  sizeof (T));
+        }
+    }
+
+
+    template <typename F>
+    void  fixed_column  (size_t const n,  F const &f)
+    {
+      column<int64_t> (n,  [&f] (size_t const i)
+                             {   return llround (f (i) * FIXED_SCALE);   });
+    }
+
+
+    /*  Chooses the finest unit, from a microsecond (or a second for times
+     *  which are whole seconds anyway) upwards, in which all the gaps fit
+     *  into 32 bits.  */
+    template <typename F>
+    void  time_column  (size_t const n,  F const &f,  int const finest)
+    {
+      auto  e  =  finest;
+      for (;  n > 0;  ++e)
+        {
+          auto  previous  =  time_units (f (0),  e);
+          auto  fits      =  true;
+          for (auto i = size_t {1};  fits  &&  i < n;  ++i)
+            {
+              auto const  t  =  time_units (f (i),  e);
+              fits  =  abs (t - previous)
+                             <=  numeric_limits<int32_t>::max ();
+              previous  =  t;
+            }
+          if (fits)   break;
+        }
+
+      header.time_exponent  =  int8_t (e);
+      header.time_base      =  n  ?  time_units (f (0), e)  :  0;
+
+      auto  previous  =  header.time_base;
+      column<int32_t> (n,  [&] (size_t const i)
+                             {
+                               auto const  t  =  time_units (f (i), e);
+                               auto const  d  =  t - previous;
+                               previous  =  t;
+                               return d;
+                             });
+    }
+
+
+    void  finish  (Market_Replay::Kind const K,  size_t const count)
+    {
+      if (buffer.size () > numeric_limits<uint32_t>::max ())
+        throw runtime_error {"market data too large for one record"};
+
+      header.magic  =  MAGIC;
+      header.kind   =  uint8_t (K);
+      header.count  =  uint32_t (count);
+      header.size   =  uint32_t (buffer.size ());
+      memcpy (buffer.data (),  &header,  sizeof (header));
+    }
+
+
+  private:
+
+    void  append  (char const *const data,  size_t const n)
+    {
+      auto const  at  =  buffer.size ();
+      buffer.resize (padded (at + n));
+      memcpy (buffer.data () + at,  data,  n);
+    }
+
+    vector<char>  &buffer;
+  };
+
+
+
+  struct  R::Implementation
+  {
+    ~Implementation  ()   {   if (fd >= 0)   close (fd);   }
+
+    void  write_out  ()
+    {
+      for (auto  at  =  size_t {0};  at < buffer.size ();  )
+        {
+          auto const  n  =  ::write (fd,  buffer.data () + at,
+                                     buffer.size () - at);
+          if (n < 0)
+            {
+              if (errno == EINTR)   continue;
+              throw runtime_error {string {"cannot write recording: "}
+                                   +  strerror (errno)};
+            }
+          at  +=  size_t (n);
+        }
+    }
+
+    int           fd  {-1};
+    mutex         lock;
+    vector<char>  buffer;
+  };
+
+
+
+  R::Market_Recorder  (string const &path)
+    :  implementation {make_unique<Implementation> ()}
+  {
+    implementation->fd  =  open (path.c_str (),
+                                 O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                                 0644);
+    if (implementation->fd < 0)
+      throw runtime_error {"cannot open recording " + path + ": "
+                           +  strerror (errno)};
+  }
+
+
+
+  R::~Market_Recorder  ()  =  default;
+
+
+
+  void  R::record  (Order_Book const &B)
+  {
+    auto  L  =  lock_guard<mutex> {implementation->lock};
+    auto  W  =  Record_Writer {implementation->buffer};
+
+    auto const  a  =  B.asks.size ();
+    auto const  b  =  B.bids.size ();
+    auto const  level  =  [&B, a] (size_t const i) -> Order_Book_Level const &
+                            {   return  i < a  ?  B.asks [i]
+                                               :  B.bids [i - a];   };
+
+    W.pair (B.pair);
+    W.fixed_column (a + b,  [&] (size_t i)  {  return level (i).price;  });
+    W.fixed_column (a + b,  [&] (size_t i)  {  return level (i).volume;  });
+    W.time_column  (a + b,  [&] (size_t i)  {  return level (i).time;  },
+                    -6);
+    W.header.count_2  =  uint32_t (b);
+    W.finish (P::ORDER_BOOK,  a);
+
+    implementation->write_out ();
+  }
+
+
+
+  void  R::record  (Recent_Trades const &T)
+  {
+    auto  L  =  lock_guard<mutex> {implementation->lock};
+    auto  W  =  Record_Writer {implementation->buffer};
+    auto const  n  =  T.size ();
+
+    W.pair (T.pair);
+    W.fixed_column (n,  [&T] (size_t i)  {  return T.price [i];  });
+    W.fixed_column (n,  [&T] (size_t i)  {  return T.volume [i];  });
+    W.time_column  (n,  [&T] (size_t i)  {  return T.time [i];  },  -6);
+    W.column<char> (n,  [&T] (size_t i)  {  return T.side [i];  });
+    W.column<char> (n,  [&T] (size_t i)  {  return T.order_type [i];  });
+    W.header.last  =  T.last;
+    W.finish (P::RECENT_TRADES,  n);
+
+    implementation->write_out ();
+  }
+
+
+
+  void  R::record  (OHLC_Series const &S)
+  {
+    auto  L  =  lock_guard<mutex> {implementation->lock};
+    auto  W  =  Record_Writer {implementation->buffer};
+    auto const  n  =  S.bars.size ();
+    auto const &B  =  S.bars;
+
+    W.pair (S.pair);
+    W.fixed_column (n,  [&B] (size_t i)  {  return B [i].open;  });
+    W.fixed_column (n,  [&B] (size_t i)  {  return B [i].high;  });
+    W.fixed_column (n,  [&B] (size_t i)  {  return B [i].low;  });
+    W.fixed_column (n,  [&B] (size_t i)  {  return B [i].close;  });
+    W.fixed_column (n,  [&B] (size_t i)  {  return B [i].vwap;  });
+    W.fixed_column (n,  [&B] (size_t i)  {  return B [i].volume;  });
+    W.column<int64_t> (n,  [&B] (size_t i)  {  return B [i].count;  });
+    W.time_column  (n,  [&B] (size_t i)  {  return double (B [i].time);  },
+                    0);
+    W.header.last  =  S.last;
+    W.finish (P::OHLC,  n);
+
+    implementation->write_out ();
+  }
+
+
+
+  void  R::record  (Spread_Series const &S)
+  {
+    auto  L  =  lock_guard<mutex> {implementation->lock};
+    auto  W  =  Record_Writer {implementation->buffer};
+    auto const  n  =  S.entries.size ();
+    auto const &E  =  S.entries;
+
+    W.pair (S.pair);
+    W.fixed_column (n,  [&E] (size_t i)  {  return E [i].bid;  });
+    W.fixed_column (n,  [&E] (size_t i)  {  return E [i].ask;  });
+    W.time_column  (n,  [&E] (size_t i)  {  return double (E [i].time);  },
+                    0);
+    W.header.last  =  S.last;
+    W.finish (P::SPREAD,  n);
+
+    implementation->write_out ();
+  }
+
+
+
+
+  /*  The least size a record with this header can have: the header, the
+   *  pair and the columns its counts call for, as Record_Reader will read
+   *  them for its kind.  */
+  static size_t  least_size  (Record_Header const &H)
+  {
+    auto const  n       =  size_t {H.count};
+    auto const  fixed   =  padded (n * sizeof (int64_t));
+    auto const  times   =  padded (n * sizeof (int32_t));
+    auto  columns       =  size_t {0};
+
+    switch (H.kind)
+      {
+      case P::ORDER_BOOK:
+        {
+          auto const  levels  =  n + H.count_2;
+          columns  =  2 * padded (levels * sizeof (int64_t))
+                        +  padded (levels * sizeof (int32_t));
+        }
+        break;
+      case P::RECENT_TRADES:
+        columns  =  2 * fixed  +  times  +  2 * padded (n);   break;
+      case P::OHLC:
+        columns  =  7 * fixed  +  times;                      break;
+      case P::SPREAD:
+        columns  =  2 * fixed  +  times;                      break;
+      }
+
+    return  sizeof (Record_Header)  +  padded (H.pair_length)  +  columns;
+  }
+
+
+
+  /*  Reads the columns of a record in the order they were written. */
+  class  Record_Reader
+  {
+  public:
+
+    explicit  Record_Reader  (char const *const R)
+      :  at  {R + sizeof (Record_Header)}
+    {
+      memcpy (&header,  R,  sizeof (header));
+      at  +=  padded (header.pair_length);
+    }
+
+
+    Record_Header  header;
+
+
+    template <typename T,  typename F>
+    void  column  (size_t const n,  F const &f)
+    {
+      for (auto i = size_t {0};  i < n;  ++i)
+        {
+          T  x;
+          memcpy (&x,  at + i * sizeof (T),  sizeof (T));
+          f (i,  x);
+        }
+      at  +=  padded (n * sizeof (T));
+    }
+
+
+    template <typename F>
+    void  fixed_column  (size_t const n,  F const &f)
+    {
+      column<int64_t> (n,  [&f] (size_t const i,  int64_t const x)
+                             {   f (i,  double (x) / FIXED_SCALE);   });
+    }
+
+
+    template <typename F>
+    void  time_column  (size_t const n,  F const &f)
+    {
+      auto  t  =  header.time_base;
+      column<int32_t> (n,  [&] (size_t const i,  int32_t const d)
+                             {
+                               t  +=  d;
+                               f (i,  time_seconds (t,
+                                                    header.time_exponent));
+                             });
+    }
+
+
+  private:
+
+    char const  *at;
+  };
+
+
+
+  struct  P::Implementation
+  {
+    ~Implementation  ()
+    {   if (map != MAP_FAILED)   munmap (map, size);   }
+
+
+    /*  The whole of the record starting at offset, or nullptr. */
+    char const *  record_at  (size_t const offset)  const
+    {
+      if (offset + sizeof (Record_Header) > size)   return nullptr;
+
+      auto const  R  =  static_cast<char const*> (map) + offset;
+      auto  H  =  Record_Header {};
+      memcpy (&H,  R,  sizeof (H));
+
+      if (H.magic != MAGIC  ||  H.size < least_size (H))
+        throw runtime_error {"recording " + path + " is corrupt at byte "
+                             +  to_string (offset)};
+
+      return  offset + H.size <= size  ?  R  :  nullptr;
+    }
+
+
+    Record_Header  header  ()  const
+    {
+      auto  ret  =  Record_Header {};
+      if (current)   memcpy (&ret,  current,  sizeof (ret));
+      return ret;
+    }
+
+
+    void  check  (Kind const K)  const
+    {
+      if (! current  ||  header ().kind != K)
+        throw logic_error {"Market_Replay: current record is not of the "
+                           "kind asked for"};
+    }
+
+
+    string        path;
+    void         *map       {MAP_FAILED};
+    size_t        size      {0};
+    size_t        offset    {0};
+    char const   *current   {nullptr};
+  };
+
+
+
+  P::Market_Replay  (string const &path)
+    :  implementation {make_unique<Implementation> ()}
+  {
+    auto &I  =  *implementation;
+    I.path  =  path;
+
+    auto const  fd  =  open (path.c_str (),  O_RDONLY | O_CLOEXEC);
+    struct stat  status  {};
+    if (fd < 0  ||  fstat (fd, &status))
+      {
+        auto const  error  =  errno;
+        if (fd >= 0)   close (fd);
+        throw runtime_error {"cannot read recording " + path + ": "
+                             +  strerror (error)};
+      }
+
+    I.size  =  size_t (status.st_size);
+    if (I.size > 0)
+      {
+        I.map  =  mmap (nullptr,  I.size,  PROT_READ,  MAP_PRIVATE,  fd,  0);
+        if (I.map != MAP_FAILED)
+          madvise (I.map,  I.size,  MADV_SEQUENTIAL);
+      }
+    close (fd);
+
+    if (I.size > 0  &&  I.map == MAP_FAILED)
+      throw runtime_error {"cannot map recording " + path + ": "
+                           +  strerror (errno)};
+
+    /*  Finds out now if this is not a recording at all. */
+    I.record_at (0);
+  }
+
+
+
+  P::~Market_Replay  ()  =  default;
+
+
+
+  P::Kind  P::next  ()
+  {
+    auto &I  =  *implementation;
+
+    if (I.current)   I.offset  +=  I.header ().size;
+    I.current  =  I.record_at (I.offset);
+
+    return  I.current  ?  Kind (I.header ().kind)  :  END;
+  }
+
+
+
+  void  P::rewind  ()
+  {
+    implementation->offset   =  0;
+    implementation->current  =  nullptr;
+  }
+
+
+
+  string_view  P::pair  ()  const
+  {
+    auto const  C  =  implementation->current;
+    if (! C)   return {};
+    return  string_view {C + sizeof (Record_Header),
+                         implementation->header ().pair_length};
+  }
+
+
+
+  void  P::read  (Order_Book &B)  const
+  {
+    implementation->check (ORDER_BOOK);
+    auto  R  =  Record_Reader {implementation->current};
+
+    auto const  a  =  size_t {R.header.count};
+    auto const  n  =  a + R.header.count_2;
+    B.pair  =  string {pair ()};
+    B.asks.resize (a);
+    B.bids.resize (n - a);
+
+    auto const  level  =  [&B, a] (size_t const i) -> Order_Book_Level &
+                            {   return  i < a  ?  B.asks [i]
+                                               :  B.bids [i - a];   };
+
+    R.fixed_column (n,  [&] (size_t i, double x)  {  level (i).price = x;  });
+    R.fixed_column (n,  [&] (size_t i, double x)  {  level (i).volume = x; });
+    R.time_column  (n,  [&] (size_t i, double x)  {  level (i).time = x;  });
+  }
+
+
+
+  void  P::read  (Recent_Trades &T)  const
+  {
+    implementation->check (RECENT_TRADES);
+    auto  R  =  Record_Reader {implementation->current};
+    auto const  n  =  size_t {R.header.count};
+
+    T.pair  =  string {pair ()};
+    T.price.resize (n);
+    T.volume.resize (n);
+    T.time.resize (n);
+    T.side.resize (n);
+    T.order_type.resize (n);
+
+    R.fixed_column (n,  [&T] (size_t i, double x)  {  T.price [i] = x;  });
+    R.fixed_column (n,  [&T] (size_t i, double x)  {  T.volume [i] = x;  });
+    R.time_column  (n,  [&T] (size_t i, double x)  {  T.time [i] = x;  });
+    R.column<char> (n,  [&T] (size_t i, char x)  {  T.side [i] = x;  });
+    R.column<char> (n,  [&T] (size_t i, char x)  {  T.order_type [i] = x;  });
+    T.last  =  R.header.last;
+  }
+
+
+
+  void  P::read  (OHLC_Series &S)  const
+  {
+    implementation->check (OHLC);
+    auto  R  =  Record_Reader {implementation->current};
+    auto const  n  =  size_t {R.header.count};
+    auto &B  =  S.bars;
+
+    S.pair  =  string {pair ()};
+    B.resize (n);
+
+    R.fixed_column (n,  [&B] (size_t i, double x)  {  B [i].open = x;  });
+    R.fixed_column (n,  [&B] (size_t i, double x)  {  B [i].high = x;  });
+    R.fixed_column (n,  [&B] (size_t i, double x)  {  B [i].low = x;  });
+    R.fixed_column (n,  [&B] (size_t i, double x)  {  B [i].close = x;  });
+    R.fixed_column (n,  [&B] (size_t i, double x)  {  B [i].vwap = x;  });
+    R.fixed_column (n,  [&B] (size_t i, double x)  {  B [i].volume = x;  });
+    R.column<int64_t> (n,  [&B] (size_t i, int64_t x)  {  B [i].count = x;  });
+    R.time_column  (n,  [&B] (size_t i, double x)
+                          {  B [i].time = llround (x);  });
+    S.last  =  R.header.last;
+  }
+
+
+
+  void  P::read  (Spread_Series &S)  const
+  {
+    implementation->check (SPREAD);
+    auto  R  =  Record_Reader {implementation->current};
+    auto const  n  =  size_t {R.header.count};
+    auto &E  =  S.entries;
+
+    S.pair  =  string {pair ()};
+    E.resize (n);
+
+    R.fixed_column (n,  [&E] (size_t i, double x)  {  E [i].bid = x;  });
+    R.fixed_column (n,  [&E] (size_t i, double x)  {  E [i].ask = x;  });
+    R.time_column  (n,  [&E] (size_t i, double x)
+                          {  E [i].time = llround (x);  });
+    S.last  =  R.header.last;
+  }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,269 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-api.h>
+#include <curlpp/Options.hpp>
+#include <curlpp/Easy.hpp>
+#include <curl/curl.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace  DMBCS  {
+
+
+  namespace C = curlpp;
+  namespace CO = C::Options;
+
+
+  /* Defined in curl.cc. */
+  void  receive_into  (string &body,  C::Easy &request,  size_t expected);
+
+
+
+  /*  A callback which throws must not take the loop thread, and every
+   *  other transfer with it, down; what it throws is dropped.  */
+  template <typename F,  typename... A>
+  static  void  guarded  (F const &f,  A &&... a)
+  {
+    try
+      {
+        f (forward<A> (a)...);
+      }
+    catch (...)
+      {
+      }
+  }
+
+
+
+  struct  Request_Engine::Implementation
+  {
+    struct  Transfer
+    {
+      Transfer  (Connection_Pool::Lease &&L,  Completion D,  Inspection I)
+        :  lease {move (L)},  done {move (D)},  inspect {move (I)}
+      {}
+
+      Connection_Pool::Lease  lease;
+      Completion              done;
+      Inspection              inspect;
+      string                  body;
+    };
+
+
+    shared_ptr<Connection_Pool>  pool;
+
+    CURLM  *multi  {curl_multi_init ()};
+
+    mutex                        incoming_lock;
+    vector<unique_ptr<Transfer>>  incoming;
+    vector<function<void ()>>     posted;
+
+    /*  Only touched on the loop thread. */
+    map<CURL*, unique_ptr<Transfer>>  active;
+
+    atomic<size_t>  in_flight  {0};
+    atomic<bool>    stopping   {false};
+
+    thread  loop;
+
+
+    Implementation  (shared_ptr<Connection_Pool> P,  long max_host_connections)
+      :  pool {move (P)}
+    {
+      if (! multi)
+        throw runtime_error {"cannot create libcurl multi handle"};
+
+      curl_multi_setopt (multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+      curl_multi_setopt (multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                         max_host_connections);
+
+      loop  =  thread {[this] { run (); }};
+    }
+
+
+    ~Implementation  ()
+    {
+      stopping  =  true;
+      curl_multi_wakeup (multi);
+      loop.join ();
+
+      /*  Anything the loop did not get to. */
+      for (auto &T : incoming)   abandon (*T);
+      for (auto &f : posted)     guarded (f);
+
+      curl_multi_cleanup (multi);
+    }
+
+
+    void  abandon  (Transfer &T)
+    {
+      --in_flight;
+      if (T.done)
+        guarded (T.done,  string {},
+                 make_exception_ptr
+                     (runtime_error {"request engine shut down"}));
+    }
+
+
+    void  admit  ()
+    {
+      auto  batch  =  vector<unique_ptr<Transfer>> {};
+      auto  calls  =  vector<function<void ()>> {};
+      {
+        auto  guard  =  lock_guard<mutex> {incoming_lock};
+        batch.swap (incoming);
+        calls.swap (posted);
+      }
+
+      for (auto &f : calls)   guarded (f);
+
+      for (auto &T : batch)
+        {
+          receive_into (T->body, *T->lease, 0);
+
+          auto *const  handle  =  T->lease->getHandle ();
+          curl_multi_add_handle (multi, handle);
+          active [handle]  =  move (T);
+        }
+    }
+
+
+    void  harvest  ()
+    {
+      auto  queued  =  int {0};
+
+      while (auto *const  message  =  curl_multi_info_read (multi, &queued))
+        {
+          if (message->msg  !=  CURLMSG_DONE)   continue;
+
+          auto *const  handle  =  message->easy_handle;
+          auto const   code    =  message->data.result;
+
+          curl_multi_remove_handle (multi, handle);
+
+          auto  i  =  active.find (handle);
+          if (i == active.end ())   continue;
+
+          auto  T  =  move (i->second);
+          active.erase (i);
+          --in_flight;
+
+          if (T->inspect)   guarded (T->inspect, *T->lease);
+
+          if (! T->done)   continue;
+
+          if (code == CURLE_OK)
+            guarded (T->done,  T->body,  exception_ptr {});
+          else
+            guarded (T->done,  string {},
+                     make_exception_ptr
+                         (C::LibcurlRuntimeError {curl_easy_strerror (code),
+                                                  code}));
+        }
+    }
+
+
+    void  run  ()
+    {
+      while (! stopping)
+        {
+          admit ();
+
+          auto  running  =  int {0};
+          curl_multi_perform (multi, &running);
+
+          harvest ();
+
+          curl_multi_poll (multi, nullptr, 0, 1000, nullptr);
+        }
+
+      for (auto &A : active)
+        {
+          curl_multi_remove_handle (multi, A.first);
+          abandon (*A.second);
+        }
+
+      active.clear ();
+    }
+  };
+
+
+
+  Request_Engine::Request_Engine  (shared_ptr<Connection_Pool> P,
+                                   long max_host_connections)
+    :  implementation {make_unique<Implementation> (move (P),
+                                                    max_host_connections)}
+  {}
+
+
+  Request_Engine::~Request_Engine  ()  =  default;
+
+
+
+  void  Request_Engine::submit  (Connection_Pool::Lease &&request,
+                                 Completion done,
+                                 Inspection inspect)
+  {
+    auto  &I  =  *implementation;
+
+    ++I.in_flight;
+
+    {
+      auto  guard  =  lock_guard<mutex> {I.incoming_lock};
+      I.incoming.push_back (make_unique<Implementation::Transfer>
+                                (move (request), move (done),
+                                 move (inspect)));
+    }
+
+    curl_multi_wakeup (I.multi);
+  }
+
+
+
+  void  Request_Engine::post  (function<void ()> f)
+  {
+    auto  &I  =  *implementation;
+
+    {
+      auto  guard  =  lock_guard<mutex> {I.incoming_lock};
+      I.posted.push_back (move (f));
+    }
+
+    curl_multi_wakeup (I.multi);
+  }
+
+
+
+  size_t  Request_Engine::in_flight  ()  const
+  {   return implementation->in_flight;   }
+
+
+  Connection_Pool  &Request_Engine::pool  ()  const
+  {   return *implementation->pool;   }
+
+
+}  /* End of namespace DMBCS. */
@@ -0,0 +1,286 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <dmbcs-kraken-api.h>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+
+namespace  DMBCS  {
+
+
+  typedef  Response_Cache  R;
+
+  using  Clock  =  chrono::system_clock;
+
+
+  static  constexpr  char const *const  SNAPSHOT_MAGIC
+                                             {"dmbcs-kraken-cache 1\n"};
+
+
+
+  struct  R::Implementation
+  {
+    struct  Entry
+    {
+      bool                   held  {false};
+      string                 body;
+      Validators             validators;
+      Clock::time_point      fetched;
+
+      /*  Set while a fetch is under way, for others to wait on. */
+      shared_future<string>  in_flight;
+    };
+
+
+    chrono::milliseconds  ttl  (string_view const query)  const
+    {
+      auto const  function  =  query.substr (0, query.find ('?'));
+      auto const  T         =  ttls.find (string {function});
+      return  T == ttls.end ()  ?  chrono::milliseconds {0}  :  T->second;
+    }
+
+
+    mutable mutex                               lock;
+    map<string, chrono::milliseconds>           ttls;
+    unordered_map<string, Entry>                entries;
+    Statistics                                  statistics;
+  };
+
+
+
+  R::Response_Cache  ()  :  implementation {make_unique<Implementation> ()}
+  {
+    implementation->ttls ["Assets"]      =  chrono::hours {1};
+    implementation->ttls ["AssetPairs"]  =  chrono::hours {1};
+  }
+
+
+  R::~Response_Cache  ()  =  default;
+
+
+
+  void  R::set_ttl  (string const &function,  chrono::milliseconds const T)
+  {
+    auto  guard  =  lock_guard<mutex> {implementation->lock};
+    implementation->ttls [function]  =  T;
+  }
+
+
+
+  string  R::get  (string const &query,  Fetch const &fetch)
+  {
+    auto &I  =  *implementation;
+    auto  L  =  unique_lock<mutex> {I.lock};
+
+    auto const  ttl  =  I.ttl (query);
+    if (ttl.count () <= 0)
+      {
+        L.unlock ();
+        return  fetch ({}).body;
+      }
+
+    auto &E  =  I.entries [query];
+
+    if (E.held  &&  Clock::now () < E.fetched + ttl)
+      {
+        ++I.statistics.hits;
+        return E.body;
+      }
+
+    if (E.in_flight.valid ())
+      {
+        ++I.statistics.coalesced;
+        auto const  wait  =  E.in_flight;
+        L.unlock ();
+        return  wait.get ();
+      }
+
+    /*  This thread fetches; any others asking meanwhile wait for it. */
+    auto  promise  =  std::promise<string> {};
+    E.in_flight  =  promise.get_future ().share ();
+    auto const  validators  =  E.held  ?  E.validators  :  Validators {};
+    L.unlock ();
+
+    try
+      {
+        auto  F  =  fetch (validators);
+
+        /*  Entries being fetched are never removed, so E is still good. */
+        L.lock ();
+        E.in_flight  =  {};
+
+        if (F.not_modified  &&  E.held)
+          {
+            ++I.statistics.revalidated;
+            E.fetched  =  Clock::now ();
+          }
+        else
+          {
+            ++I.statistics.misses;
+            F.not_modified  =  false;
+
+            /*  Kraken always sends an empty error array with a good
+             *  answer.  */
+            if (F.body.find (R"("error":[])") != string::npos)
+              {
+                E.held        =  true;
+                E.body        =  F.body;
+                E.validators  =  move (F.validators);
+                E.fetched     =  Clock::now ();
+              }
+          }
+
+        auto  ret  =  F.not_modified  ?  E.body  :  move (F.body);
+        L.unlock ();
+
+        promise.set_value (ret);
+        return ret;
+      }
+    catch (...)
+      {
+        if (! L.owns_lock ())   L.lock ();
+        E.in_flight  =  {};
+        L.unlock ();
+
+        promise.set_exception (current_exception ());
+        throw;
+      }
+  }
+
+
+
+  void  R::clear  ()
+  {
+    auto  guard  =  lock_guard<mutex> {implementation->lock};
+
+    /*  Entries being fetched must stay for those waiting on them. */
+    for (auto E = implementation->entries.begin ();
+              E != implementation->entries.end ();  )
+      if (E->second.in_flight.valid ())
+        {
+          E->second.held  =  false;
+          ++E;
+        }
+      else
+        E  =  implementation->entries.erase (E);
+  }
+
+
+
+  R::Statistics  R::statistics  ()  const
+  {
+    auto  guard  =  lock_guard<mutex> {implementation->lock};
+    return  implementation->statistics;
+  }
+
+
+
+  /*  The file is the magic line, then for each entry a line giving the
+   *  time it was fetched (microseconds since the epoch) and the lengths
+   *  of the query, ETag, Last-Modified and body, which follow it.  */
+
+  void  R::save  (string const &path)  const
+  {
+    auto const  temporary  =  path + ".new";
+    auto  out  =  ofstream {temporary,  ios::binary | ios::trunc};
+
+    {
+      auto  guard  =  lock_guard<mutex> {implementation->lock};
+
+      out  <<  SNAPSHOT_MAGIC;
+      for (auto const &[query, E]  :  implementation->entries)
+        if (E.held)
+          out  <<  chrono::duration_cast<chrono::microseconds>
+                            (E.fetched.time_since_epoch ()).count ()
+               <<  ' '  <<  query.length ()
+               <<  ' '  <<  E.validators.etag.length ()
+               <<  ' '  <<  E.validators.last_modified.length ()
+               <<  ' '  <<  E.body.length ()  <<  '\n'
+               <<  query  <<  E.validators.etag
+               <<  E.validators.last_modified  <<  E.body;
+    }
+
+    out.close ();
+    if (! out  ||  rename (temporary.c_str (), path.c_str ()))
+      {
+        remove (temporary.c_str ());
+        throw runtime_error {"cannot write response cache to " + path};
+      }
+  }
+
+
+
+  void  R::load  (string const &path)
+  {
+    auto  in  =  ifstream {path,  ios::binary};
+    auto  magic  =  string (string_view {SNAPSHOT_MAGIC}.length (),  '\0');
+
+    if (! in.read (magic.data (), magic.length ())
+          ||  magic != SNAPSHOT_MAGIC)
+      throw runtime_error {"no response cache in " + path};
+
+    auto  loaded  =  vector<pair<string, Implementation::Entry>> {};
+
+    for (;;)
+      {
+        auto  fetched  =  int64_t {};
+        auto  sizes    =  array<size_t, 4> {};
+        if (! (in >> fetched >> sizes [0] >> sizes [1] >> sizes [2]
+                  >> sizes [3])
+              ||  in.get () != '\n')
+          break;
+
+        auto  fields  =  array<string, 4> {};
+        for (auto i = 0;  i < 4;  ++i)
+          {
+            fields [i].resize (sizes [i]);
+            in.read (fields [i].data (), sizes [i]);
+          }
+        if (! in)
+          throw runtime_error {"truncated response cache in " + path};
+
+        auto  E  =  Implementation::Entry {};
+        E.held        =  true;
+        E.fetched     =  Clock::time_point {chrono::microseconds {fetched}};
+        E.validators  =  {move (fields [1]),  move (fields [2])};
+        E.body        =  move (fields [3]);
+        loaded.emplace_back (move (fields [0]),  move (E));
+      }
+
+    auto  guard  =  lock_guard<mutex> {implementation->lock};
+    for (auto &[query, E]  :  loaded)
+      {
+        auto &target  =  implementation->entries [query];
+        if (! target.held  ||  target.fetched < E.fetched)
+          {
+            E.in_flight  =  move (target.in_flight);
+            target  =  move (E);
+          }
+      }
+  }
+
+
+}  /* End of namespace DMBCS. */
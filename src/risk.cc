@@ -0,0 +1,441 @@
+/*
+ *  dmbcs-kraken-api   A C++ encapsulation of the API to Krakenʼs e-currency
+ *                     exchange
+ *
+ *  Copyright (C) 2018  DM Bespoke Computer Solutions Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <dmbcs-kraken-risk.h>
+#include <dmbcs-kraken-market.h>
+#include <curlpp/Options.hpp>
+#include <curlpp/Easy.hpp>
+#include <curl/curl.h>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+
+namespace  DMBCS  {
+
+
+  namespace C = curlpp;
+
+  typedef  Risk_Guard  R;
+
+
+  /* Defined in curl.cc. */
+  void  receive_into  (string &body,  C::Easy &request,  size_t expected);
+  void  measure  (Request_Metrics &M,
+                  string_view function,
+                  C::Easy &request);
+
+
+  using  Clock  =  chrono::steady_clock;
+
+
+  /*  How long a connection may sit idle before the guard sends something
+   *  down it to stop the server from closing it.  */
+  static constexpr auto  KEEP_WARM  =  chrono::seconds {15};
+
+  static constexpr auto  SIGN_HEADER  =  string_view {"API-Sign: "};
+
+
+
+  /*  One of the guardʼs connections, set up for a single private API
+   *  function.  */
+  struct  Risk_Line
+  {
+    Risk_Line  (Kraken_API const &K,
+           string_view const function,
+           chrono::milliseconds const deadline)
+      :  function {function}
+    {
+      auto const  base    =  string_view {K.url_base};
+      auto const  scheme  =  base.find ("://");
+      auto const  slash   =  base.find ('/',  scheme == base.npos
+                                                  ?  0  :  scheme + 3);
+
+      url  =  K.url_base + "private/" + string {function};
+      short_url  =  string {slash == base.npos  ?  string_view {"/"}
+                                                :  base.substr (slash)}
+                      +  "private/"  +  string {function};
+      ping_url  =  K.url_base + "public/Time";
+
+      /*  The signature is written over the placeholder for each request,
+       *  in the copy of the header which libcurl keeps.  */
+      headers  =  curl_slist_append (nullptr, ("API-Key: " + K.key).c_str ());
+      headers  =  curl_slist_append
+                      (headers,
+                       (string {SIGN_HEADER}
+                          + string (Request_Signer::Signature {}.size () - 1,
+                                    '=')).c_str ());
+      if (! headers  ||  ! headers->next)   throw  bad_alloc {};
+      signature  =  headers->next->data + SIGN_HEADER.length ();
+
+      auto *const  handle  =  easy.getHandle ();
+      curl_easy_setopt (handle, CURLOPT_HTTP_VERSION,  CURL_HTTP_VERSION_2TLS);
+      curl_easy_setopt (handle, CURLOPT_TCP_KEEPALIVE, 1L);
+      curl_easy_setopt (handle, CURLOPT_NOSIGNAL,      1L);
+      curl_easy_setopt (handle, CURLOPT_CONNECTTIMEOUT_MS,
+                        long (deadline.count ()));
+      curl_easy_setopt (handle, CURLOPT_TIMEOUT_MS,
+                        long (deadline.count ()));
+    }
+
+    ~Risk_Line  ()   {   curl_slist_free_all (headers);   }
+
+    Risk_Line  (Risk_Line const &)  =  delete;
+    Risk_Line &  operator=  (Risk_Line const &)  =  delete;
+
+    string_view const  function;
+    string             url;
+    string             short_url;
+    string             ping_url;
+    curl_slist        *headers  {nullptr};
+    char              *signature  {nullptr};
+    C::Easy            easy;
+
+    /*  Held for the whole of a request on the line. */
+    mutex              lock;
+    Clock::time_point  used  {};
+  };
+
+
+
+  struct  Risk_Guard::Implementation
+  {
+    Implementation  (Kraken_API const &K,  chrono::milliseconds const deadline)
+      :  signer {K.signer},
+         nonce_source {K.nonce_source  ?  K.nonce_source
+                                       :  Nonce_Source::process_wide ()},
+         metrics {K.metrics},
+         cancel {K, "CancelAll", deadline},
+         heartbeat {K, "CancelAllOrdersAfter", deadline}
+    {
+      if (! signer)
+        /*  Making it again will throw the reason why it was not made. */
+        Request_Signer {K.secret};
+    }
+
+    shared_ptr<Request_Signer const>  signer;
+    shared_ptr<Nonce_Source>          nonce_source;
+    shared_ptr<Request_Metrics>       metrics;
+
+    Risk_Line  cancel;
+    Risk_Line  heartbeat;
+
+    mutable mutex  statistics_lock;
+    Statistics     statistics;
+
+    /*  The state of the guardʼs thread, under state_lock. */
+    mutex                           state_lock;
+    condition_variable              wake;
+    bool                            stopping  {false};
+    bool                            armed     {false};
+    chrono::seconds                 timeout   {0};
+    chrono::seconds                 interval  {0};
+    function<void (exception_ptr)>  on_failure;
+    Clock::time_point               next_beat  {};
+    Clock::time_point               next_ping  {};
+
+    thread  worker;
+
+
+    /*  Send the signed request for the lineʼs function, with the
+     *  arguments (if any) before the nonce, returning the reply and the
+     *  time it took.  The caller holds the lineʼs lock.  */
+    string  send  (Risk_Line &L,  string_view const arguments,
+                   chrono::nanoseconds &took)
+    {
+      auto const  start  =  Clock::now ();
+
+      auto  nonce_text  =  Nonce_Source::Text {};
+      auto const  nonce  =  nonce_source->next (nonce_text);
+
+      auto  post  =  array<char, 64> {};
+      auto  end   =  post.data ();
+      auto const  put  =  [&end] (string_view const s)
+                            {  end  =  copy (s.begin (), s.end (), end);  };
+      if (! arguments.empty ())   {  put (arguments);  put ("&");  }
+      put ("nonce=");
+      put (nonce);
+      auto const  post_data  =  string_view (post.data (),
+                                             size_t (end - post.data ()));
+
+      auto  hmac  =  Request_Signer::Signature {};
+      signer->sign (L.short_url, nonce, post_data, hmac);
+      memcpy (L.signature, hmac.data (), hmac.size () - 1);
+
+      auto *const  handle  =  L.easy.getHandle ();
+      curl_easy_setopt (handle, CURLOPT_URL,            L.url.c_str ());
+      curl_easy_setopt (handle, CURLOPT_POSTFIELDS,     post.data ());
+      curl_easy_setopt (handle, CURLOPT_POSTFIELDSIZE,
+                        long (post_data.size ()));
+      curl_easy_setopt (handle, CURLOPT_HTTPHEADER,     L.headers);
+
+      auto  body  =  string {};
+      receive_into (body, L.easy, 256);
+
+      try
+        {
+          L.easy.perform ();
+          L.used  =  Clock::now ();
+          took  =  L.used - start;
+        }
+      catch (...)
+        {
+          L.used  =  {};
+          if (metrics)   metrics->record_failure (L.function);
+          throw;
+        }
+
+      if (metrics)
+        {
+          measure (*metrics, L.function, L.easy);
+          metrics->record_errors (L.function, body);
+        }
+
+      check_errors (body);
+      return body;
+    }
+
+
+    /*  Keep the line open with a public request, unless it is busy or was
+     *  used recently.  */
+    void  ping  (Risk_Line &L,  Clock::time_point const now)
+    {
+      auto  guard  =  unique_lock<mutex> {L.lock, try_to_lock};
+      if (! guard.owns_lock ()  ||  now - L.used < KEEP_WARM)   return;
+
+      auto *const  handle  =  L.easy.getHandle ();
+      curl_easy_setopt (handle, CURLOPT_URL,         L.ping_url.c_str ());
+      curl_easy_setopt (handle, CURLOPT_HTTPGET,     1L);
+      curl_easy_setopt (handle, CURLOPT_HTTPHEADER,  nullptr);
+
+      auto  body  =  string {};
+      receive_into (body, L.easy, 64);
+
+      try
+        {
+          L.easy.perform ();
+          L.used  =  Clock::now ();
+        }
+      catch (...)
+        {
+          /*  The next request will open a new connection. */
+          L.used  =  {};
+        }
+    }
+
+
+    string  beat  (chrono::seconds const T)
+    {
+      auto  arguments  =  array<char, 32> {};
+      auto  end        =  arguments.data ();
+      end  =  copy_n ("timeout=", 8, end);
+      end  =  to_chars (end,  arguments.data () + arguments.size (),
+                        T.count ()).ptr;
+
+      auto  took  =  chrono::nanoseconds {0};
+      try
+        {
+          auto  reply  =  send (heartbeat,
+                                string_view (arguments.data (),
+                                             size_t (end - arguments.data ())),
+                                took);
+
+          auto  guard  =  lock_guard<mutex> {statistics_lock};
+          auto  &S  =  statistics;
+          ++S.heartbeats;
+          S.last_heartbeat  =  took;
+          S.trigger_time  =  T.count ()
+                               ?  chrono::system_clock::now () + T
+                               :  chrono::system_clock::time_point {};
+          return reply;
+        }
+      catch (...)
+        {
+          auto  guard  =  lock_guard<mutex> {statistics_lock};
+          ++statistics.heartbeat_failures;
+          throw;
+        }
+    }
+
+
+    void  run  ()
+    {
+      auto  state  =  unique_lock<mutex> {state_lock};
+      next_ping  =  Clock::now ();
+
+      while (! stopping)
+        {
+          auto const  wake_at  =  armed  ?  min (next_beat, next_ping)
+                                         :  next_ping;
+          wake.wait_until (state, wake_at);
+          if (stopping)   break;
+
+          auto const  now  =  Clock::now ();
+
+          if (armed  &&  now >= next_beat)
+            {
+              auto const  T        =  timeout;
+              auto const  every    =  interval;
+              auto const  failed   =  on_failure;
+              state.unlock ();
+
+              auto  error  =  exception_ptr {};
+              {
+                /*  Armed is looked at again with the line held, so that a
+                 *  beat cannot land after disarmʼs zero timeout.  */
+                auto  line  =  lock_guard<mutex> {heartbeat.lock};
+                auto  still  =  unique_lock<mutex> {state_lock};
+                if (armed)
+                  {
+                    still.unlock ();
+                    try  {  beat (T);  }
+                    catch (...)  {  error  =  current_exception ();  }
+                  }
+              }
+
+              if (error  &&  failed)
+                try  {  failed (error);  }  catch (...)  {}
+
+              state.lock ();
+              next_beat  =  Clock::now () + (error  ?  every / 10  :  every);
+            }
+
+          if (now >= next_ping)
+            {
+              state.unlock ();
+              ping (cancel, now);
+              ping (heartbeat, now);
+              state.lock ();
+              next_ping  =  now + KEEP_WARM;
+            }
+        }
+    }
+  };
+
+
+
+  R::Risk_Guard  (Kraken_API const &K,  chrono::milliseconds const deadline)
+    :  implementation {make_unique<Implementation> (K, deadline)}
+  {
+    auto  &I  =  *implementation;
+    I.worker  =  thread {[&I] {  I.run ();  }};
+  }
+
+
+
+  R::~Risk_Guard  ()
+  {
+    auto  &I  =  *implementation;
+    {
+      auto  guard  =  lock_guard<mutex> {I.state_lock};
+      I.stopping  =  true;
+    }
+    I.wake.notify_all ();
+    I.worker.join ();
+  }
+
+
+
+  string  R::cancel_all  ()
+  {
+    auto  &I  =  *implementation;
+    auto  took  =  chrono::nanoseconds {0};
+
+    auto  reply  =  [&I, &took]
+      {
+        auto  line  =  lock_guard<mutex> {I.cancel.lock};
+        return  I.send (I.cancel, {}, took);
+      } ();
+
+    auto  guard  =  lock_guard<mutex> {I.statistics_lock};
+    auto  &S  =  I.statistics;
+    ++S.cancels;
+    S.last_cancel   =  took;
+    S.worst_cancel  =  max (S.worst_cancel, took);
+    return reply;
+  }
+
+
+
+  string  R::cancel_all_after  (chrono::seconds const timeout)
+  {
+    auto  &I  =  *implementation;
+    auto  line  =  lock_guard<mutex> {I.heartbeat.lock};
+    return  I.beat (timeout);
+  }
+
+
+
+  void  R::arm  (chrono::seconds const timeout,
+                 chrono::seconds const interval,
+                 function<void (exception_ptr)> on_failure)
+  {
+    if (interval.count () <= 0  ||  interval >= timeout)
+      throw  invalid_argument
+                 {"Risk_Guard::arm: the interval must be positive and "
+                  "shorter than the timeout"};
+
+    auto  &I  =  *implementation;
+
+    {
+      auto  line  =  lock_guard<mutex> {I.heartbeat.lock};
+      I.beat (timeout);
+
+      auto  guard  =  lock_guard<mutex> {I.state_lock};
+      I.armed       =  true;
+      I.timeout     =  timeout;
+      I.interval    =  interval;
+      I.on_failure  =  move (on_failure);
+      I.next_beat   =  Clock::now () + interval;
+    }
+
+    I.wake.notify_all ();
+  }
+
+
+
+  void  R::disarm  ()
+  {
+    auto  &I  =  *implementation;
+    auto  line  =  lock_guard<mutex> {I.heartbeat.lock};
+
+    {
+      auto  guard  =  lock_guard<mutex> {I.state_lock};
+      I.armed  =  false;
+      I.on_failure  =  {};
+    }
+
+    I.beat (chrono::seconds {0});
+  }
+
+
+
+  R::Statistics  R::statistics  ()  const
+  {
+    auto  &I  =  *implementation;
+    auto  guard  =  lock_guard<mutex> {I.statistics_lock};
+    return I.statistics;
+  }
+
+
+}  /* End of namespace DMBCS. */